@@ -0,0 +1,538 @@
+#include "activation.h"
+#include "neuron_encoding.h"
+#include <math.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ACTIVATION_X86 1
+#include <immintrin.h>
+#endif
+
+// Inputs beyond which the fast tanh is flat; chosen to minimise the largest error
+#define FAST_TANH_CLAMP 4.8f
+
+// Range of the vector exp, so the result stays a normal float
+#define EXP_HI 88.0f
+#define EXP_LO -87.0f
+
+// Cephes constants: ln(2) split in two for range reduction, and the exp polynomial
+#define LOG2E 1.44269504088896341f
+#define EXP_C1 0.693359375f
+#define EXP_C2 -2.12194440e-4f
+#define EXP_P0 1.9875691500e-4f
+#define EXP_P1 1.3981999507e-3f
+#define EXP_P2 8.3334519073e-3f
+#define EXP_P3 4.1665795894e-2f
+#define EXP_P4 1.6666665459e-1f
+#define EXP_P5 5.0000001201e-1f
+
+// Cephes tanh polynomial, used below TANH_SMALL where 1 - 2 / (exp(2x) + 1) cancels badly
+#define TANH_SMALL 0.625f
+#define TANH_P0 -5.70498872745e-3f
+#define TANH_P1 2.06390887954e-2f
+#define TANH_P2 -5.37397155531e-2f
+#define TANH_P3 1.33314422036e-1f
+#define TANH_P4 -3.33332819422e-1f
+
+// Coefficients of the [7/6] Pade approximant of tanh
+#define PADE_N0 135135.0f
+#define PADE_N1 17325.0f
+#define PADE_N2 378.0f
+#define PADE_D1 62370.0f
+#define PADE_D2 3150.0f
+#define PADE_D3 28.0f
+
+typedef void (*ActivationKernel)(float* values, uint32_t count);
+typedef void (*FixedActivationKernel)(int16_t* values, uint32_t count);
+typedef void (*FixedConversionKernel)(const float* inputs, int16_t* outputs, uint32_t count);
+
+// Kernels of one instruction set, indexed by accuracy then activation function,
+// the Q.12 kernels indexed by activation function, and the float to Q.12 conversion
+typedef struct {
+    const char* name;
+    ActivationKernel kernels[2][NUM_ACTIVATION_FUNCTIONS];
+    FixedActivationKernel fixed_kernels[NUM_ACTIVATION_FUNCTIONS];
+    FixedConversionKernel to_fixed;
+} KernelTable;
+
+// Q.12 sigmoid and tanh of every table input, filled by init_activation_kernels.
+// The extra entry lets a 32-bit gather read the last one.
+static int16_t sigmoid_table[FIXED_TABLE_SIZE + 1];
+static int16_t tanh_table[FIXED_TABLE_SIZE + 1];
+
+// Table index of a Q.12 input, rounded to the nearest entry
+static inline int32_t fixed_table_index(int16_t x) {
+    int32_t index = (x - INT16_MIN + (1 << (FIXED_TABLE_SHIFT - 1))) >> FIXED_TABLE_SHIFT;
+    return index < FIXED_TABLE_SIZE ? index : FIXED_TABLE_SIZE - 1;
+}
+
+// ---------------------------------------------------------------------------
+// Scalar kernels
+// ---------------------------------------------------------------------------
+
+static float fast_tanh(float x) {
+    x = x > FAST_TANH_CLAMP ? FAST_TANH_CLAMP : (x < -FAST_TANH_CLAMP ? -FAST_TANH_CLAMP : x);
+    float x2 = x * x;
+    float p = x * (PADE_N0 + x2 * (PADE_N1 + x2 * (PADE_N2 + x2)));
+    float q = PADE_N0 + x2 * (PADE_D1 + x2 * (PADE_D2 + x2 * PADE_D3));
+    return p / q;
+}
+
+static void relu_scalar(float* values, uint32_t count) {
+    for (uint32_t i = 0; i < count; ++i) {
+        values[i] = values[i] > 0 ? values[i] : 0;
+    }
+}
+
+static void sigmoid_scalar(float* values, uint32_t count) {
+    for (uint32_t i = 0; i < count; ++i) {
+        values[i] = 1.0f / (1.0f + expf(-values[i]));
+    }
+}
+
+static void tanh_scalar(float* values, uint32_t count) {
+    for (uint32_t i = 0; i < count; ++i) {
+        values[i] = tanhf(values[i]);
+    }
+}
+
+static void fast_sigmoid_scalar(float* values, uint32_t count) {
+    for (uint32_t i = 0; i < count; ++i) {
+        values[i] = 0.5f + 0.5f * fast_tanh(0.5f * values[i]);
+    }
+}
+
+static void fast_tanh_scalar(float* values, uint32_t count) {
+    for (uint32_t i = 0; i < count; ++i) {
+        values[i] = fast_tanh(values[i]);
+    }
+}
+
+static void relu_fixed_scalar(int16_t* values, uint32_t count) {
+    for (uint32_t i = 0; i < count; ++i) {
+        values[i] = values[i] > 0 ? values[i] : 0;
+    }
+}
+
+static void sigmoid_fixed_scalar(int16_t* values, uint32_t count) {
+    for (uint32_t i = 0; i < count; ++i) {
+        values[i] = sigmoid_table[fixed_table_index(values[i])];
+    }
+}
+
+static void tanh_fixed_scalar(int16_t* values, uint32_t count) {
+    for (uint32_t i = 0; i < count; ++i) {
+        values[i] = tanh_table[fixed_table_index(values[i])];
+    }
+}
+
+static void to_fixed_scalar(const float* inputs, int16_t* outputs, uint32_t count) {
+    for (uint32_t i = 0; i < count; ++i) {
+        outputs[i] = (int16_t)float_to_fixed(inputs[i]);
+    }
+}
+
+static const KernelTable scalar_kernels = {
+    "scalar",
+    {
+        {relu_scalar, sigmoid_scalar, tanh_scalar},
+        {relu_scalar, fast_sigmoid_scalar, fast_tanh_scalar},
+    },
+    {relu_fixed_scalar, sigmoid_fixed_scalar, tanh_fixed_scalar},
+    to_fixed_scalar,
+};
+
+#ifdef ACTIVATION_X86
+
+// ---------------------------------------------------------------------------
+// SSE2 kernels, 4 lanes
+// ---------------------------------------------------------------------------
+
+#define SSE2 __attribute__((target("sse2")))
+
+SSE2 static inline __m128 exp_sse2(__m128 x) {
+    x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(EXP_LO)), _mm_set1_ps(EXP_HI));
+    // n = floor(x / ln(2) + 0.5), without SSE4.1 rounding
+    __m128 fx = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(LOG2E)), _mm_set1_ps(0.5f));
+    __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(fx));
+    fx = _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, fx), _mm_set1_ps(1.0f)));
+    x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(EXP_C1)));
+    x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(EXP_C2)));
+
+    __m128 y = _mm_set1_ps(EXP_P0);
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P1));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P2));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P3));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P4));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P5));
+    y = _mm_add_ps(_mm_mul_ps(y, _mm_mul_ps(x, x)), _mm_add_ps(x, _mm_set1_ps(1.0f)));
+
+    // Scale by 2^n through the exponent bits
+    __m128i n = _mm_add_epi32(_mm_cvttps_epi32(fx), _mm_set1_epi32(127));
+    return _mm_mul_ps(y, _mm_castsi128_ps(_mm_slli_epi32(n, 23)));
+}
+
+SSE2 static inline __m128 relu_sse2(__m128 x) {
+    return _mm_max_ps(x, _mm_setzero_ps());
+}
+
+SSE2 static inline __m128 sigmoid_sse2(__m128 x) {
+    __m128 one = _mm_set1_ps(1.0f);
+    return _mm_div_ps(one, _mm_add_ps(one, exp_sse2(_mm_sub_ps(_mm_setzero_ps(), x))));
+}
+
+SSE2 static inline __m128 tanh_sse2(__m128 x) {
+    __m128 sign_mask = _mm_set1_ps(-0.0f);
+    __m128 sign = _mm_and_ps(x, sign_mask);
+    __m128 ax = _mm_andnot_ps(sign_mask, x);
+    __m128 one = _mm_set1_ps(1.0f);
+
+    __m128 z = _mm_mul_ps(x, x);
+    __m128 p = _mm_set1_ps(TANH_P0);
+    p = _mm_add_ps(_mm_mul_ps(p, z), _mm_set1_ps(TANH_P1));
+    p = _mm_add_ps(_mm_mul_ps(p, z), _mm_set1_ps(TANH_P2));
+    p = _mm_add_ps(_mm_mul_ps(p, z), _mm_set1_ps(TANH_P3));
+    p = _mm_add_ps(_mm_mul_ps(p, z), _mm_set1_ps(TANH_P4));
+    __m128 small = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(p, z), x), x);
+
+    __m128 e = exp_sse2(_mm_add_ps(ax, ax));
+    __m128 large = _mm_sub_ps(one, _mm_div_ps(_mm_set1_ps(2.0f), _mm_add_ps(e, one)));
+    large = _mm_or_ps(large, sign);
+
+    __m128 is_small = _mm_cmplt_ps(ax, _mm_set1_ps(TANH_SMALL));
+    return _mm_or_ps(_mm_and_ps(is_small, small), _mm_andnot_ps(is_small, large));
+}
+
+SSE2 static inline __m128 fast_tanh_sse2(__m128 x) {
+    x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-FAST_TANH_CLAMP)), _mm_set1_ps(FAST_TANH_CLAMP));
+    __m128 x2 = _mm_mul_ps(x, x);
+    __m128 p = _mm_add_ps(x2, _mm_set1_ps(PADE_N2));
+    p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(PADE_N1));
+    p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(PADE_N0));
+    p = _mm_mul_ps(p, x);
+    __m128 q = _mm_set1_ps(PADE_D3);
+    q = _mm_add_ps(_mm_mul_ps(q, x2), _mm_set1_ps(PADE_D2));
+    q = _mm_add_ps(_mm_mul_ps(q, x2), _mm_set1_ps(PADE_D1));
+    q = _mm_add_ps(_mm_mul_ps(q, x2), _mm_set1_ps(PADE_N0));
+    return _mm_div_ps(p, q);
+}
+
+SSE2 static inline __m128 fast_sigmoid_sse2(__m128 x) {
+    __m128 half = _mm_set1_ps(0.5f);
+    return _mm_add_ps(half, _mm_mul_ps(half, fast_tanh_sse2(_mm_mul_ps(half, x))));
+}
+
+// Loop over full vectors, then run the tail through one zero-padded vector so
+// every element goes through the same arithmetic
+#define DEFINE_SSE2_KERNEL(name, op)                                    \
+    SSE2 static void name(float* values, uint32_t count) {              \
+        uint32_t i = 0;                                                 \
+        for (; i + 4 <= count; i += 4) {                                \
+            _mm_storeu_ps(values + i, op(_mm_loadu_ps(values + i)));    \
+        }                                                               \
+        if (i < count) {                                                \
+            float tail[4] = {0};                                        \
+            memcpy(tail, values + i, (count - i) * sizeof(float));      \
+            _mm_storeu_ps(tail, op(_mm_loadu_ps(tail)));                \
+            memcpy(values + i, tail, (count - i) * sizeof(float));      \
+        }                                                               \
+    }
+
+DEFINE_SSE2_KERNEL(relu_sse2_kernel, relu_sse2)
+DEFINE_SSE2_KERNEL(sigmoid_sse2_kernel, sigmoid_sse2)
+DEFINE_SSE2_KERNEL(tanh_sse2_kernel, tanh_sse2)
+DEFINE_SSE2_KERNEL(fast_sigmoid_sse2_kernel, fast_sigmoid_sse2)
+DEFINE_SSE2_KERNEL(fast_tanh_sse2_kernel, fast_tanh_sse2)
+
+// Q.12 relu on 8 int16 lanes; SSE2 has no gather, so the tables are read one
+// entry at a time
+SSE2 static void relu_fixed_sse2_kernel(int16_t* values, uint32_t count) {
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(values + i));
+        _mm_storeu_si128((__m128i*)(values + i), _mm_max_epi16(x, _mm_setzero_si128()));
+    }
+    relu_fixed_scalar(values + i, count - i);
+}
+
+// float_to_fixed on 4 lanes: clamp (max_ps returns the bound for NaN), round half
+// away from zero, truncate
+SSE2 static inline __m128i to_fixed_sse2(__m128 x) {
+    __m128 scaled = _mm_mul_ps(x, _mm_set1_ps(FIXED_POINT_ONE));
+    scaled = _mm_min_ps(_mm_max_ps(scaled, _mm_set1_ps(INT16_MIN)), _mm_set1_ps(INT16_MAX));
+    __m128 half = _mm_or_ps(_mm_and_ps(scaled, _mm_set1_ps(-0.0f)), _mm_set1_ps(0.5f));
+    return _mm_cvttps_epi32(_mm_add_ps(scaled, half));
+}
+
+SSE2 static void to_fixed_sse2_kernel(const float* inputs, int16_t* outputs, uint32_t count) {
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i low = to_fixed_sse2(_mm_loadu_ps(inputs + i));
+        __m128i high = to_fixed_sse2(_mm_loadu_ps(inputs + i + 4));
+        _mm_storeu_si128((__m128i*)(outputs + i), _mm_packs_epi32(low, high));
+    }
+    to_fixed_scalar(inputs + i, outputs + i, count - i);
+}
+
+static const KernelTable sse2_kernels = {
+    "sse2",
+    {
+        {relu_sse2_kernel, sigmoid_sse2_kernel, tanh_sse2_kernel},
+        {relu_sse2_kernel, fast_sigmoid_sse2_kernel, fast_tanh_sse2_kernel},
+    },
+    {relu_fixed_sse2_kernel, sigmoid_fixed_scalar, tanh_fixed_scalar},
+    to_fixed_sse2_kernel,
+};
+
+// ---------------------------------------------------------------------------
+// AVX2 + FMA kernels, 8 lanes
+// ---------------------------------------------------------------------------
+
+#define AVX2 __attribute__((target("avx2,fma")))
+
+AVX2 static inline __m256 exp_avx2(__m256 x) {
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(EXP_LO)), _mm256_set1_ps(EXP_HI));
+    __m256 fx = _mm256_floor_ps(_mm256_fmadd_ps(x, _mm256_set1_ps(LOG2E), _mm256_set1_ps(0.5f)));
+    x = _mm256_fnmadd_ps(fx, _mm256_set1_ps(EXP_C1), x);
+    x = _mm256_fnmadd_ps(fx, _mm256_set1_ps(EXP_C2), x);
+
+    __m256 y = _mm256_set1_ps(EXP_P0);
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P1));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P2));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P3));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P4));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P5));
+    y = _mm256_fmadd_ps(y, _mm256_mul_ps(x, x), _mm256_add_ps(x, _mm256_set1_ps(1.0f)));
+
+    __m256i n = _mm256_add_epi32(_mm256_cvttps_epi32(fx), _mm256_set1_epi32(127));
+    return _mm256_mul_ps(y, _mm256_castsi256_ps(_mm256_slli_epi32(n, 23)));
+}
+
+AVX2 static inline __m256 relu_avx2(__m256 x) {
+    return _mm256_max_ps(x, _mm256_setzero_ps());
+}
+
+AVX2 static inline __m256 sigmoid_avx2(__m256 x) {
+    __m256 one = _mm256_set1_ps(1.0f);
+    return _mm256_div_ps(one, _mm256_add_ps(one, exp_avx2(_mm256_sub_ps(_mm256_setzero_ps(), x))));
+}
+
+AVX2 static inline __m256 tanh_avx2(__m256 x) {
+    __m256 sign_mask = _mm256_set1_ps(-0.0f);
+    __m256 sign = _mm256_and_ps(x, sign_mask);
+    __m256 ax = _mm256_andnot_ps(sign_mask, x);
+    __m256 one = _mm256_set1_ps(1.0f);
+
+    __m256 z = _mm256_mul_ps(x, x);
+    __m256 p = _mm256_set1_ps(TANH_P0);
+    p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(TANH_P1));
+    p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(TANH_P2));
+    p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(TANH_P3));
+    p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(TANH_P4));
+    __m256 small = _mm256_fmadd_ps(_mm256_mul_ps(p, z), x, x);
+
+    __m256 e = exp_avx2(_mm256_add_ps(ax, ax));
+    __m256 large = _mm256_sub_ps(one, _mm256_div_ps(_mm256_set1_ps(2.0f), _mm256_add_ps(e, one)));
+    large = _mm256_or_ps(large, sign);
+
+    return _mm256_blendv_ps(large, small, _mm256_cmp_ps(ax, _mm256_set1_ps(TANH_SMALL), _CMP_LT_OQ));
+}
+
+AVX2 static inline __m256 fast_tanh_avx2(__m256 x) {
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-FAST_TANH_CLAMP)), _mm256_set1_ps(FAST_TANH_CLAMP));
+    __m256 x2 = _mm256_mul_ps(x, x);
+    __m256 p = _mm256_add_ps(x2, _mm256_set1_ps(PADE_N2));
+    p = _mm256_fmadd_ps(p, x2, _mm256_set1_ps(PADE_N1));
+    p = _mm256_fmadd_ps(p, x2, _mm256_set1_ps(PADE_N0));
+    p = _mm256_mul_ps(p, x);
+    __m256 q = _mm256_set1_ps(PADE_D3);
+    q = _mm256_fmadd_ps(q, x2, _mm256_set1_ps(PADE_D2));
+    q = _mm256_fmadd_ps(q, x2, _mm256_set1_ps(PADE_D1));
+    q = _mm256_fmadd_ps(q, x2, _mm256_set1_ps(PADE_N0));
+    return _mm256_div_ps(p, q);
+}
+
+AVX2 static inline __m256 fast_sigmoid_avx2(__m256 x) {
+    __m256 half = _mm256_set1_ps(0.5f);
+    return _mm256_fmadd_ps(half, fast_tanh_avx2(_mm256_mul_ps(half, x)), half);
+}
+
+#define DEFINE_AVX2_KERNEL(name, op)                                        \
+    AVX2 static void name(float* values, uint32_t count) {                  \
+        uint32_t i = 0;                                                     \
+        for (; i + 8 <= count; i += 8) {                                    \
+            _mm256_storeu_ps(values + i, op(_mm256_loadu_ps(values + i)));  \
+        }                                                                   \
+        if (i < count) {                                                    \
+            float tail[8] = {0};                                            \
+            memcpy(tail, values + i, (count - i) * sizeof(float));          \
+            _mm256_storeu_ps(tail, op(_mm256_loadu_ps(tail)));              \
+            memcpy(values + i, tail, (count - i) * sizeof(float));          \
+        }                                                                   \
+    }
+
+DEFINE_AVX2_KERNEL(relu_avx2_kernel, relu_avx2)
+DEFINE_AVX2_KERNEL(sigmoid_avx2_kernel, sigmoid_avx2)
+DEFINE_AVX2_KERNEL(tanh_avx2_kernel, tanh_avx2)
+DEFINE_AVX2_KERNEL(fast_sigmoid_avx2_kernel, fast_sigmoid_avx2)
+DEFINE_AVX2_KERNEL(fast_tanh_avx2_kernel, fast_tanh_avx2)
+
+// Q.12 relu on 16 int16 lanes
+AVX2 static void relu_fixed_avx2_kernel(int16_t* values, uint32_t count) {
+    uint32_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(values + i));
+        _mm256_storeu_si256((__m256i*)(values + i), _mm256_max_epi16(x, _mm256_setzero_si256()));
+    }
+    relu_fixed_scalar(values + i, count - i);
+}
+
+// Look up 16 Q.12 inputs in a table: the indices are computed on 16 lanes, as
+// fixed_table_index does, and the entries gathered 8 at a time
+AVX2 static inline __m256i lookup_fixed_avx2(const int16_t* table, __m256i x) {
+    // x - INT16_MIN is x with the sign bit flipped; rounding saturates at the last entry
+    __m256i biased = _mm256_xor_si256(x, _mm256_set1_epi16(INT16_MIN));
+    __m256i index = _mm256_srli_epi16(_mm256_adds_epu16(biased, _mm256_set1_epi16(1 << (FIXED_TABLE_SHIFT - 1))),
+                                      FIXED_TABLE_SHIFT);
+    __m256i low = _mm256_i32gather_epi32((const int*)table, _mm256_cvtepu16_epi32(_mm256_castsi256_si128(index)), 2);
+    __m256i high = _mm256_i32gather_epi32((const int*)table, _mm256_cvtepu16_epi32(_mm256_extracti128_si256(index, 1)), 2);
+    // Each gathered word holds the entry in its low half: sign-extend it, pack, and undo the lane interleave of packs
+    low = _mm256_srai_epi32(_mm256_slli_epi32(low, 16), 16);
+    high = _mm256_srai_epi32(_mm256_slli_epi32(high, 16), 16);
+    return _mm256_permute4x64_epi64(_mm256_packs_epi32(low, high), 0xD8);
+}
+
+#define DEFINE_AVX2_TABLE_KERNEL(name, table, scalar)                               \
+    AVX2 static void name(int16_t* values, uint32_t count) {                        \
+        uint32_t i = 0;                                                             \
+        for (; i + 16 <= count; i += 16) {                                          \
+            __m256i x = _mm256_loadu_si256((const __m256i*)(values + i));           \
+            _mm256_storeu_si256((__m256i*)(values + i), lookup_fixed_avx2(table, x)); \
+        }                                                                           \
+        scalar(values + i, count - i);                                              \
+    }
+
+DEFINE_AVX2_TABLE_KERNEL(sigmoid_fixed_avx2_kernel, sigmoid_table, sigmoid_fixed_scalar)
+DEFINE_AVX2_TABLE_KERNEL(tanh_fixed_avx2_kernel, tanh_table, tanh_fixed_scalar)
+
+// float_to_fixed on 8 lanes, as to_fixed_sse2
+AVX2 static inline __m256i to_fixed_avx2(__m256 x) {
+    __m256 scaled = _mm256_mul_ps(x, _mm256_set1_ps(FIXED_POINT_ONE));
+    scaled = _mm256_min_ps(_mm256_max_ps(scaled, _mm256_set1_ps(INT16_MIN)), _mm256_set1_ps(INT16_MAX));
+    __m256 half = _mm256_or_ps(_mm256_and_ps(scaled, _mm256_set1_ps(-0.0f)), _mm256_set1_ps(0.5f));
+    return _mm256_cvttps_epi32(_mm256_add_ps(scaled, half));
+}
+
+AVX2 static void to_fixed_avx2_kernel(const float* inputs, int16_t* outputs, uint32_t count) {
+    uint32_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i low = to_fixed_avx2(_mm256_loadu_ps(inputs + i));
+        __m256i high = to_fixed_avx2(_mm256_loadu_ps(inputs + i + 8));
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(low, high), 0xD8);
+        _mm256_storeu_si256((__m256i*)(outputs + i), packed);
+    }
+    to_fixed_scalar(inputs + i, outputs + i, count - i);
+}
+
+static const KernelTable avx2_kernels = {
+    "avx2",
+    {
+        {relu_avx2_kernel, sigmoid_avx2_kernel, tanh_avx2_kernel},
+        {relu_avx2_kernel, fast_sigmoid_avx2_kernel, fast_tanh_avx2_kernel},
+    },
+    {relu_fixed_avx2_kernel, sigmoid_fixed_avx2_kernel, tanh_fixed_avx2_kernel},
+    to_fixed_avx2_kernel,
+};
+
+#endif // ACTIVATION_X86
+
+// Kernels in use, picked on first use
+static const KernelTable* active_kernels = NULL;
+
+// Fill the fixed-point tables; entry k holds the activation of (k << FIXED_TABLE_SHIFT) - 32768 in Q.12
+static void init_fixed_activation_tables(void) {
+    for (int k = 0; k < FIXED_TABLE_SIZE; ++k) {
+        double x = (double)((k << FIXED_TABLE_SHIFT) - 32768) / FIXED_POINT_ONE;
+        sigmoid_table[k] = (int16_t)lrint(FIXED_POINT_ONE / (1 + exp(-x)));
+        tanh_table[k] = (int16_t)lrint(FIXED_POINT_ONE * tanh(x));
+    }
+}
+
+/**
+ * Pick the widest activation kernels the CPU supports (AVX2, SSE2 or scalar).
+ */
+void init_activation_kernels(void) {
+    if (active_kernels) {
+        return;
+    }
+    const KernelTable* kernels = &scalar_kernels;
+#ifdef ACTIVATION_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        kernels = &avx2_kernels;
+    } else if (__builtin_cpu_supports("sse2")) {
+        kernels = &sse2_kernels;
+    }
+#endif
+    init_fixed_activation_tables();
+    active_kernels = kernels;
+}
+
+/**
+ * Name of the kernels picked by init_activation_kernels.
+ */
+const char* activation_kernel_name(void) {
+    init_activation_kernels();
+    return active_kernels->name;
+}
+
+/**
+ * Apply an activation function in place to an array of pre-activations.
+ */
+void activate_array(float* values, uint32_t count, uint8_t activation_function, ActivationAccuracy accuracy) {
+    if (activation_function >= NUM_ACTIVATION_FUNCTIONS) {
+        return;  // Identity function as default (no activation)
+    }
+    init_activation_kernels();
+    active_kernels->kernels[accuracy == ACTIVATION_FAST][activation_function](values, count);
+}
+
+/**
+ * Apply an activation function in place using the portable scalar kernels.
+ */
+void activate_array_scalar(float* values, uint32_t count, uint8_t activation_function, ActivationAccuracy accuracy) {
+    if (activation_function >= NUM_ACTIVATION_FUNCTIONS) {
+        return;  // Identity function as default (no activation)
+    }
+    scalar_kernels.kernels[accuracy == ACTIVATION_FAST][activation_function](values, count);
+}
+
+/**
+ * Apply an activation function in place to an array of Q.12 pre-activations.
+ */
+void activate_array_fixed(int16_t* values, uint32_t count, uint8_t activation_function) {
+    if (activation_function >= NUM_ACTIVATION_FUNCTIONS) {
+        return;  // Identity function as default (no activation)
+    }
+    init_activation_kernels();
+    active_kernels->fixed_kernels[activation_function](values, count);
+}
+
+/**
+ * Apply an activation function in place to Q.12 values using the portable scalar kernels.
+ */
+void activate_array_fixed_scalar(int16_t* values, uint32_t count, uint8_t activation_function) {
+    if (activation_function >= NUM_ACTIVATION_FUNCTIONS) {
+        return;  // Identity function as default (no activation)
+    }
+    init_activation_kernels();
+    scalar_kernels.fixed_kernels[activation_function](values, count);
+}
+
+/**
+ * Convert an array of floats to Q.12 as float_to_fixed does.
+ */
+void convert_to_fixed(const float* inputs, int16_t* outputs, uint32_t count) {
+    init_activation_kernels();
+    active_kernels->to_fixed(inputs, outputs, count);
+}
@@ -0,0 +1,113 @@
+#ifndef ACTIVATION_H
+#define ACTIVATION_H
+
+#include <math.h>
+#include <stdint.h>
+
+// Largest absolute error of the fast sigmoid and tanh approximations
+#define FAST_ACTIVATION_MAX_ERROR 1e-4f
+
+// Fixed-point format of brain values and weights: Q.12, so 1.0 is 4096
+#define FIXED_POINT_SHIFT 12
+#define FIXED_POINT_ONE (1 << FIXED_POINT_SHIFT)
+
+// The fixed-point sigmoid and tanh tables cover the int16 range of Q.12 inputs,
+// [-8, 8), in steps of 2^FIXED_TABLE_SHIFT (1/256)
+#define FIXED_TABLE_SHIFT 4
+#define FIXED_TABLE_SIZE (1 << (16 - FIXED_TABLE_SHIFT))
+
+// Enum to choose between accurate and approximated activation kernels
+typedef enum {
+    ACTIVATION_PRECISE,  // Within a few float ulps of the libm result
+    ACTIVATION_FAST,     // Rational approximation, error bounded by FAST_ACTIVATION_MAX_ERROR
+} ActivationAccuracy;
+
+/**
+ * Pick the widest activation kernels the CPU supports (AVX2, SSE2 or scalar)
+ * and fill the fixed-point activation tables. Called automatically on first
+ * use; call it up front before evaluating activations from several threads.
+ */
+void init_activation_kernels(void);
+
+/**
+ * Name of the kernels picked by init_activation_kernels.
+ *
+ * @return "avx2", "sse2" or "scalar".
+ */
+const char* activation_kernel_name(void);
+
+/**
+ * Apply an activation function in place to an array of pre-activations.
+ *
+ * @param values Array of pre-activations, overwritten with the activations.
+ * @param count Number of values.
+ * @param activation_function ActivationFunctionType to apply, anything else is the identity.
+ * @param accuracy Whether sigmoid and tanh may use the fast approximation.
+ */
+void activate_array(float* values, uint32_t count, uint8_t activation_function, ActivationAccuracy accuracy);
+
+/**
+ * Apply an activation function in place using the portable scalar kernels,
+ * regardless of what the CPU supports. Useful as a reference.
+ */
+void activate_array_scalar(float* values, uint32_t count, uint8_t activation_function, ActivationAccuracy accuracy);
+
+/**
+ * Convert a float to Q.12 fixed point, saturating to the int16 range.
+ *
+ * @param x Value to convert.
+ * @return x * FIXED_POINT_ONE rounded to nearest, within [-32768, 32767].
+ */
+static inline int32_t float_to_fixed(float x) {
+    float scaled = x * FIXED_POINT_ONE;
+    // Clamped so that NaN fails the first comparison and ends at INT16_MIN
+    scaled = scaled > INT16_MIN ? scaled : INT16_MIN;
+    scaled = scaled < INT16_MAX ? scaled : INT16_MAX;
+    return (int32_t)(scaled + copysignf(0.5f, scaled));
+}
+
+/**
+ * Convert an array of floats to Q.12 as float_to_fixed does, 8 or 16 at a time
+ * where the CPU allows.
+ *
+ * @param inputs Array of values to convert.
+ * @param outputs Array receiving the Q.12 values.
+ * @param count Number of values.
+ */
+void convert_to_fixed(const float* inputs, int16_t* outputs, uint32_t count);
+
+/**
+ * Convert a Q.12 fixed-point value back to float.
+ */
+static inline float fixed_to_float(int32_t x) {
+    return (float)x / FIXED_POINT_ONE;
+}
+
+/**
+ * Saturate a Q.12 value to the int16 range.
+ */
+static inline int16_t saturate_fixed(int32_t x) {
+    x = x > INT16_MIN ? x : INT16_MIN;
+    x = x < INT16_MAX ? x : INT16_MAX;
+    return (int16_t)x;
+}
+
+/**
+ * Apply an activation function in place to an array of Q.12 pre-activations,
+ * 8 (SSE2) or 16 (AVX2) lanes at a time. Sigmoid and tanh are read from the
+ * tables filled by init_activation_kernels; AVX2 gathers eight entries per
+ * instruction, so every kernel gives the same results.
+ *
+ * @param values Array of Q.12 pre-activations, overwritten with the activations.
+ * @param count Number of values.
+ * @param activation_function ActivationFunctionType to apply, anything else is the identity.
+ */
+void activate_array_fixed(int16_t* values, uint32_t count, uint8_t activation_function);
+
+/**
+ * Apply an activation function in place to Q.12 values using the portable
+ * scalar kernels, regardless of what the CPU supports. Useful as a reference.
+ */
+void activate_array_fixed_scalar(int16_t* values, uint32_t count, uint8_t activation_function);
+
+#endif // ACTIVATION_H
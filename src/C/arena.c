@@ -0,0 +1,77 @@
+#include "arena.h"
+#include <stdlib.h>
+
+/**
+ * Create an empty arena.
+ *
+ * @param capacity Size of the block in bytes.
+ * @return Pointer to the new arena, or NULL if allocation failed.
+ */
+Arena* create_arena(size_t capacity) {
+    Arena* arena = malloc(sizeof(Arena));
+    if (!arena) {
+        return NULL;  // Allocation failed
+    }
+    arena->base = malloc(capacity ? capacity : 1);
+    if (!arena->base) {
+        free(arena);
+        return NULL;  // Allocation failed
+    }
+    arena->capacity = capacity;
+    arena->used = 0;
+    arena->block = arena->base;
+    arena->block_capacity = capacity;
+    return arena;
+}
+
+/**
+ * Deallocate an arena and everything allocated from it.
+ *
+ * @param arena Pointer to the arena to be deallocated.
+ */
+void free_arena(Arena* arena) {
+    if (!arena) {
+        return;
+    }
+    free(arena->block);
+    free(arena);
+}
+
+/**
+ * Allocate from an arena, aligned to ARENA_ALIGNMENT.
+ *
+ * @param arena Pointer to the arena.
+ * @param size Number of bytes.
+ * @return Pointer to the memory, or NULL if the arena is full.
+ */
+void* arena_alloc(Arena* arena, size_t size) {
+    size_t start = (arena->used + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+    if (start > arena->capacity || size > arena->capacity - start) {
+        return NULL;  // Arena full
+    }
+    arena->used = start + size;
+    return arena->base + start;
+}
+
+/**
+ * Move an arena onto memory it does not own, such as a mapped file, emptying
+ * it. The arena's own block is kept for when it is moved back.
+ *
+ * @param arena Pointer to the arena.
+ * @param base Start of the memory, aligned to ARENA_ALIGNMENT, or NULL for the arena's own block.
+ * @param capacity Size of the memory in bytes, ignored when base is NULL.
+ */
+void place_arena(Arena* arena, void* base, size_t capacity) {
+    arena->base = base ? base : arena->block;
+    arena->capacity = base ? capacity : arena->block_capacity;
+    arena->used = 0;
+}
+
+/**
+ * Empty an arena, invalidating everything allocated from it.
+ *
+ * @param arena Pointer to the arena.
+ */
+void reset_arena(Arena* arena) {
+    arena->used = 0;
+}
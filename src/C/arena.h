@@ -0,0 +1,67 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Alignment of every arena allocation, enough for SIMD loads
+#define ARENA_ALIGNMENT 16
+
+/*
+ * A bump allocator over one fixed block. Allocations are carved off the front
+ * and are never freed one by one: the whole arena is emptied at once with
+ * reset_arena. The grid keeps two, one holding the genomes of the current
+ * generation and one the genomes being bred, and swaps them at every
+ * mate_creatures, so a run allocates genome storage once however many
+ * generations it lasts.
+ */
+typedef struct {
+    uint8_t* base;      // Start of the block
+    size_t capacity;    // Size of the block in bytes
+    size_t used;        // Bytes handed out since the last reset
+    uint8_t* block;     // Block allocated with the arena, the base unless it was placed elsewhere
+    size_t block_capacity;
+} Arena;
+
+/**
+ * Create an empty arena.
+ *
+ * @param capacity Size of the block in bytes.
+ * @return Pointer to the new arena, or NULL if allocation failed.
+ */
+Arena* create_arena(size_t capacity);
+
+/**
+ * Deallocate an arena and everything allocated from it.
+ *
+ * @param arena Pointer to the arena to be deallocated.
+ */
+void free_arena(Arena* arena);
+
+/**
+ * Allocate from an arena, aligned to ARENA_ALIGNMENT.
+ *
+ * @param arena Pointer to the arena.
+ * @param size Number of bytes.
+ * @return Pointer to the memory, or NULL if the arena is full.
+ */
+void* arena_alloc(Arena* arena, size_t size);
+
+/**
+ * Move an arena onto memory it does not own, such as a mapped file, emptying
+ * it. The arena's own block is kept for when it is moved back.
+ *
+ * @param arena Pointer to the arena.
+ * @param base Start of the memory, aligned to ARENA_ALIGNMENT, or NULL for the arena's own block.
+ * @param capacity Size of the memory in bytes, ignored when base is NULL.
+ */
+void place_arena(Arena* arena, void* base, size_t capacity);
+
+/**
+ * Empty an arena, invalidating everything allocated from it.
+ *
+ * @param arena Pointer to the arena.
+ */
+void reset_arena(Arena* arena);
+
+#endif // ARENA_H
@@ -0,0 +1,1063 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "gene_encoding.h"
+#include "neuron_encoding.h"
+#include "brain_batch.h"
+#include "brain_cache.h"
+#include "activation.h"
+#include "grid.h"
+#include "simulation.h"
+#include "snapshot.h"
+#include "snapshot_writer.h"
+#include "replay.h"
+#include "checkpoint.h"
+#include "genome_archive.h"
+#include <math.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Number of random brains evaluated per genome length
+#define NUM_BRAINS 1000
+// Number of steps each brain is evaluated for
+#define NUM_STEPS 100
+// Number of pre-activations per activation kernel call
+#define NUM_ACTIVATIONS 4096
+// Number of calls per activation kernel
+#define NUM_ACTIVATION_CALLS 2000
+// Side of the square grid the sensing benchmark reads
+#define SENSING_GRID_SIZE 300
+// Number of cells whose eight look sensors are read
+#define NUM_SENSING_QUERIES 1000000
+// Side of the square grid and population of the generation boundary benchmark
+#define MATING_GRID_SIZE 1000
+#define NUM_MATING_CREATURES 100000
+// Number of single-bit mutants rebuilt per genome length
+#define NUM_REBUILDS 100000
+// Frames written per grid size by the snapshot benchmark
+#define NUM_SNAPSHOT_FRAMES 5
+// Steps recorded per configuration by the replay benchmark, two generations
+#define NUM_REPLAY_STEPS 600
+// Random steps sought in each recorded replay
+#define NUM_REPLAY_SEEKS 100
+// Steps exported per configuration by the snapshot writer benchmark, one generation
+#define NUM_EXPORT_STEPS 300
+// Checkpoints saved and restored per grid size
+#define NUM_CHECKPOINTS 5
+// Generation boundaries bred per configuration by the genome archive benchmark
+#define NUM_ARCHIVED_GENERATIONS 3
+
+// Build a 64-bit gene from 16-bit chunks so every field gets random bits
+static uint64_t random_gene(void) {
+    uint64_t gene = 0;
+    for (int i = 0; i < 4; ++i) {
+        gene = (gene << 16) | (rand() & 0xFFFF);
+    }
+    return gene;
+}
+
+// Time NUM_STEPS evaluations of every brain, returns nanoseconds per brain step
+static double time_evaluation(NeuralNetwork** brains, int num_brains, EvaluationMode mode) {
+    float (*values)[TOTAL_NEURONS] = calloc(num_brains, sizeof(*values));
+    if (!values) {
+        fprintf(stderr, "Allocation failed.\n");
+        exit(1);
+    }
+    clock_t start = clock();
+    for (int step = 0; step < NUM_STEPS; ++step) {
+        for (int b = 0; b < num_brains; ++b) {
+            NeuralNetwork* brain = brains[b];
+            for (int i = 0; i < brain->num_sensory_neurons; ++i) {
+                values[b][brain->sensory_indices[i]] = (float)((step + i) % 3) - 1.0f;
+            }
+            propagate_signal(brain, values[b], mode);
+        }
+    }
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    free(values);
+    return seconds * 1e9 / ((double)NUM_STEPS * num_brains);
+}
+
+// Time NUM_STEPS evaluations of the whole batch, returns nanoseconds per brain step
+static double time_batch_evaluation(BrainBatch* batch) {
+    memset(batch->active, 1, batch->num_creatures);
+    clock_t start = clock();
+    for (int step = 0; step < NUM_STEPS; ++step) {
+        for (uint32_t i = 0; i < batch->num_creatures; ++i) {
+            for (uint32_t s = batch->sensor_offsets[i]; s < batch->sensor_offsets[i + 1]; ++s) {
+                batch->sensor_inputs[s] = (float)((step + s - batch->sensor_offsets[i]) % 3) - 1.0f;
+            }
+        }
+        evaluate_brain_batch(batch);
+    }
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    return seconds * 1e9 / ((double)NUM_STEPS * batch->num_creatures);
+}
+
+// Double precision reference of an activation function
+static double reference_activation(double x, uint8_t activation_function) {
+    switch (activation_function) {
+        case RELU: return x > 0 ? x : 0;
+        case SIGMOID: return 1 / (1 + exp(-x));
+        case TANH: return tanh(x);
+        default: return x;
+    }
+}
+
+// Time one activation kernel over pre-activations spread across [-10, 10] and measure its error
+static void benchmark_activation(const char* label, uint8_t activation_function, ActivationAccuracy accuracy, int use_scalar) {
+    static float inputs[NUM_ACTIVATIONS];
+    static float values[NUM_ACTIVATIONS];
+    for (int i = 0; i < NUM_ACTIVATIONS; ++i) {
+        inputs[i] = -10.0f + 20.0f * i / (NUM_ACTIVATIONS - 1);
+    }
+
+    double max_error = 0;
+    clock_t start = clock();
+    for (int call = 0; call < NUM_ACTIVATION_CALLS; ++call) {
+        memcpy(values, inputs, sizeof(values));
+        if (use_scalar) {
+            activate_array_scalar(values, NUM_ACTIVATIONS, activation_function, accuracy);
+        } else {
+            activate_array(values, NUM_ACTIVATIONS, activation_function, accuracy);
+        }
+    }
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    for (int i = 0; i < NUM_ACTIVATIONS; ++i) {
+        double error = fabs(values[i] - reference_activation(inputs[i], activation_function));
+        if (error > max_error) {
+            max_error = error;
+        }
+    }
+    printf("%8s %-16s %14.2f %14.2e\n", activation_function_to_string(activation_function), label,
+           seconds * 1e9 / ((double)NUM_ACTIVATION_CALLS * NUM_ACTIVATIONS), max_error);
+}
+
+// Time one Q.12 activation kernel over every int16 input and check it matches the scalar tables
+static void benchmark_activation_fixed(uint8_t activation_function) {
+    static int16_t inputs[1 << 16];
+    static int16_t values[1 << 16];
+    static int16_t reference[1 << 16];
+    for (int i = 0; i < 1 << 16; ++i) {
+        inputs[i] = (int16_t)(i + INT16_MIN);
+    }
+    memcpy(reference, inputs, sizeof(inputs));
+    activate_array_fixed_scalar(reference, 1 << 16, activation_function);
+
+    double seconds[2] = {0, 0};
+    for (int kernel = 0; kernel < 2; ++kernel) {
+        clock_t start = clock();
+        for (int call = 0; call < NUM_ACTIVATION_CALLS / 16; ++call) {
+            memcpy(values, inputs, sizeof(values));
+            if (kernel == 0) {
+                activate_array_fixed_scalar(values, 1 << 16, activation_function);
+            } else {
+                activate_array_fixed(values, 1 << 16, activation_function);
+            }
+        }
+        seconds[kernel] = (double)(clock() - start) / CLOCKS_PER_SEC;
+    }
+    if (memcmp(values, reference, sizeof(values)) != 0) {
+        fprintf(stderr, "%s fixed-point kernel differs from the scalar tables.\n", activation_function_to_string(activation_function));
+        exit(1);
+    }
+    printf("%8s %14.2f %14.2f\n", activation_function_to_string(activation_function),
+           seconds[0] * 1e9 / ((double)(NUM_ACTIVATION_CALLS / 16) * (1 << 16)),
+           seconds[1] * 1e9 / ((double)(NUM_ACTIVATION_CALLS / 16) * (1 << 16)));
+}
+
+// Check that the vectorised float to Q.12 conversion rounds and saturates like
+// float_to_fixed, on every multiple of a quarter step up to past both bounds, NaN
+// and the infinities
+static void check_fixed_conversion(void) {
+    static float inputs[(1 << 19) + 3];
+    static int16_t outputs[(1 << 19) + 3];
+    uint32_t count = 1 << 19;
+    for (uint32_t i = 0; i < count; ++i) {
+        inputs[i] = ((int32_t)i - (1 << 18)) / (4.0f * FIXED_POINT_ONE);
+    }
+    inputs[count++] = NAN;
+    inputs[count++] = INFINITY;
+    inputs[count++] = -INFINITY;
+    convert_to_fixed(inputs, outputs, count);
+    for (uint32_t i = 0; i < count; ++i) {
+        if (outputs[i] != float_to_fixed(inputs[i])) {
+            fprintf(stderr, "Q.12 conversion of %g gives %d instead of %d.\n", inputs[i], outputs[i], float_to_fixed(inputs[i]));
+            exit(1);
+        }
+    }
+}
+
+// Bytes per brain of the connection and value arrays of a batch
+static double batch_bytes_per_brain(const BrainBatch* batch) {
+    uint32_t num_edges = 0;
+    for (uint32_t r = 0; r < batch->block_runs[batch->num_blocks]; ++r) {
+        num_edges += batch->runs[r].num_edges;
+    }
+    size_t weight_size = batch->precision == BRAIN_PRECISION_FIXED ? sizeof(int16_t) : sizeof(float);
+    size_t value_size = batch->precision == BRAIN_PRECISION_FIXED ? sizeof(int16_t) : sizeof(float);
+    double bytes = (double)num_edges * (2 * sizeof(uint16_t) + weight_size)
+                 + 2.0 * batch->value_offsets[batch->num_creatures] * value_size;
+    return bytes / batch->num_creatures;
+}
+
+// Run the float and fixed-point batches side by side on the same sensor inputs and
+// print how often they agree and how fast each one is
+static void compare_precisions(NeuralNetwork** brains, int num_brains, int genome_length) {
+    BrainBatch* exact = build_brain_batch(brains, num_brains, BRAIN_PRECISION_FLOAT);
+    BrainBatch* fixed = build_brain_batch(brains, num_brains, BRAIN_PRECISION_FIXED);
+    if (!exact || !fixed) {
+        fprintf(stderr, "Allocation failed.\n");
+        exit(1);
+    }
+    memset(exact->active, 1, exact->num_creatures);
+    memset(fixed->active, 1, fixed->num_creatures);
+
+    long agreements = 0;
+    long decisions = 0;
+    double error = 0;
+    long outputs = 0;
+    for (int step = 0; step < NUM_STEPS; ++step) {
+        for (uint32_t s = 0; s < exact->sensor_offsets[exact->num_creatures]; ++s) {
+            // Mix of look values (-2, -1, 0, 1) and wall distances (1 / d)
+            float input = (rand() % 2) ? (float)(rand() % 4 - 2) : 1.0f / (1 + rand() % 50);
+            exact->sensor_inputs[s] = input;
+            fixed->sensor_inputs[s] = input;
+        }
+        evaluate_brain_batch(exact);
+        evaluate_brain_batch(fixed);
+        for (uint32_t i = 0; i < exact->num_creatures; ++i) {
+            agreements += exact->actions[i] == fixed->actions[i];
+            decisions++;
+        }
+        for (uint32_t o = 0; o < exact->output_offsets[exact->num_creatures]; ++o) {
+            // Only compare outputs inside the fixed-point range, [-8, 8)
+            uint32_t slot = exact->output_slots[o];
+            if (fabs(exact->values[slot]) < 8) {
+                error += fabs(exact->values[slot] - fixed_to_float(fixed->values_fixed[slot]));
+                outputs++;
+            }
+        }
+    }
+
+    double float_ns = time_batch_evaluation(exact);
+    double fixed_ns = time_batch_evaluation(fixed);
+    printf("%8d %12.1f %12.1f %12.1f %12.1f %12.2f%% %14.4f\n", genome_length, float_ns, fixed_ns,
+           batch_bytes_per_brain(exact), batch_bytes_per_brain(fixed),
+           100.0 * agreements / decisions, error / outputs);
+    free_brain_batch(exact);
+    free_brain_batch(fixed);
+}
+
+// Time reading all eight look sensors of random cells, one switch call per sensor
+// against one neighborhood fetch per cell, then the eight wall sensors
+static void benchmark_sensing(void) {
+    Grid* grid = initialize_grid(SENSING_GRID_SIZE, SENSING_GRID_SIZE, 1, 1, 1);
+    uint16_t* xs = malloc(NUM_SENSING_QUERIES * sizeof(uint16_t));
+    uint16_t* ys = malloc(NUM_SENSING_QUERIES * sizeof(uint16_t));
+    if (!grid || !xs || !ys) {
+        fprintf(stderr, "Allocation failed.\n");
+        exit(1);
+    }
+    // A populated world: a fifth of the cells hold a creature, another fifth food, 2% walls
+    for (uint16_t y = 0; y < SENSING_GRID_SIZE; ++y) {
+        for (uint16_t x = 0; x < SENSING_GRID_SIZE; ++x) {
+            int r = rand() % 50;
+            if (r == 0) {
+                set_wall(grid, x, y, true);
+            } else if (r < 10) {
+                place_creature(grid, x, y, 1);
+            } else if (r < 20) {
+                set_cell_flag(grid, CELL_FOOD, x, y, true);
+            }
+        }
+    }
+    for (int i = 0; i < NUM_SENSING_QUERIES; ++i) {
+        xs[i] = rand() % SENSING_GRID_SIZE;
+        ys[i] = rand() % SENSING_GRID_SIZE;
+    }
+
+    float sum = 0;
+    clock_t start = clock();
+    for (int i = 0; i < NUM_SENSING_QUERIES; ++i) {
+        for (int id = L_n; id <= L_nw; ++id) {
+            sum += get_sensory_data(id, xs[i], ys[i], grid);
+        }
+    }
+    double switch_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    start = clock();
+    for (int i = 0; i < NUM_SENSING_QUERIES; ++i) {
+        uint16_t neighborhood = sense_neighborhood(grid, xs[i], ys[i]);
+        for (int id = L_n; id <= L_nw; ++id) {
+            sum -= get_neighborhood_sensory_data(id, neighborhood, xs[i], ys[i], grid);
+        }
+    }
+    double neighborhood_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    start = clock();
+    for (int i = 0; i < NUM_SENSING_QUERIES; ++i) {
+        for (int id = LW_n; id <= LW_nw; ++id) {
+            sum += get_sensory_data(id, xs[i], ys[i], grid);
+        }
+    }
+    double wall_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    start = clock();
+    build_wall_distances(grid);
+    double build_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    printf("Sensing, all eight sensors of one direction group per cell (checksum %g)\n", sum);
+    printf("%-28s %10.1f ns\n", "L_* per-sensor switch", switch_seconds * 1e9 / NUM_SENSING_QUERIES);
+    printf("%-28s %10.1f ns\n", "L_* 3x3 neighborhood", neighborhood_seconds * 1e9 / NUM_SENSING_QUERIES);
+    printf("%-28s %10.1f ns\n", "LW_* distance fields", wall_seconds * 1e9 / NUM_SENSING_QUERIES);
+    printf("%-28s %10.1f ms\n\n", "Distance field rebuild", build_seconds * 1e3);
+    free(xs);
+    free(ys);
+    free_grid(grid);
+}
+
+// Wall-clock time in seconds, for timings that span several threads
+static double wall_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+// Create a size x size grid with room for num_creatures creatures of 32 genes,
+// seeded with 1, exiting if allocation fails. The creatures are not spawned yet,
+// so the grid can be configured first.
+static Grid* create_run(uint16_t size, uint32_t num_creatures, uint32_t max_steps, Creature** creatures) {
+    Grid* grid = initialize_grid(size, size, num_creatures, max_steps, 32);
+    *creatures = malloc(num_creatures * sizeof(Creature));
+    if (!grid || !*creatures) {
+        fprintf(stderr, "Allocation failed.\n");
+        exit(1);
+    }
+    grid->seed = 1;
+    return grid;
+}
+
+// Release the brains of a run created by create_run, then deallocate it
+static void free_run(Grid* grid, Creature* creatures) {
+    for (uint32_t i = 0; i < grid->max_creatures; ++i) {
+        release_brain(grid->brain_cache, creatures[i].brain);
+    }
+    free(creatures);
+    free_grid(grid);
+}
+
+// Time one generation boundary (breeding, brain compilation, placement) of a
+// large population, on one thread and on one thread per processor
+static void benchmark_mating(void) {
+    uint32_t thread_counts[2] = {1, default_thread_count()};
+    printf("Generation boundary (%d creatures)\n", NUM_MATING_CREATURES);
+    for (int t = 0; t < 2; ++t) {
+        Creature* creatures;
+        Grid* grid = create_run(MATING_GRID_SIZE, NUM_MATING_CREATURES, 1, &creatures);
+        if (set_grid_threads(grid, thread_counts[t], false) != 0) {
+            fprintf(stderr, "Allocation failed.\n");
+            exit(1);
+        }
+        spawn_creatures(grid, creatures);
+        double start = wall_seconds();
+        mate_creatures(grid, creatures);
+        double seconds = wall_seconds() - start;
+        printf("%4u thread(s) %10.1f ms\n", thread_counts[t], seconds * 1e3);
+        free_run(grid, creatures);
+    }
+    printf("\n");
+}
+
+// Whether two networks have the same neurons, connections in the same CSR
+// order, sensory and output slots and folded action
+static bool same_network(const NeuralNetwork* a, const NeuralNetwork* b) {
+    if (a->total_neurons != b->total_neurons || a->num_connections != b->num_connections ||
+        a->num_sensory_neurons != b->num_sensory_neurons || a->num_output_neurons != b->num_output_neurons ||
+        a->constant_action != b->constant_action || a->genome_hash != b->genome_hash) {
+        return false;
+    }
+    for (int i = 0; i < a->total_neurons; ++i) {
+        const Neuron* x = &a->neurons[i];
+        const Neuron* y = &b->neurons[i];
+        if (x->type != y->type || x->id != y->id || x->activation_threshold != y->activation_threshold ||
+            x->num_connections != y->num_connections || x->connections - a->connections != y->connections - b->connections) {
+            return false;
+        }
+    }
+    for (int i = 0; i < a->num_connections; ++i) {
+        const Connection* x = &a->connections[i];
+        const Connection* y = &b->connections[i];
+        if (x->source != y->source || x->target != y->target || x->id != y->id || x->weight != y->weight ||
+            x->activation_function != y->activation_function) {
+            return false;
+        }
+    }
+    size_t sensory_bytes = a->num_sensory_neurons * sizeof(uint16_t);
+    size_t output_bytes = a->num_output_neurons * sizeof(uint16_t);
+    return memcmp(a->sensory_ids, b->sensory_ids, sensory_bytes) == 0 &&
+           memcmp(a->sensory_indices, b->sensory_indices, sensory_bytes) == 0 &&
+           memcmp(a->output_ids, b->output_ids, output_bytes) == 0 &&
+           memcmp(a->output_indices, b->output_indices, output_bytes) == 0;
+}
+
+// Check that patching a network gives exactly the network compiled from scratch,
+// for mutants of 1 to MAX_DERIVED_GENES genes. Most flips hit the weight or
+// activation bits (8 to 39), which keeps the shape and takes the patching path.
+static void check_derived_networks(void) {
+    for (int l = 0; l < 1000; ++l) {
+        int genome_length = 8 + rand() % 121;
+        Gene genome[128];
+        Gene mutant[128];
+        NeuralNetwork* base;
+        do {
+            for (int i = 0; i < genome_length; ++i) {
+                genome[i].gene = random_gene();
+            }
+            base = initialize_neural_network(genome, genome_length);
+        } while (!base);
+
+        for (int m = 0; m < 20; ++m) {
+            memcpy(mutant, genome, genome_length * sizeof(Gene));
+            int max_changed = genome_length < MAX_DERIVED_GENES ? genome_length : MAX_DERIVED_GENES;
+            int num_changed = 1 + rand() % max_changed;
+            int changed_genes[MAX_DERIVED_GENES];
+            // Distinct genes in ascending order, as acquire_brains lists them
+            for (int i = 0, c = 0; c < num_changed; ++i) {
+                if (rand() % (genome_length - i) < num_changed - c) {
+                    changed_genes[c++] = i;
+                    int bit = rand() % 4 ? 8 + rand() % 32 : rand() % 64;
+                    mutant[i].gene ^= 1ULL << bit;
+                }
+            }
+            NeuralNetwork* compiled = initialize_neural_network(mutant, genome_length);
+            NeuralNetwork* derived = derive_neural_network(base, genome, mutant, genome_length, changed_genes, num_changed);
+            if (!compiled != !derived || (compiled && !same_network(compiled, derived))) {
+                fprintf(stderr, "Network derived from %d changed genes differs from the compiled one.\n", num_changed);
+                exit(1);
+            }
+            free_neural_network(compiled);
+            free_neural_network(derived);
+        }
+        free_neural_network(base);
+    }
+}
+
+// Time rebuilding the brain of a genome after one random bit flip, compiled
+// from scratch and derived from the unmutated brain
+static void benchmark_rebuild(void) {
+    static const int genome_lengths[] = {8, 32, 128};
+    printf("Brain rebuild after a point mutation (%d mutants)\n", NUM_REBUILDS);
+    printf("%8s %14s %14s\n", "Genes", "Compile ns", "Derive ns");
+    for (size_t l = 0; l < sizeof(genome_lengths) / sizeof(genome_lengths[0]); ++l) {
+        int genome_length = genome_lengths[l];
+        Gene* genome = malloc(genome_length * sizeof(Gene));
+        Gene* mutant = malloc(genome_length * sizeof(Gene));
+        if (!genome || !mutant) {
+            fprintf(stderr, "Allocation failed.\n");
+            exit(1);
+        }
+        NeuralNetwork* base;
+        do {
+            for (int i = 0; i < genome_length; ++i) {
+                genome[i].gene = random_gene();
+            }
+            base = initialize_neural_network(genome, genome_length);
+        } while (!base);
+        memcpy(mutant, genome, genome_length * sizeof(Gene));
+
+        double seconds[2] = {0, 0};
+        for (int r = 0; r < NUM_REBUILDS; ++r) {
+            int changed_gene = rand() % genome_length;
+            mutant[changed_gene].gene ^= 1ULL << (rand() % 64);
+            clock_t start = clock();
+            NeuralNetwork* compiled = initialize_neural_network(mutant, genome_length);
+            seconds[0] += (double)(clock() - start) / CLOCKS_PER_SEC;
+            start = clock();
+            NeuralNetwork* derived = derive_neural_network(base, genome, mutant, genome_length, &changed_gene, 1);
+            seconds[1] += (double)(clock() - start) / CLOCKS_PER_SEC;
+            free_neural_network(compiled);
+            free_neural_network(derived);
+            mutant[changed_gene] = genome[changed_gene];
+        }
+        printf("%8d %14.1f %14.1f\n", genome_length, seconds[0] * 1e9 / NUM_REBUILDS, seconds[1] * 1e9 / NUM_REBUILDS);
+        free_neural_network(base);
+        free(genome);
+        free(mutant);
+    }
+    check_derived_networks();
+    printf("\n");
+}
+
+// Size of a file in bytes, -1 if it cannot be opened
+static long file_size(const char* filename) {
+    FILE* file = fopen(filename, "rb");
+    if (!file) {
+        return -1;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    return size;
+}
+
+// Time writing one frame of a populated grid as CSV and as a binary snapshot
+static void benchmark_snapshot(void) {
+    static const uint16_t grid_sizes[] = {300, 1000};
+    static const char* csv_file = "benchmark_frame.csv";
+    static const char* snapshot_file = "benchmark_frame.snap";
+    printf("Frame export (%d frames per grid)\n", NUM_SNAPSHOT_FRAMES);
+    printf("%10s %12s %12s %12s %12s\n", "Grid", "CSV ms", "CSV KB", "Binary ms", "Binary KB");
+    for (size_t g = 0; g < sizeof(grid_sizes) / sizeof(grid_sizes[0]); ++g) {
+        uint16_t size = grid_sizes[g];
+        uint32_t num_creatures = (uint32_t)size * size / 100;
+        Creature* creatures;
+        Grid* grid = create_run(size, num_creatures, 300, &creatures);
+        spawn_creatures(grid, creatures);
+        update_grid(grid, creatures);
+
+        double seconds[2] = {0, 0};
+        for (int frame = 0; frame < NUM_SNAPSHOT_FRAMES; ++frame) {
+            double start = wall_seconds();
+            output_grid_to_csv(grid, csv_file);
+            seconds[0] += wall_seconds() - start;
+            start = wall_seconds();
+            output_grid_snapshot(grid, creatures, snapshot_file);
+            seconds[1] += wall_seconds() - start;
+        }
+        char label[32];
+        snprintf(label, sizeof(label), "%ux%u", size, size);
+        printf("%10s %12.2f %12.1f %12.2f %12.1f\n", label,
+               seconds[0] * 1e3 / NUM_SNAPSHOT_FRAMES, file_size(csv_file) / 1024.0,
+               seconds[1] * 1e3 / NUM_SNAPSHOT_FRAMES, file_size(snapshot_file) / 1024.0);
+        remove(csv_file);
+        remove(snapshot_file);
+        free_run(grid, creatures);
+    }
+    printf("\n");
+}
+
+// Run NUM_REPLAY_STEPS steps of a fresh grid, recording them if filename is
+// set, returns the wall-clock time spent stepping and recording
+static double time_recorded_steps(uint16_t size, uint32_t num_creatures, const char* filename) {
+    Creature* creatures;
+    Grid* grid = create_run(size, num_creatures, 300, &creatures);
+    spawn_creatures(grid, creatures);
+    ReplayRecorder* recorder = filename ? create_replay_recorder(grid, filename, 0) : NULL;
+    double start = wall_seconds();
+    for (int step = 0; step < NUM_REPLAY_STEPS; ++step) {
+        update_grid(grid, creatures);
+        if (recorder) {
+            record_replay_step(recorder, grid, creatures);
+        }
+    }
+    close_replay_recorder(recorder);
+    double seconds = wall_seconds() - start;
+    free_run(grid, creatures);
+    return seconds;
+}
+
+// Whether the frame a replay reader decoded matches a snapshot of the live grid.
+// Energy is not recorded in deltas, so it is not compared.
+static bool same_replay_frame(const ReplayReader* reader, const uint8_t* snapshot) {
+    SnapshotHeader header;
+    memcpy(&header, snapshot, sizeof(header));
+    size_t plane_bytes = (size_t)header.num_planes * header.plane_words * sizeof(uint64_t);
+    if (reader->frame.generation != header.generation || reader->frame.step != header.step ||
+        reader->frame.num_creatures != header.num_creatures || reader->frame.plane_words != header.plane_words ||
+        memcmp(reader->planes, snapshot + sizeof(header), plane_bytes) != 0) {
+        return false;
+    }
+    // The creatures left on the grid are the keyframe's slots still marked, in the same order
+    const uint8_t* records = snapshot + sizeof(header) + plane_bytes;
+    uint32_t k = 0;
+    for (uint32_t s = 0; s < reader->num_slots; ++s) {
+        if (!reader->on_grid[s]) {
+            continue;
+        }
+        SnapshotCreature record;
+        memcpy(&record, records + (size_t)k++ * sizeof(record), sizeof(record));
+        const SnapshotCreature* decoded = &reader->creatures[s];
+        if (decoded->id != record.id || decoded->x != record.x || decoded->y != record.y || decoded->age != record.age) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Check that decoding a replay, frame by frame and by seeking, rebuilds every
+// recorded step exactly as a snapshot of the live grid taken at that step
+static void check_replay(void) {
+    static const char* replay_file = "benchmark_check.rpl";
+    Creature* creatures;
+    Grid* grid = create_run(100, 200, 300, &creatures);
+    size_t capacity = snapshot_capacity(grid);
+    uint8_t* frames = malloc((size_t)NUM_REPLAY_STEPS * capacity);
+    if (!frames) {
+        fprintf(stderr, "Allocation failed.\n");
+        exit(1);
+    }
+    spawn_creatures(grid, creatures);
+    // Keyframes every 50 steps, so seeks also start within a generation
+    ReplayRecorder* recorder = create_replay_recorder(grid, replay_file, 50);
+    if (!recorder) {
+        fprintf(stderr, "Could not write %s.\n", replay_file);
+        exit(1);
+    }
+    for (int step = 0; step < NUM_REPLAY_STEPS; ++step) {
+        update_grid(grid, creatures);
+        record_replay_step(recorder, grid, creatures);
+        encode_snapshot(grid, creatures, frames + (size_t)step * capacity);
+    }
+    if (close_replay_recorder(recorder) != 0) {
+        fprintf(stderr, "Could not write %s.\n", replay_file);
+        exit(1);
+    }
+
+    ReplayReader* reader = open_replay(replay_file);
+    if (!reader) {
+        fprintf(stderr, "Could not read %s.\n", replay_file);
+        exit(1);
+    }
+    for (int step = 0; step < NUM_REPLAY_STEPS; ++step) {
+        if (next_replay_frame(reader) != 0 || !same_replay_frame(reader, frames + (size_t)step * capacity)) {
+            fprintf(stderr, "Replay frame %d differs from the recorded grid.\n", step);
+            exit(1);
+        }
+    }
+    for (int s = 0; s < NUM_REPLAY_SEEKS; ++s) {
+        int step = rand() % NUM_REPLAY_STEPS;
+        const uint8_t* snapshot = frames + (size_t)step * capacity;
+        SnapshotHeader header;
+        memcpy(&header, snapshot, sizeof(header));
+        if (seek_replay(reader, header.generation, header.step) != 0 || !same_replay_frame(reader, snapshot)) {
+            fprintf(stderr, "Seeking to replay frame %d differs from the recorded grid.\n", step);
+            exit(1);
+        }
+    }
+    close_replay(reader);
+    remove(replay_file);
+
+    free(frames);
+    free_run(grid, creatures);
+}
+
+// Time stepping with and without recording a replay, and seeking in the replay
+static void benchmark_replay(void) {
+    static const uint16_t grid_sizes[] = {300, 1000};
+    static const uint32_t populations[] = {200, 10000};
+    static const char* replay_file = "benchmark_replay.rpl";
+    printf("Replay recording (%d steps)\n", NUM_REPLAY_STEPS);
+    printf("%10s %10s %12s %12s %10s %12s %10s\n", "Grid", "Creatures", "Step us", "Recorded us", "Overhead", "Bytes/step", "Seek ms");
+    for (size_t c = 0; c < sizeof(grid_sizes) / sizeof(grid_sizes[0]); ++c) {
+        double plain = time_recorded_steps(grid_sizes[c], populations[c], NULL);
+        double recorded = time_recorded_steps(grid_sizes[c], populations[c], replay_file);
+
+        ReplayReader* reader = open_replay(replay_file);
+        if (!reader) {
+            fprintf(stderr, "Could not read %s.\n", replay_file);
+            exit(1);
+        }
+        double start = wall_seconds();
+        for (int s = 0; s < NUM_REPLAY_SEEKS; ++s) {
+            // Steps 1 to 300 of the second generation were recorded
+            seek_replay(reader, 1, 1 + rand() % 300);
+        }
+        double seek_seconds = (wall_seconds() - start) / NUM_REPLAY_SEEKS;
+        close_replay(reader);
+
+        char label[32];
+        snprintf(label, sizeof(label), "%ux%u", grid_sizes[c], grid_sizes[c]);
+        printf("%10s %10u %12.1f %12.1f %9.1f%% %12.0f %10.2f\n", label, populations[c],
+               plain * 1e6 / NUM_REPLAY_STEPS, recorded * 1e6 / NUM_REPLAY_STEPS, (recorded / plain - 1) * 100,
+               (double)file_size(replay_file) / NUM_REPLAY_STEPS, seek_seconds * 1e3);
+        remove(replay_file);
+    }
+    check_replay();
+    printf("\n");
+}
+
+// Time stepping a 300x300 grid while exporting a binary snapshot every step,
+// written directly or through a snapshot writer with each policy
+static void benchmark_snapshot_writer(void) {
+    static const char* labels[] = {"none", "direct", "inline", "block", "drop", "decimate"};
+    static const WriterPolicy policies[] = {WRITER_INLINE, WRITER_BLOCK, WRITER_DROP, WRITER_DECIMATE};
+    static const char* snapshot_file = "benchmark_export.snap";
+    printf("Snapshot export while stepping (300x300, 200 creatures, %d steps, 16 slots)\n", NUM_EXPORT_STEPS);
+    printf("%10s %12s %12s %12s\n", "Export", "Step us", "Written", "Dropped");
+    for (int mode = 0; mode < 6; ++mode) {
+        Creature* creatures;
+        Grid* grid = create_run(300, 200, 300, &creatures);
+        spawn_creatures(grid, creatures);
+        SnapshotWriter* writer = mode >= 2 ? create_snapshot_writer(grid, 16, policies[mode - 2]) : NULL;
+        if (mode >= 2 && !writer) {
+            fprintf(stderr, "Snapshot writer initialization failed.\n");
+            exit(1);
+        }
+
+        // The simulation only waits for the writer when a frame finds the ring full
+        double start = wall_seconds();
+        for (int step = 0; step < NUM_EXPORT_STEPS; ++step) {
+            update_grid(grid, creatures);
+            if (mode == 1) {
+                output_grid_snapshot(grid, creatures, snapshot_file);
+            } else if (writer) {
+                queue_snapshot(writer, grid, creatures, snapshot_file, SNAPSHOT_BINARY);
+            }
+        }
+        double seconds = wall_seconds() - start;
+        uint64_t written = mode == 1 ? NUM_EXPORT_STEPS : 0;
+        uint64_t dropped = 0;
+        if (writer) {
+            flush_snapshot_writer(writer);
+            written = writer->frames_written;
+            dropped = writer->frames_dropped;
+            close_snapshot_writer(writer);
+        }
+        printf("%10s %12.1f %12llu %12llu\n", labels[mode], seconds * 1e6 / NUM_EXPORT_STEPS,
+               (unsigned long long)written, (unsigned long long)dropped);
+        remove(snapshot_file);
+        free_run(grid, creatures);
+    }
+    printf("\n");
+}
+
+// Whether two runs are in the same state: counters, cells, every creature with
+// its genome, and the neuron values of the brain batch
+static bool same_run(const Grid* a, const Creature* a_creatures, const Grid* b, const Creature* b_creatures) {
+    if (a->steps_taken != b->steps_taken || a->generation != b->generation || a->num_generations != b->num_generations ||
+        a->num_creatures != b->num_creatures ||
+        memcmp(a->cell_flags[0], b->cell_flags[0],
+               (size_t)NUM_CELL_FLAGS * grid_plane_words(a->width, a->height) * sizeof(uint64_t)) != 0 ||
+        memcmp(a->live_creatures, b->live_creatures, a->num_creatures * sizeof(uint32_t)) != 0) {
+        return false;
+    }
+    for (uint32_t i = 0; i < a->max_creatures; ++i) {
+        const Creature* x = &a_creatures[i];
+        const Creature* y = &b_creatures[i];
+        if (x->position.x != y->position.x || x->position.y != y->position.y || x->energy != y->energy ||
+            x->age != y->age || memcmp(x->genome, y->genome, a->num_genomes * sizeof(Gene)) != 0) {
+            return false;
+        }
+    }
+    const BrainBatch* x = a->brain_batch;
+    const BrainBatch* y = b->brain_batch;
+    if (!x || !y) {
+        return !x && !y;
+    }
+    uint32_t num_values = x->value_offsets[x->num_creatures];
+    if (x->precision != y->precision || num_values != y->value_offsets[y->num_creatures]) {
+        return false;
+    }
+    return x->precision == BRAIN_PRECISION_FIXED
+        ? memcmp(x->values_fixed, y->values_fixed, num_values * sizeof(int16_t)) == 0
+        : memcmp(x->values, y->values, num_values * sizeof(float)) == 0;
+}
+
+// Check that a run restored from a checkpoint goes on exactly as the saved one:
+// save in the middle of a generation, restore into a fresh grid, and step both
+// past the next generation boundary, in every brain precision
+static void check_checkpoint_round_trip(void) {
+    static const char* checkpoint_file = "benchmark_check.ckpt";
+    for (int precision = 0; precision < 2; ++precision) {
+        Creature* creatures;
+        Grid* grid = create_run(100, 200, 300, &creatures);
+        grid->seed = 7;
+        grid->brain_precision = precision ? BRAIN_PRECISION_FIXED : BRAIN_PRECISION_FLOAT;
+        spawn_creatures(grid, creatures);
+        for (int step = 0; step < 250; ++step) {
+            update_grid(grid, creatures);
+        }
+        if (save_checkpoint(grid, creatures, checkpoint_file) != 0) {
+            fprintf(stderr, "Could not save %s.\n", checkpoint_file);
+            exit(1);
+        }
+        Creature* restored_creatures;
+        Grid* restored = load_checkpoint(checkpoint_file, &restored_creatures);
+        if (!restored) {
+            fprintf(stderr, "Could not restore %s.\n", checkpoint_file);
+            exit(1);
+        }
+        remove(checkpoint_file);
+        for (int step = 0; step <= 100; ++step) {
+            if (!same_run(grid, creatures, restored, restored_creatures)) {
+                fprintf(stderr, "Run restored from a checkpoint differs %d steps later.\n", step);
+                exit(1);
+            }
+            update_grid(grid, creatures);
+            update_grid(restored, restored_creatures);
+        }
+        free_run(grid, creatures);
+        free_run(restored, restored_creatures);
+    }
+}
+
+// Time saving and restoring a checkpoint of a run a few steps in
+static void benchmark_checkpoint(void) {
+    static const uint16_t grid_sizes[] = {300, 1000};
+    static const uint32_t populations[] = {200, 10000};
+    static const char* checkpoint_file = "benchmark.ckpt";
+    printf("Checkpoints (%d per grid)\n", NUM_CHECKPOINTS);
+    printf("%10s %10s %12s %12s %12s\n", "Grid", "Creatures", "Save ms", "Restore ms", "KB");
+    for (size_t c = 0; c < sizeof(grid_sizes) / sizeof(grid_sizes[0]); ++c) {
+        Creature* creatures;
+        Grid* grid = create_run(grid_sizes[c], populations[c], 300, &creatures);
+        spawn_creatures(grid, creatures);
+        for (int step = 0; step < 10; ++step) {
+            update_grid(grid, creatures);
+        }
+
+        double seconds[2] = {0, 0};
+        for (int i = 0; i < NUM_CHECKPOINTS; ++i) {
+            double start = wall_seconds();
+            if (save_checkpoint(grid, creatures, checkpoint_file) != 0) {
+                fprintf(stderr, "Could not save %s.\n", checkpoint_file);
+                exit(1);
+            }
+            seconds[0] += wall_seconds() - start;
+            start = wall_seconds();
+            Creature* restored_creatures;
+            Grid* restored = load_checkpoint(checkpoint_file, &restored_creatures);
+            seconds[1] += wall_seconds() - start;
+            if (!restored) {
+                fprintf(stderr, "Could not restore %s.\n", checkpoint_file);
+                exit(1);
+            }
+            free_run(restored, restored_creatures);
+        }
+        char label[32];
+        snprintf(label, sizeof(label), "%ux%u", grid_sizes[c], grid_sizes[c]);
+        printf("%10s %10u %12.2f %12.2f %12.1f\n", label, populations[c], seconds[0] * 1e3 / NUM_CHECKPOINTS,
+               seconds[1] * 1e3 / NUM_CHECKPOINTS, file_size(checkpoint_file) / 1024.0);
+        remove(checkpoint_file);
+        free_run(grid, creatures);
+    }
+    check_checkpoint_round_trip();
+    printf("\n");
+}
+
+#ifndef _WIN32
+
+// Genome archives are memory-mapped, so they are only benchmarked where mmap exists
+
+// Hash every genome of the current generation into hashes, by creature index
+static void hash_generation(const Grid* grid, const Creature* creatures, uint64_t* hashes) {
+    for (uint32_t i = 0; i < grid->max_creatures; ++i) {
+        hashes[i] = hash_genome(creatures[i].genome, grid->num_genomes);
+    }
+}
+
+// Check an archive read back from a fresh mapping of the file: one complete
+// block per generation in order, the genomes hashed while the run was live,
+// every generation but the last with its survivors marked, and every parent a
+// survivor of the generation before (or anyone, if nobody survived)
+static void check_genome_archive(const char* filename, const uint64_t* hashes, uint32_t num_genomes,
+                                 uint32_t num_generations) {
+    int fd = open(filename, O_RDONLY);
+    struct stat status;
+    if (fd < 0 || fstat(fd, &status) != 0) {
+        fprintf(stderr, "Could not read %s.\n", filename);
+        exit(1);
+    }
+    uint8_t* data = mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "Could not map %s.\n", filename);
+        exit(1);
+    }
+    uint64_t offset = GENOME_ARCHIVE_ALIGNMENT;
+    GenomeArchiveGeneration* previous = NULL;
+    for (uint32_t g = 0; g < num_generations; ++g) {
+        GenomeArchiveGeneration* generation = (GenomeArchiveGeneration*)(data + offset);
+        bool last = g + 1 == num_generations;
+        if (offset + sizeof(*generation) > (uint64_t)status.st_size || generation->magic != GENOME_ARCHIVE_MAGIC ||
+            generation->generation != g || generation->num_genomes != num_genomes ||
+            !(generation->flags & ARCHIVE_GENOMES_COMPLETE) || !(generation->flags & ARCHIVE_SURVIVAL_RECORDED) == !last) {
+            fprintf(stderr, "Archived generation %u is missing or incomplete.\n", g);
+            exit(1);
+        }
+        const GenomeArchiveRecord* records = archived_records(generation);
+        const GenomeArchiveRecord* previous_records = previous ? archived_records(previous) : NULL;
+        uint32_t num_survivors = 0;
+        for (uint32_t i = 0; i < num_genomes; ++i) {
+            bool bred_from_survivors = previous && previous->num_survivors > 0;
+            bool parents_valid = true;
+            for (int k = 0; k < 2; ++k) {
+                uint32_t parent = records[i].parents[k];
+                parents_valid &= previous ? parent < num_genomes && (!bred_from_survivors || previous_records[parent].survived)
+                                          : parent == GENOME_ARCHIVE_NO_PARENT;
+            }
+            if (hash_genome(archived_genome(generation, i), (int)generation->genome_length) != hashes[(size_t)g * num_genomes + i] ||
+                !parents_valid) {
+                fprintf(stderr, "Archived genome %u of generation %u or its parents differ from the run.\n", i, g);
+                exit(1);
+            }
+            num_survivors += records[i].survived;
+        }
+        if (num_survivors != generation->num_survivors) {
+            fprintf(stderr, "Archived generation %u marks %u survivors instead of %u.\n", g, num_survivors,
+                    generation->num_survivors);
+            exit(1);
+        }
+        previous = generation;
+        offset += generation->size;
+    }
+    munmap(data, status.st_size);
+}
+
+// Time the generation boundary with genomes bred into the ordinary arena and
+// straight into a genome archive, and the size each generation adds to it
+static void benchmark_genome_archive(void) {
+    static const char* archive_file = "benchmark.genomes";
+    printf("Genome archive (%d creatures, %d generations)\n", NUM_MATING_CREATURES, NUM_ARCHIVED_GENERATIONS);
+    printf("%10s %14s %14s\n", "Archive", "ms/generation", "MB/generation");
+    for (int archived = 0; archived < 2; ++archived) {
+        remove(archive_file);
+        Creature* creatures;
+        Grid* grid = create_run(MATING_GRID_SIZE, NUM_MATING_CREATURES, 1, &creatures);
+        if (archived) {
+            grid->genome_archive = open_genome_archive(archive_file);
+            if (!grid->genome_archive) {
+                fprintf(stderr, "Could not open %s.\n", archive_file);
+                exit(1);
+            }
+        }
+        // Genome hashes of every generation, to check the archive against
+        uint64_t* hashes = archived ? malloc((size_t)(NUM_ARCHIVED_GENERATIONS + 1) * NUM_MATING_CREATURES * sizeof(uint64_t)) : NULL;
+        if (archived && !hashes) {
+            fprintf(stderr, "Allocation failed.\n");
+            exit(1);
+        }
+        spawn_creatures(grid, creatures);
+        long spawned_size = archived ? file_size(archive_file) : 0;
+        if (hashes) {
+            hash_generation(grid, creatures, hashes);
+        }
+        double seconds = 0;
+        for (int g = 0; g < NUM_ARCHIVED_GENERATIONS; ++g) {
+            double start = wall_seconds();
+            mate_creatures(grid, creatures);
+            seconds += wall_seconds() - start;
+            if (hashes) {
+                hash_generation(grid, creatures, hashes + (size_t)(g + 1) * NUM_MATING_CREATURES);
+            }
+        }
+        if (archived && grid->genome_archive->failed) {
+            fprintf(stderr, "Could not archive every generation to %s.\n", archive_file);
+            exit(1);
+        }
+        close_genome_archive(grid->genome_archive);
+        double megabytes = archived ? (file_size(archive_file) - spawned_size) / 1048576.0 / NUM_ARCHIVED_GENERATIONS : 0;
+        printf("%10s %14.1f %14.2f\n", archived ? "mapped" : "none", seconds * 1e3 / NUM_ARCHIVED_GENERATIONS, megabytes);
+        if (hashes) {
+            check_genome_archive(archive_file, hashes, NUM_MATING_CREATURES, NUM_ARCHIVED_GENERATIONS + 1);
+            free(hashes);
+        }
+        remove(archive_file);
+        free_run(grid, creatures);
+    }
+    printf("\n");
+}
+
+#endif
+
+int main(void) {
+    static const int genome_lengths[] = {4, 8, 16, 32, 64, 128};
+    NeuralNetwork** brains_by_length[sizeof(genome_lengths) / sizeof(genome_lengths[0])];
+    int brains_per_length[sizeof(genome_lengths) / sizeof(genome_lengths[0])];
+    srand(1);
+
+    printf("Activation kernels (%s picked at runtime)\n", activation_kernel_name());
+    printf("%8s %-16s %14s %14s\n", "Function", "Kernel", "ns/value", "Max error");
+    for (uint8_t f = 0; f < NUM_ACTIVATION_FUNCTIONS; ++f) {
+        benchmark_activation("scalar precise", f, ACTIVATION_PRECISE, 1);
+        benchmark_activation("simd precise", f, ACTIVATION_PRECISE, 0);
+        benchmark_activation("simd fast", f, ACTIVATION_FAST, 0);
+    }
+    printf("\n");
+
+    printf("Q.12 activation kernels (every int16 input)\n");
+    printf("%8s %14s %14s\n", "Function", "Scalar ns", "SIMD ns");
+    for (uint8_t f = 0; f < NUM_ACTIVATION_FUNCTIONS; ++f) {
+        benchmark_activation_fixed(f);
+    }
+    check_fixed_conversion();
+    printf("\n");
+
+    benchmark_sensing();
+    benchmark_mating();
+    benchmark_rebuild();
+    benchmark_snapshot();
+    benchmark_replay();
+    benchmark_snapshot_writer();
+    benchmark_checkpoint();
+#ifndef _WIN32
+    benchmark_genome_archive();
+#endif
+
+    printf("Brain evaluation cost per step (%d brains x %d steps)\n", NUM_BRAINS, NUM_STEPS);
+    printf("%8s %10s %12s %10s %14s %14s %14s\n", "Genes", "Edges", "Cycles", "Folded", "Recursive ns", "Topological ns", "Batched ns");
+
+    for (size_t l = 0; l < sizeof(genome_lengths) / sizeof(genome_lengths[0]); ++l) {
+        int genome_length = genome_lengths[l];
+        Gene* genome = malloc(genome_length * sizeof(Gene));
+        NeuralNetwork** brains = malloc(NUM_BRAINS * sizeof(NeuralNetwork*));
+        if (!genome || !brains) {
+            fprintf(stderr, "Allocation failed.\n");
+            return 1;
+        }
+
+        // Only viable brains are benchmarked, like in the simulation
+        int num_brains = 0;
+        long edges = 0;
+        long cycles = 0;
+        long folded = 0;
+        while (num_brains < NUM_BRAINS) {
+            for (int i = 0; i < genome_length; ++i) {
+                genome[i].gene = random_gene();
+            }
+            NeuralNetwork* brain = initialize_neural_network(genome, genome_length);
+            if (!brain) {
+                continue;
+            }
+            for (int i = 0; i < brain->num_connections; ++i) {
+                if (brain->connections[i].target <= brain->connections[i].source) {
+                    cycles++;
+                }
+            }
+            edges += brain->num_connections;
+            folded += brain->constant_action >= 0;
+            brains[num_brains++] = brain;
+        }
+
+        double recursive_ns = time_evaluation(brains, num_brains, EVAL_RECURSIVE);
+        double topological_ns = time_evaluation(brains, num_brains, EVAL_TOPOLOGICAL);
+        BrainBatch* batch = build_brain_batch(brains, num_brains, BRAIN_PRECISION_FLOAT);
+        if (!batch) {
+            fprintf(stderr, "Allocation failed.\n");
+            return 1;
+        }
+        double batched_ns = time_batch_evaluation(batch);
+        printf("%8d %10.1f %12.2f %9.1f%% %14.1f %14.1f %14.1f\n", genome_length, (double)edges / num_brains,
+               (double)cycles / num_brains, 100.0 * folded / num_brains, recursive_ns, topological_ns, batched_ns);
+        free_brain_batch(batch);
+
+        brains_by_length[l] = brains;
+        brains_per_length[l] = num_brains;
+        free(genome);
+    }
+
+    printf("\nFloat vs fixed-point batched evaluation (%d steps)\n", NUM_STEPS);
+    printf("%8s %12s %12s %12s %12s %13s %14s\n", "Genes", "Float ns", "Fixed ns",
+           "Float B", "Fixed B", "Same action", "Output error");
+    for (size_t l = 0; l < sizeof(genome_lengths) / sizeof(genome_lengths[0]); ++l) {
+        compare_precisions(brains_by_length[l], brains_per_length[l], genome_lengths[l]);
+        for (int b = 0; b < brains_per_length[l]; ++b) {
+            free_neural_network(brains_by_length[l][b]);
+        }
+        free(brains_by_length[l]);
+    }
+    return 0;
+}
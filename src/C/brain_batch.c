@@ -0,0 +1,398 @@
+#include "brain_batch.h"
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <stdbool.h>
+
+// Connections address neuron values relative to their block with 16-bit indices
+_Static_assert(BRAIN_BATCH_BLOCK_SIZE * TOTAL_NEURONS <= 65536, "block values must be addressable with uint16_t");
+
+// Number of distinct run keys: cycle-closing runs plus one level per neuron, per activation function
+#define NUM_RUN_KEYS ((TOTAL_NEURONS + 1) * NUM_ACTIVATION_FUNCTIONS)
+
+// Allocate an array of `count` elements, always at least one so empty batches still succeed
+static void* batch_alloc(uint32_t count, size_t size) {
+    return malloc((count ? count : 1) * size);
+}
+
+// Whether a brain's connections are packed: folded brains only keep their constant action
+static bool is_packed(const NeuralNetwork* brain) {
+    return brain && brain->constant_action < 0;
+}
+
+// Sort key of every connection of a brain: cycle-closing connections first, then by
+// level (depth of the source neuron), each split by activation function
+static void compute_run_keys(const NeuralNetwork* brain, uint8_t* keys) {
+    uint8_t depth[TOTAL_NEURONS] = {0};
+    for (int i = 0; i < brain->num_connections; ++i) {
+        const Connection* connection = &brain->connections[i];
+        if (connection->target <= connection->source) {
+            keys[i] = connection->activation_function;
+            continue;
+        }
+        // Connections are grouped by source in topological order, so the source depth is final
+        if (depth[connection->target] < depth[connection->source] + 1) {
+            depth[connection->target] = depth[connection->source] + 1;
+        }
+        keys[i] = (depth[connection->source] + 1) * NUM_ACTIVATION_FUNCTIONS + connection->activation_function;
+    }
+}
+
+/**
+ * Pack a population of compiled brains into a batch.
+ *
+ * @param brains Array of brains, NULL entries pack as empty brains.
+ * @param num_brains Number of brains.
+ * @param precision Number format used to store and evaluate the brains.
+ * @return Pointer to the new batch, or NULL if allocation failed.
+ */
+BrainBatch* build_brain_batch(NeuralNetwork** brains, uint32_t num_brains, BrainPrecision precision) {
+    BrainBatch* batch = calloc(1, sizeof(BrainBatch));
+    if (!batch) {
+        return NULL;  // Allocation failed
+    }
+    batch->num_creatures = num_brains;
+    batch->precision = precision;
+    batch->accuracy = ACTIVATION_PRECISE;
+    init_activation_kernels();
+    batch->num_blocks = (num_brains + BRAIN_BATCH_BLOCK_SIZE - 1) / BRAIN_BATCH_BLOCK_SIZE;
+
+    uint32_t num_values = 0;
+    uint32_t num_sensors = 0;
+    uint32_t num_outputs = 0;
+    uint32_t num_edges = 0;
+    for (uint32_t i = 0; i < num_brains; ++i) {
+        if (is_packed(brains[i])) {
+            num_values += brains[i]->total_neurons;
+            num_sensors += brains[i]->num_sensory_neurons;
+            num_outputs += brains[i]->num_output_neurons;
+            num_edges += brains[i]->num_connections;
+        }
+    }
+
+    batch->value_offsets = batch_alloc(num_brains + 1, sizeof(uint32_t));
+    batch->sensor_offsets = batch_alloc(num_brains + 1, sizeof(uint32_t));
+    batch->output_offsets = batch_alloc(num_brains + 1, sizeof(uint32_t));
+    batch->sensor_ids = batch_alloc(num_sensors, sizeof(uint8_t));
+    batch->sensor_slots = batch_alloc(num_sensors, sizeof(uint32_t));
+    batch->sensor_inputs = batch_alloc(num_sensors, sizeof(float));
+    batch->output_ids = batch_alloc(num_outputs, sizeof(uint8_t));
+    batch->output_slots = batch_alloc(num_outputs, sizeof(uint32_t));
+    batch->block_runs = batch_alloc(batch->num_blocks + 1, sizeof(uint32_t));
+    batch->block_forward_runs = batch_alloc(batch->num_blocks, sizeof(uint32_t));
+    batch->runs = batch_alloc(batch->num_blocks * NUM_RUN_KEYS, sizeof(EdgeRun));
+    batch->edge_sources = batch_alloc(num_edges, sizeof(uint16_t));
+    batch->edge_targets = batch_alloc(num_edges, sizeof(uint16_t));
+    bool fixed = precision == BRAIN_PRECISION_FIXED;
+    if (fixed) {
+        batch->sensor_inputs_fixed = batch_alloc(num_sensors, sizeof(int16_t));
+        batch->output_thresholds_fixed = batch_alloc(num_outputs, sizeof(int16_t));
+        batch->edge_weights_fixed = batch_alloc(num_edges, sizeof(int16_t));
+        batch->values_fixed = calloc(num_values ? num_values : 1, sizeof(int16_t));
+        batch->incoming_fixed = batch_alloc(num_values, sizeof(int16_t));
+    } else {
+        batch->output_thresholds = batch_alloc(num_outputs, sizeof(float));
+        batch->edge_weights = batch_alloc(num_edges, sizeof(float));
+        batch->values = calloc(num_values ? num_values : 1, sizeof(float));
+        batch->incoming = batch_alloc(num_values, sizeof(float));
+    }
+    batch->active = calloc(num_brains ? num_brains : 1, sizeof(uint8_t));
+    batch->actions = calloc(num_brains ? num_brains : 1, sizeof(uint8_t));
+    batch->constant_actions = batch_alloc(num_brains, sizeof(uint8_t));
+    uint8_t* keys = batch_alloc(num_edges, sizeof(uint8_t));
+    if (!batch->value_offsets || !batch->sensor_offsets || !batch->output_offsets ||
+        !batch->sensor_ids || !batch->sensor_slots || !batch->sensor_inputs ||
+        !batch->output_ids || !batch->output_slots ||
+        !batch->block_runs || !batch->block_forward_runs || !batch->runs ||
+        !batch->edge_sources || !batch->edge_targets || !batch->active || !batch->actions || !batch->constant_actions || !keys ||
+        (fixed && (!batch->sensor_inputs_fixed || !batch->output_thresholds_fixed || !batch->edge_weights_fixed || !batch->values_fixed || !batch->incoming_fixed)) ||
+        (!fixed && (!batch->output_thresholds || !batch->edge_weights || !batch->values || !batch->incoming))) {
+        free(keys);
+        free_brain_batch(batch);
+        return NULL;  // Allocation failed
+    }
+
+    // Per-creature offsets and the sensory and output slots
+    uint32_t value = 0;
+    uint32_t sensor = 0;
+    uint32_t output = 0;
+    uint32_t edge = 0;
+    for (uint32_t i = 0; i < num_brains; ++i) {
+        batch->value_offsets[i] = value;
+        batch->sensor_offsets[i] = sensor;
+        batch->output_offsets[i] = output;
+        NeuralNetwork* brain = brains[i];
+        batch->constant_actions[i] = brain && brain->constant_action >= 0 ? brain->constant_action : NOT_FOLDED;
+        if (!is_packed(brain)) {
+            continue;
+        }
+        for (int s = 0; s < brain->num_sensory_neurons; ++s, ++sensor) {
+            batch->sensor_ids[sensor] = brain->sensory_ids[s];
+            batch->sensor_slots[sensor] = value + brain->sensory_indices[s];
+        }
+        for (int o = 0; o < brain->num_output_neurons; ++o, ++output) {
+            batch->output_ids[output] = brain->output_ids[o];
+            batch->output_slots[output] = value + brain->output_indices[o];
+            float threshold = brain->neurons[brain->output_indices[o]].activation_threshold;
+            if (fixed) {
+                batch->output_thresholds_fixed[output] = (int16_t)float_to_fixed(threshold);
+            } else {
+                batch->output_thresholds[output] = threshold;
+            }
+        }
+        compute_run_keys(brain, &keys[edge]);
+        value += brain->total_neurons;
+        edge += brain->num_connections;
+    }
+    batch->value_offsets[num_brains] = value;
+    batch->sensor_offsets[num_brains] = sensor;
+    batch->output_offsets[num_brains] = output;
+
+    // Counting sort of every block's connections into runs
+    uint32_t num_runs = 0;
+    uint32_t block_edge = 0;
+    for (uint32_t b = 0; b < batch->num_blocks; ++b) {
+        uint32_t first = b * BRAIN_BATCH_BLOCK_SIZE;
+        uint32_t last = first + BRAIN_BATCH_BLOCK_SIZE < num_brains ? first + BRAIN_BATCH_BLOCK_SIZE : num_brains;
+
+        uint32_t key_counts[NUM_RUN_KEYS] = {0};
+        uint32_t block_edges = 0;
+        for (uint32_t i = first; i < last; ++i) {
+            for (int e = 0; is_packed(brains[i]) && e < brains[i]->num_connections; ++e) {
+                key_counts[keys[block_edge + block_edges++]]++;
+            }
+        }
+
+        uint32_t key_starts[NUM_RUN_KEYS];
+        uint32_t start = block_edge;
+        batch->block_runs[b] = num_runs;
+        batch->block_forward_runs[b] = num_runs;
+        for (int k = 0; k < NUM_RUN_KEYS; ++k) {
+            key_starts[k] = start;
+            if (key_counts[k] == 0) {
+                continue;
+            }
+            if (k < NUM_ACTIVATION_FUNCTIONS) {
+                batch->block_forward_runs[b] = num_runs + 1;
+            }
+            batch->runs[num_runs].first_edge = start;
+            batch->runs[num_runs].num_edges = key_counts[k];
+            batch->runs[num_runs].activation_function = k % NUM_ACTIVATION_FUNCTIONS;
+            num_runs++;
+            start += key_counts[k];
+        }
+
+        uint32_t edge_index = block_edge;
+        for (uint32_t i = first; i < last; ++i) {
+            NeuralNetwork* brain = brains[i];
+            for (int e = 0; is_packed(brain) && e < brain->num_connections; ++e) {
+                uint32_t slot = key_starts[keys[edge_index++]]++;
+                uint32_t base = batch->value_offsets[i] - batch->value_offsets[first];
+                batch->edge_sources[slot] = base + brain->connections[e].source;
+                batch->edge_targets[slot] = base + brain->connections[e].target;
+                if (fixed) {
+                    batch->edge_weights_fixed[slot] = (int16_t)float_to_fixed(brain->connections[e].weight);
+                } else {
+                    batch->edge_weights[slot] = brain->connections[e].weight;
+                }
+            }
+        }
+        block_edge += block_edges;
+    }
+    batch->block_runs[batch->num_blocks] = num_runs;
+    free(keys);
+
+    if (fixed) {
+        batch->activations_fixed = batch_alloc(num_edges, sizeof(int16_t));
+    } else {
+        batch->activations = batch_alloc(num_edges, sizeof(float));
+    }
+    if (fixed ? !batch->activations_fixed : !batch->activations) {
+        free_brain_batch(batch);
+        return NULL;  // Allocation failed
+    }
+    return batch;
+}
+
+/**
+ * Deallocate memory associated with a batch.
+ *
+ * @param batch Pointer to the batch to be deallocated.
+ */
+void free_brain_batch(BrainBatch* batch) {
+    if (!batch) {
+        return;
+    }
+    free(batch->value_offsets);
+    free(batch->sensor_offsets);
+    free(batch->output_offsets);
+    free(batch->sensor_ids);
+    free(batch->sensor_slots);
+    free(batch->sensor_inputs);
+    free(batch->sensor_inputs_fixed);
+    free(batch->output_ids);
+    free(batch->output_slots);
+    free(batch->output_thresholds);
+    free(batch->output_thresholds_fixed);
+    free(batch->block_runs);
+    free(batch->block_forward_runs);
+    free(batch->runs);
+    free(batch->edge_sources);
+    free(batch->edge_targets);
+    free(batch->edge_weights);
+    free(batch->edge_weights_fixed);
+    free(batch->values);
+    free(batch->incoming);
+    free(batch->activations);
+    free(batch->values_fixed);
+    free(batch->incoming_fixed);
+    free(batch->activations_fixed);
+    free(batch->active);
+    free(batch->constant_actions);
+    free(batch->actions);
+    free(batch);
+}
+
+// Activate every connection of a run at once and accumulate the weighted results.
+// values and accumulator point at the first value of the run's block.
+static void evaluate_run(BrainBatch* batch, const EdgeRun* run, const float* values, float* accumulator) {
+    const uint16_t* sources = batch->edge_sources + run->first_edge;
+    const uint16_t* targets = batch->edge_targets + run->first_edge;
+    const float* weights = batch->edge_weights + run->first_edge;
+    float* activations = batch->activations + run->first_edge;
+
+    for (uint32_t i = 0; i < run->num_edges; ++i) {
+        activations[i] = values[sources[i]];
+    }
+    activate_array(activations, run->num_edges, run->activation_function, batch->accuracy);
+    for (uint32_t i = 0; i < run->num_edges; ++i) {
+        accumulator[targets[i]] += weights[i] * activations[i];
+    }
+}
+
+// Activate every connection of a run at once in Q.12 and accumulate the weighted
+// results, saturating each sum to int16
+static void evaluate_run_fixed(BrainBatch* batch, const EdgeRun* run, const int16_t* values, int16_t* accumulator) {
+    const uint16_t* sources = batch->edge_sources + run->first_edge;
+    const uint16_t* targets = batch->edge_targets + run->first_edge;
+    const int16_t* weights = batch->edge_weights_fixed + run->first_edge;
+    int16_t* activations = batch->activations_fixed + run->first_edge;
+
+    for (uint32_t i = 0; i < run->num_edges; ++i) {
+        activations[i] = values[sources[i]];
+    }
+    activate_array_fixed(activations, run->num_edges, run->activation_function);
+    for (uint32_t i = 0; i < run->num_edges; ++i) {
+        int32_t weighted = ((int32_t)weights[i] * activations[i]) >> FIXED_POINT_SHIFT;
+        accumulator[targets[i]] = saturate_fixed(accumulator[targets[i]] + weighted);
+    }
+}
+
+// Evaluate the creatures [first, last) of block b with float values
+static void evaluate_block(BrainBatch* batch, uint32_t b, uint32_t first, uint32_t last) {
+    uint32_t first_value = batch->value_offsets[first];
+    uint32_t num_values = batch->value_offsets[last] - first_value;
+
+    // Cycle-closing connections read the values left by the previous step
+    memset(batch->incoming + first_value, 0, num_values * sizeof(float));
+    for (uint32_t r = batch->block_runs[b]; r < batch->block_forward_runs[b]; ++r) {
+        evaluate_run(batch, &batch->runs[r], batch->values + first_value, batch->incoming + first_value);
+    }
+    memcpy(batch->values + first_value, batch->incoming + first_value, num_values * sizeof(float));
+
+    for (uint32_t s = batch->sensor_offsets[first]; s < batch->sensor_offsets[last]; ++s) {
+        batch->values[batch->sensor_slots[s]] = batch->sensor_inputs[s];
+    }
+
+    // Feed-forward connections, level by level
+    for (uint32_t r = batch->block_forward_runs[b]; r < batch->block_runs[b + 1]; ++r) {
+        evaluate_run(batch, &batch->runs[r], batch->values + first_value, batch->values + first_value);
+    }
+
+    // Each creature performs its strongest output if it clears the threshold
+    for (uint32_t i = first; i < last; ++i) {
+        uint8_t action_id = 0;
+        float data = -FLT_MAX;
+        float threshold = 0;
+        for (uint32_t o = batch->output_offsets[i]; o < batch->output_offsets[i + 1]; ++o) {
+            if (data < batch->values[batch->output_slots[o]]) {
+                data = batch->values[batch->output_slots[o]];
+                action_id = batch->output_ids[o];
+                threshold = batch->output_thresholds[o];
+            }
+        }
+        batch->actions[i] = batch->active[i] && action_id != 0 && data > threshold ? action_id : 0;
+        if (batch->constant_actions[i] != NOT_FOLDED) {
+            batch->actions[i] = batch->active[i] ? batch->constant_actions[i] : 0;
+        }
+    }
+}
+
+// Evaluate the creatures [first, last) of block b with Q.12 values
+static void evaluate_block_fixed(BrainBatch* batch, uint32_t b, uint32_t first, uint32_t last) {
+    uint32_t first_value = batch->value_offsets[first];
+    uint32_t num_values = batch->value_offsets[last] - first_value;
+
+    memset(batch->incoming_fixed + first_value, 0, num_values * sizeof(int16_t));
+    for (uint32_t r = batch->block_runs[b]; r < batch->block_forward_runs[b]; ++r) {
+        evaluate_run_fixed(batch, &batch->runs[r], batch->values_fixed + first_value, batch->incoming_fixed + first_value);
+    }
+    memcpy(batch->values_fixed + first_value, batch->incoming_fixed + first_value, num_values * sizeof(int16_t));
+
+    uint32_t first_sensor = batch->sensor_offsets[first];
+    convert_to_fixed(batch->sensor_inputs + first_sensor, batch->sensor_inputs_fixed + first_sensor,
+                     batch->sensor_offsets[last] - first_sensor);
+    for (uint32_t s = first_sensor; s < batch->sensor_offsets[last]; ++s) {
+        batch->values_fixed[batch->sensor_slots[s]] = batch->sensor_inputs_fixed[s];
+    }
+
+    for (uint32_t r = batch->block_forward_runs[b]; r < batch->block_runs[b + 1]; ++r) {
+        evaluate_run_fixed(batch, &batch->runs[r], batch->values_fixed + first_value, batch->values_fixed + first_value);
+    }
+
+    for (uint32_t i = first; i < last; ++i) {
+        uint8_t action_id = 0;
+        int32_t data = INT32_MIN;
+        int32_t threshold = 0;
+        for (uint32_t o = batch->output_offsets[i]; o < batch->output_offsets[i + 1]; ++o) {
+            if (data < batch->values_fixed[batch->output_slots[o]]) {
+                data = batch->values_fixed[batch->output_slots[o]];
+                action_id = batch->output_ids[o];
+                threshold = batch->output_thresholds_fixed[o];
+            }
+        }
+        batch->actions[i] = batch->active[i] && action_id != 0 && data > threshold ? action_id : 0;
+        if (batch->constant_actions[i] != NOT_FOLDED) {
+            batch->actions[i] = batch->active[i] ? batch->constant_actions[i] : 0;
+        }
+    }
+}
+
+/**
+ * Evaluate the brains of one block of the batch for one step. Blocks share no
+ * state, so different blocks may be evaluated concurrently.
+ *
+ * @param batch Pointer to the batch.
+ * @param block Index of the block, below num_blocks.
+ */
+void evaluate_brain_block(BrainBatch* batch, uint32_t block) {
+    uint32_t first = block * BRAIN_BATCH_BLOCK_SIZE;
+    uint32_t last = first + BRAIN_BATCH_BLOCK_SIZE < batch->num_creatures ? first + BRAIN_BATCH_BLOCK_SIZE : batch->num_creatures;
+    if (batch->precision == BRAIN_PRECISION_FIXED) {
+        evaluate_block_fixed(batch, block, first, last);
+    } else {
+        evaluate_block(batch, block, first, last);
+    }
+}
+
+/**
+ * Evaluate every brain of the batch for one step. sensor_inputs and active must
+ * be filled beforehand; the chosen actions are written to actions.
+ *
+ * @param batch Pointer to the batch.
+ */
+void evaluate_brain_batch(BrainBatch* batch) {
+    for (uint32_t b = 0; b < batch->num_blocks; ++b) {
+        evaluate_brain_block(batch, b);
+    }
+}
@@ -0,0 +1,121 @@
+#ifndef BRAIN_BATCH_H
+#define BRAIN_BATCH_H
+
+#include <stdint.h>
+#include "neuron_encoding.h"
+#include "activation.h"
+
+// Number of creatures whose brains are evaluated together as one block
+#define BRAIN_BATCH_BLOCK_SIZE 256
+
+// Entry of constant_actions for brains that are evaluated every step
+#define NOT_FOLDED 0xFF
+
+// Enum to pick the number format of batched evaluation
+typedef enum {
+    BRAIN_PRECISION_FLOAT,  // 32-bit float weights and values
+    BRAIN_PRECISION_FIXED,  // Q.12 fixed point: 16-bit weights, values and activations, table activations
+} BrainPrecision;
+
+// A run of connections that share an evaluation level and an activation function
+typedef struct {
+    uint32_t first_edge;          // Index of the first connection of the run
+    uint32_t num_edges;           // Number of connections in the run
+    uint8_t activation_function;  // Activation function shared by the run
+} EdgeRun;
+
+/*
+ * The compiled brains of a whole population packed in structure-of-arrays form.
+ * Every neuron value of every creature lives in one array, addressed through
+ * per-creature offsets, and all connections live in parallel source, target and
+ * weight arrays.
+ *
+ * Creatures are grouped in blocks of BRAIN_BATCH_BLOCK_SIZE. Inside a block the
+ * connections are sorted into runs: first the cycle-closing connections, then
+ * the feed-forward ones by level (the depth of their source neuron), each level
+ * split by activation function. A run never depends on a later one, so a whole
+ * run can be activated at once across every creature of the block.
+ *
+ * Evaluation follows the EVAL_TOPOLOGICAL semantics of propagate_signal.
+ * Brains with a constant_action pack no neurons or connections; their action is
+ * copied from constant_actions instead. With
+ * BRAIN_PRECISION_FIXED only the *_fixed arrays are allocated and the float
+ * ones stay NULL, and the other way around. Fixed-point values are saturated
+ * to [-8, 8) as they accumulate, so twice as many fit in a vector register.
+ */
+typedef struct BrainBatch {
+    uint32_t num_creatures;       // Number of packed brains
+    uint32_t num_blocks;          // Number of blocks of creatures
+    BrainPrecision precision;     // Number format of weights and values
+    ActivationAccuracy accuracy;  // Accuracy of the float sigmoid and tanh kernels, ACTIVATION_PRECISE by default
+
+    uint32_t* value_offsets;      // First neuron value of each creature, num_creatures + 1 entries
+    uint32_t* sensor_offsets;     // First sensory slot of each creature, num_creatures + 1 entries
+    uint32_t* output_offsets;     // First output slot of each creature, num_creatures + 1 entries
+
+    uint8_t* sensor_ids;          // Neuron ID read by each sensory slot
+    uint32_t* sensor_slots;       // Index in values written by each sensory slot
+    float* sensor_inputs;         // Sensed value of each sensory slot, filled before evaluation
+    int16_t* sensor_inputs_fixed; // Q.12 sensed value of each sensory slot, converted during evaluation
+
+    uint8_t* output_ids;          // Neuron ID of each output slot
+    uint32_t* output_slots;       // Index in values read by each output slot
+    float* output_thresholds;     // Activation threshold of each output slot
+    int16_t* output_thresholds_fixed; // Q.12 activation threshold of each output slot
+
+    uint32_t* block_runs;         // First run of each block, num_blocks + 1 entries
+    uint32_t* block_forward_runs; // First feed-forward run of each block
+    EdgeRun* runs;                // Runs of connections
+
+    uint16_t* edge_sources;       // Index of the source of each connection, relative to its block's first value
+    uint16_t* edge_targets;       // Index of the target of each connection, relative to its block's first value
+    float* edge_weights;          // Weight of each connection
+    int16_t* edge_weights_fixed;  // Q.12 weight of each connection
+
+    float* values;                // Neuron values of every creature
+    float* incoming;              // Accumulator for cycle-closing connections
+    float* activations;           // Scratch space holding the activations of each run, indexed like the connections
+    int16_t* values_fixed;        // Q.12 neuron values of every creature
+    int16_t* incoming_fixed;      // Q.12 accumulator for cycle-closing connections
+    int16_t* activations_fixed;   // Scratch space holding the Q.12 activations of each run
+    uint8_t* active;              // Whether each creature takes part in the step, set before evaluation
+    uint8_t* actions;             // Action chosen by each creature in the last evaluation, 0 for none
+    uint8_t* constant_actions;    // Folded action of each creature's brain, NOT_FOLDED if it is evaluated
+} BrainBatch;
+
+/**
+ * Pack a population of compiled brains into a batch.
+ *
+ * @param brains Array of brains, NULL entries pack as empty brains and folded
+ *               brains as their constant action.
+ * @param num_brains Number of brains.
+ * @param precision Number format used to store and evaluate the brains.
+ * @return Pointer to the new batch, or NULL if allocation failed.
+ */
+BrainBatch* build_brain_batch(NeuralNetwork** brains, uint32_t num_brains, BrainPrecision precision);
+
+/**
+ * Deallocate memory associated with a batch.
+ *
+ * @param batch Pointer to the batch to be deallocated.
+ */
+void free_brain_batch(BrainBatch* batch);
+
+/**
+ * Evaluate the brains of one block of the batch for one step. Blocks share no
+ * state, so different blocks may be evaluated concurrently.
+ *
+ * @param batch Pointer to the batch.
+ * @param block Index of the block, below num_blocks.
+ */
+void evaluate_brain_block(BrainBatch* batch, uint32_t block);
+
+/**
+ * Evaluate every brain of the batch for one step. sensor_inputs and active must
+ * be filled beforehand; the chosen actions are written to actions.
+ *
+ * @param batch Pointer to the batch.
+ */
+void evaluate_brain_batch(BrainBatch* batch);
+
+#endif // BRAIN_BATCH_H
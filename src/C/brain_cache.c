@@ -0,0 +1,282 @@
+#include "brain_cache.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Smallest table, and the table is kept at most half full
+#define MIN_CACHE_CAPACITY 16
+
+// Slot where a probe for `hash` starts
+static uint32_t home_slot(const BrainCache* cache, uint64_t hash) {
+    return (uint32_t)hash & (cache->capacity - 1);
+}
+
+// Insert an entry, the caller makes sure there is a free slot
+static void insert_entry(BrainCache* cache, BrainCacheEntry entry) {
+    uint32_t slot = home_slot(cache, entry.brain->genome_hash);
+    while (cache->entries[slot].brain) {
+        slot = (slot + 1) & (cache->capacity - 1);
+    }
+    cache->entries[slot] = entry;
+}
+
+// Double the table and re-insert every entry, returns 0 if allocation failed
+static int grow_cache(BrainCache* cache) {
+    BrainCacheEntry* old_entries = cache->entries;
+    uint32_t old_capacity = cache->capacity;
+    BrainCacheEntry* entries = calloc(2 * old_capacity, sizeof(BrainCacheEntry));
+    if (!entries) {
+        return 0;  // Allocation failed
+    }
+    cache->entries = entries;
+    cache->capacity = 2 * old_capacity;
+    for (uint32_t i = 0; i < old_capacity; ++i) {
+        if (old_entries[i].brain) {
+            insert_entry(cache, old_entries[i]);
+        }
+    }
+    free(old_entries);
+    return 1;
+}
+
+/**
+ * Create an empty brain cache.
+ *
+ * @param capacity Expected number of distinct genomes, the table grows as needed.
+ * @return Pointer to the new cache, or NULL if allocation failed.
+ */
+BrainCache* create_brain_cache(uint32_t capacity) {
+    BrainCache* cache = malloc(sizeof(BrainCache));
+    if (!cache) {
+        return NULL;  // Allocation failed
+    }
+    cache->capacity = MIN_CACHE_CAPACITY;
+    while (cache->capacity < 2 * capacity) {
+        cache->capacity *= 2;
+    }
+    cache->entries = calloc(cache->capacity, sizeof(BrainCacheEntry));
+    if (!cache->entries) {
+        free(cache);
+        return NULL;  // Allocation failed
+    }
+    cache->count = 0;
+    cache->hits = 0;
+    cache->misses = 0;
+    return cache;
+}
+
+/**
+ * Deallocate a cache and every network it still holds.
+ *
+ * @param cache Pointer to the cache to be deallocated.
+ */
+void free_brain_cache(BrainCache* cache) {
+    if (!cache) {
+        return;
+    }
+    for (uint32_t i = 0; i < cache->capacity; ++i) {
+        if (cache->entries[i].brain) {
+            free_neural_network(cache->entries[i].brain);
+            free(cache->entries[i].genome);
+        }
+    }
+    free(cache->entries);
+    free(cache);
+}
+
+// Cached network compiled from exactly this genome, NULL if there is none
+static NeuralNetwork* find_brain(const BrainCache* cache, const Gene* genome, int genome_length, uint64_t hash) {
+    for (uint32_t slot = home_slot(cache, hash); cache->entries[slot].brain; slot = (slot + 1) & (cache->capacity - 1)) {
+        const BrainCacheEntry* entry = &cache->entries[slot];
+        if (entry->brain->genome_hash == hash && entry->genome_length == genome_length &&
+            memcmp(entry->genome, genome, genome_length * sizeof(Gene)) == 0) {
+            return entry->brain;
+        }
+    }
+    return NULL;
+}
+
+// Add a freshly compiled network to the cache. Keeps the table at most half full;
+// if it cannot grow or the genome cannot be copied, the network stays uncached
+// and is freed on its last release.
+static void cache_brain(BrainCache* cache, NeuralNetwork* brain, const Gene* genome, int genome_length) {
+    if (2 * (cache->count + 1) > cache->capacity && !grow_cache(cache)) {
+        return;
+    }
+    BrainCacheEntry entry;
+    entry.brain = brain;
+    entry.genome_length = genome_length;
+    entry.genome = malloc(genome_length * sizeof(Gene));
+    if (!entry.genome) {
+        return;  // Allocation failed
+    }
+    memcpy(entry.genome, genome, genome_length * sizeof(Gene));
+    insert_entry(cache, entry);
+    cache->count++;
+}
+
+/**
+ * Get the compiled network of a genome, sharing it if an identical genome is
+ * cached and compiling it otherwise. Every successful acquire must be paired
+ * with a release_brain.
+ *
+ * @param cache Pointer to the cache, NULL compiles a private network.
+ * @param genome Genome to compile.
+ * @param genome_length Number of genes in the genome.
+ * @return Pointer to the network, or NULL if the genome is not viable or allocation failed.
+ */
+NeuralNetwork* acquire_brain(BrainCache* cache, Gene* genome, int genome_length) {
+    if (!cache) {
+        return initialize_neural_network(genome, genome_length);
+    }
+    uint64_t hash = hash_genome(genome, genome_length);
+    NeuralNetwork* brain = find_brain(cache, genome, genome_length, hash);
+    if (brain) {
+        brain->ref_count++;
+        cache->hits++;
+        return brain;
+    }
+
+    cache->misses++;
+    brain = initialize_neural_network(genome, genome_length);
+    if (brain) {
+        cache_brain(cache, brain, genome, genome_length);
+    }
+    return brain;
+}
+
+// Genomes of an acquire_brains call and the networks compiled for them
+typedef struct {
+    Gene** genomes;
+    int genome_length;
+    Gene** base_genomes;           // Optional genome each network can be derived from
+    NeuralNetwork** base_brains;   // Network compiled from each base genome
+    NeuralNetwork** brains;
+    const uint8_t* missing;  // Non-zero for the genomes that were not cached
+} CompileContext;
+
+// Compile the network of one genome that was not cached, patching its base's
+// network if the genome differs from the base in only a few genes
+static void compile_brain_task(void* context, uint32_t index) {
+    CompileContext* compile = context;
+    if (!compile->missing[index]) {
+        return;
+    }
+    Gene* genome = compile->genomes[index];
+    int genome_length = compile->genome_length;
+    if (compile->base_brains && compile->base_brains[index]) {
+        const Gene* base_genome = compile->base_genomes[index];
+        int changed_genes[MAX_DERIVED_GENES];
+        int num_changed = 0;
+        for (int i = 0; i < genome_length && num_changed <= MAX_DERIVED_GENES; ++i) {
+            if (memcmp(&base_genome[i], &genome[i], sizeof(Gene)) == 0) {
+                continue;
+            }
+            if (num_changed < MAX_DERIVED_GENES) {
+                changed_genes[num_changed] = i;
+            }
+            num_changed++;
+        }
+        if (num_changed <= MAX_DERIVED_GENES) {
+            compile->brains[index] = derive_neural_network(compile->base_brains[index], base_genome, genome, genome_length,
+                                                           changed_genes, num_changed);
+            return;
+        }
+    }
+    compile->brains[index] = initialize_neural_network(genome, genome_length);
+}
+
+/**
+ * Acquire the networks of many genomes at once, compiling the ones that are not
+ * cached in parallel on a thread pool. The cache ends up exactly as if
+ * acquire_brain had been called for each genome in order: a genome repeated
+ * within the call shares the network compiled for its first copy. A genome
+ * that differs from its base genome in a few genes only is compiled by
+ * patching a copy of the base's network (see derive_neural_network).
+ *
+ * @param cache Pointer to the cache, NULL compiles private networks.
+ * @param pool Thread pool compiling the networks, NULL compiles them on the calling thread.
+ * @param genomes Genomes to compile.
+ * @param genome_length Number of genes in every genome.
+ * @param base_genomes Genome close to each genome, such as a parent's, or NULL.
+ * @param base_brains Network compiled from each base genome, NULL throughout or where there is none.
+ * @param brains Receives the network of each genome, NULL where acquire_brain would return NULL.
+ * @param count Number of genomes.
+ */
+void acquire_brains(BrainCache* cache, ThreadPool* pool, Gene** genomes, int genome_length, Gene** base_genomes,
+                    NeuralNetwork** base_brains, NeuralNetwork** brains, uint32_t count) {
+    uint8_t* missing = malloc(count ? count : 1);
+    if (!missing) {
+        // Allocation failed, compile one at a time
+        for (uint32_t i = 0; i < count; ++i) {
+            brains[i] = acquire_brain(cache, genomes[i], genome_length);
+        }
+        return;
+    }
+    // Serve what the cache already holds; the hits are counted once the order is known
+    for (uint32_t i = 0; i < count; ++i) {
+        brains[i] = cache ? find_brain(cache, genomes[i], genome_length, hash_genome(genomes[i], genome_length)) : NULL;
+        missing[i] = brains[i] == NULL;
+    }
+    CompileContext compile = {genomes, genome_length, base_genomes, base_brains, brains, missing};
+    parallel_for(pool, count, compile_brain_task, &compile);
+
+    // Count references and cache the new networks in genome order
+    for (uint32_t i = 0; cache && i < count; ++i) {
+        if (!missing[i]) {
+            brains[i]->ref_count++;
+            cache->hits++;
+            continue;
+        }
+        if (brains[i]) {
+            // A copy of the genome earlier in the call may have cached it already
+            NeuralNetwork* cached = find_brain(cache, genomes[i], genome_length, brains[i]->genome_hash);
+            if (cached) {
+                free_neural_network(brains[i]);
+                brains[i] = cached;
+                cached->ref_count++;
+                cache->hits++;
+                continue;
+            }
+        }
+        cache->misses++;
+        if (brains[i]) {
+            cache_brain(cache, brains[i], genomes[i], genome_length);
+        }
+    }
+    free(missing);
+}
+
+/**
+ * Drop one reference to a network, freeing it once no creature holds it.
+ *
+ * @param cache Pointer to the cache the network was acquired from, or NULL.
+ * @param brain Network to release, NULL is ignored.
+ */
+void release_brain(BrainCache* cache, NeuralNetwork* brain) {
+    if (!brain || --brain->ref_count > 0) {
+        return;
+    }
+    if (cache) {
+        uint32_t mask = cache->capacity - 1;
+        uint32_t slot = home_slot(cache, brain->genome_hash);
+        while (cache->entries[slot].brain && cache->entries[slot].brain != brain) {
+            slot = (slot + 1) & mask;
+        }
+        if (cache->entries[slot].brain) {
+            free(cache->entries[slot].genome);
+            cache->entries[slot].brain = NULL;
+            cache->count--;
+            // Backward-shift deletion: pull later entries of the probe chain into the hole
+            uint32_t hole = slot;
+            for (uint32_t next = (slot + 1) & mask; cache->entries[next].brain; next = (next + 1) & mask) {
+                uint32_t home = home_slot(cache, cache->entries[next].brain->genome_hash);
+                if (((next - home) & mask) >= ((next - hole) & mask)) {
+                    cache->entries[hole] = cache->entries[next];
+                    cache->entries[next].brain = NULL;
+                    hole = next;
+                }
+            }
+        }
+    }
+    free_neural_network(brain);
+}
@@ -0,0 +1,90 @@
+#ifndef BRAIN_CACHE_H
+#define BRAIN_CACHE_H
+
+#include <stdint.h>
+#include "gene_encoding.h"
+#include "neuron_encoding.h"
+#include "thread_pool.h"
+
+// Most genes a genome may differ from its base in to be derived from the base's network
+#define MAX_DERIVED_GENES 16
+
+// A cached network together with the genome it was compiled from
+typedef struct {
+    NeuralNetwork* brain;   // Shared network, NULL for an empty slot
+    Gene* genome;           // Copy of the genome, compared on every hash match
+    int genome_length;      // Number of genes in the genome
+} BrainCacheEntry;
+
+/*
+ * Content-addressed store of compiled brains. Every creature whose genome is
+ * identical shares one immutable network; the network's ref_count tracks how
+ * many creatures hold it, and it is compiled on the first acquire and freed on
+ * the last release. Entries live in an open-addressing table keyed by
+ * genome_hash, and the genome itself is compared so a hash collision never
+ * hands out the wrong brain. Non-viable genomes are not cached.
+ */
+typedef struct BrainCache {
+    BrainCacheEntry* entries;  // Hash table, capacity entries
+    uint32_t capacity;         // Number of slots, a power of two
+    uint32_t count;            // Number of cached networks
+    uint64_t hits;             // Number of acquires served from the cache
+    uint64_t misses;           // Number of acquires that compiled a network
+} BrainCache;
+
+/**
+ * Create an empty brain cache.
+ *
+ * @param capacity Expected number of distinct genomes, the table grows as needed.
+ * @return Pointer to the new cache, or NULL if allocation failed.
+ */
+BrainCache* create_brain_cache(uint32_t capacity);
+
+/**
+ * Deallocate a cache and every network it still holds.
+ *
+ * @param cache Pointer to the cache to be deallocated.
+ */
+void free_brain_cache(BrainCache* cache);
+
+/**
+ * Get the compiled network of a genome, sharing it if an identical genome is
+ * cached and compiling it otherwise. Every successful acquire must be paired
+ * with a release_brain.
+ *
+ * @param cache Pointer to the cache, NULL compiles a private network.
+ * @param genome Genome to compile.
+ * @param genome_length Number of genes in the genome.
+ * @return Pointer to the network, or NULL if the genome is not viable or allocation failed.
+ */
+NeuralNetwork* acquire_brain(BrainCache* cache, Gene* genome, int genome_length);
+
+/**
+ * Acquire the networks of many genomes at once, compiling the ones that are not
+ * cached in parallel on a thread pool. The cache ends up exactly as if
+ * acquire_brain had been called for each genome in order: a genome repeated
+ * within the call shares the network compiled for its first copy. A genome
+ * that differs from its base genome in a few genes only is compiled by
+ * patching a copy of the base's network (see derive_neural_network).
+ *
+ * @param cache Pointer to the cache, NULL compiles private networks.
+ * @param pool Thread pool compiling the networks, NULL compiles them on the calling thread.
+ * @param genomes Genomes to compile.
+ * @param genome_length Number of genes in every genome.
+ * @param base_genomes Genome close to each genome, such as a parent's, or NULL.
+ * @param base_brains Network compiled from each base genome, NULL throughout or where there is none.
+ * @param brains Receives the network of each genome, NULL where acquire_brain would return NULL.
+ * @param count Number of genomes.
+ */
+void acquire_brains(BrainCache* cache, ThreadPool* pool, Gene** genomes, int genome_length, Gene** base_genomes,
+                    NeuralNetwork** base_brains, NeuralNetwork** brains, uint32_t count);
+
+/**
+ * Drop one reference to a network, freeing it once no creature holds it.
+ *
+ * @param cache Pointer to the cache the network was acquired from, or NULL.
+ * @param brain Network to release, NULL is ignored.
+ */
+void release_brain(BrainCache* cache, NeuralNetwork* brain);
+
+#endif // BRAIN_CACHE_H
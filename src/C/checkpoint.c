@@ -0,0 +1,265 @@
+#include "checkpoint.h"
+#include "snapshot.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// FNV-1a parameters of the checkpoint checksum
+#define CHECKSUM_BASIS 0xCBF29CE484222325ull
+#define CHECKSUM_PRIME 0x100000001B3ull
+
+// A checkpoint file being written or read, with the checksum of the bytes so far
+typedef struct {
+    FILE* file;
+    uint64_t checksum;
+    int failed;
+} CheckpointStream;
+
+static void update_checksum(CheckpointStream* stream, const void* data, size_t size) {
+    const uint8_t* bytes = data;
+    uint64_t checksum = stream->checksum;
+    for (size_t i = 0; i < size; ++i) {
+        checksum = (checksum ^ bytes[i]) * CHECKSUM_PRIME;
+    }
+    stream->checksum = checksum;
+}
+
+static void write_bytes(CheckpointStream* stream, const void* data, size_t size) {
+    if (size == 0 || stream->failed) {
+        return;
+    }
+    stream->failed = fwrite(data, 1, size, stream->file) != size;
+    update_checksum(stream, data, size);
+}
+
+static void read_bytes(CheckpointStream* stream, void* data, size_t size) {
+    if (size == 0 || stream->failed) {
+        return;
+    }
+    stream->failed = fread(data, 1, size, stream->file) != size;
+    if (!stream->failed) {
+        update_checksum(stream, data, size);
+    }
+}
+
+// Neuron values of the brain batch, their number and the size of each, NULL if there is no batch
+static void* batch_values(const BrainBatch* batch, uint32_t* count, size_t* size) {
+    if (!batch) {
+        *count = 0;
+        *size = 0;
+        return NULL;
+    }
+    *count = batch->value_offsets[batch->num_creatures];
+    if (batch->precision == BRAIN_PRECISION_FIXED) {
+        *size = sizeof(int16_t);
+        return batch->values_fixed;
+    }
+    *size = sizeof(float);
+    return batch->values;
+}
+
+/**
+ * Save the complete state of a run. The checkpoint is written to a temporary
+ * file next to the given one and renamed over it once complete, so an
+ * interrupted save leaves the previous checkpoint intact.
+ *
+ * @param grid Pointer to the grid.
+ * @param creatures The creatures of the current generation.
+ * @param filename Name of the checkpoint file.
+ * @return 0 on success, non-zero on failure.
+ */
+int save_checkpoint(const Grid* grid, const Creature* creatures, const char* filename) {
+    char* temporary = temporary_filename(filename);
+    if (!temporary) {
+        return 1;  // Allocation failed
+    }
+
+    CheckpointStream stream = {fopen(temporary, "wb"), CHECKSUM_BASIS, 0};
+    if (!stream.file) {
+        free(temporary);
+        return 1;  // File open failed
+    }
+    setvbuf(stream.file, NULL, _IOFBF, 1 << 20);
+
+    CheckpointHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = CHECKPOINT_MAGIC;
+    header.version = CHECKPOINT_VERSION;
+    header.num_planes = NUM_CELL_FLAGS;
+    header.width = grid->width;
+    header.height = grid->height;
+    header.plane_words = grid_plane_words(grid->width, grid->height);
+    header.max_creatures = grid->max_creatures;
+    header.max_steps = grid->max_steps;
+    header.num_genomes = grid->num_genomes;
+    header.num_creatures = grid->num_creatures;
+    header.seed = grid->seed;
+    header.step = grid->num_generations;
+    header.steps_taken = grid->steps_taken;
+    header.generation = grid->generation;
+    header.num_creatures_alive_last_gen = grid->num_creatures_alive_last_gen;
+    header.evaluation_mode = grid->evaluation_mode;
+    header.activation_accuracy = grid->activation_accuracy;
+    header.brain_precision = grid->brain_precision;
+    header.selection_mode = grid->selection_mode;
+    header.genome_rate = grid->mutation_rates.genome_rate;
+    header.gene_rate = grid->mutation_rates.gene_rate;
+    header.bit_rate = grid->mutation_rates.bit_rate;
+    size_t value_size;
+    const void* values = batch_values(grid->brain_batch, &header.batch_values, &value_size);
+    header.batch_precision = grid->brain_batch ? grid->brain_batch->precision : 0;
+    write_bytes(&stream, &header, sizeof(header));
+
+    uint32_t num_cells = (uint32_t)grid->width * grid->height;
+    write_bytes(&stream, grid->cell_flags[0], (size_t)NUM_CELL_FLAGS * header.plane_words * sizeof(uint64_t));
+    write_bytes(&stream, grid->creature_ids, (size_t)num_cells * sizeof(uint32_t));
+    write_bytes(&stream, grid->live_creatures, (size_t)grid->num_creatures * sizeof(uint32_t));
+    for (uint32_t i = 0; i < grid->max_creatures; ++i) {
+        CheckpointCreature record;
+        record.x = creatures[i].position.x;
+        record.y = creatures[i].position.y;
+        record.energy = creatures[i].energy;
+        record.id = creatures[i].id;
+        record.age = creatures[i].age;
+        record.generation = creatures[i].generation;
+        write_bytes(&stream, &record, sizeof(record));
+    }
+    for (uint32_t i = 0; i < grid->max_creatures; ++i) {
+        write_bytes(&stream, creatures[i].neuron_values, sizeof(creatures[i].neuron_values));
+    }
+    for (uint32_t i = 0; i < grid->max_creatures; ++i) {
+        write_bytes(&stream, creatures[i].genome, (size_t)grid->num_genomes * sizeof(Gene));
+    }
+    write_bytes(&stream, values, (size_t)header.batch_values * value_size);
+
+    CheckpointFooter footer = {stream.checksum, CHECKPOINT_MAGIC, 0};
+    write_bytes(&stream, &footer, sizeof(footer));
+    int failed = stream.failed;
+    failed |= fclose(stream.file) != 0;
+    failed = replace_file(temporary, filename, failed);
+    free(temporary);
+    return failed;
+}
+
+/**
+ * Restore a run saved with save_checkpoint into a new grid, compiling the
+ * brains of every creature again.
+ *
+ * @param filename Name of the checkpoint file.
+ * @param creatures Receives the creature array, max_creatures creatures, to be freed by the caller.
+ * @return Pointer to the restored grid, or NULL if the file is not a complete checkpoint or allocation failed.
+ */
+Grid* load_checkpoint(const char* filename, Creature** creatures) {
+    CheckpointStream stream = {fopen(filename, "rb"), CHECKSUM_BASIS, 0};
+    if (!stream.file) {
+        return NULL;  // File open failed
+    }
+    setvbuf(stream.file, NULL, _IOFBF, 1 << 20);
+
+    CheckpointHeader header;
+    read_bytes(&stream, &header, sizeof(header));
+    if (stream.failed || header.magic != CHECKPOINT_MAGIC || header.version != CHECKPOINT_VERSION ||
+        header.num_planes != NUM_CELL_FLAGS || header.plane_words != grid_plane_words(header.width, header.height) ||
+        header.num_creatures > header.max_creatures) {
+        fclose(stream.file);
+        return NULL;  // Not a checkpoint of this version
+    }
+    Grid* grid = initialize_grid(header.width, header.height, header.max_creatures, header.max_steps, header.num_genomes);
+    Creature* restored = calloc(header.max_creatures ? header.max_creatures : 1, sizeof(Creature));
+    size_t value_size = header.batch_precision == BRAIN_PRECISION_FIXED ? sizeof(int16_t) : sizeof(float);
+    void* values = malloc((header.batch_values ? header.batch_values : 1) * value_size);
+    if (!grid || !restored || !values) {
+        free(values);
+        free(restored);
+        if (grid) {
+            free_grid(grid);
+        }
+        fclose(stream.file);
+        return NULL;  // Allocation failed
+    }
+    grid->seed = header.seed;
+    grid->num_generations = header.step;
+    grid->steps_taken = header.steps_taken;
+    grid->generation = header.generation;
+    grid->num_creatures = header.num_creatures;
+    grid->num_creatures_alive_last_gen = header.num_creatures_alive_last_gen;
+    grid->evaluation_mode = (EvaluationMode)header.evaluation_mode;
+    grid->activation_accuracy = (ActivationAccuracy)header.activation_accuracy;
+    grid->brain_precision = (BrainPrecision)header.brain_precision;
+    grid->selection_mode = (SelectionMode)header.selection_mode;
+    grid->mutation_rates.genome_rate = header.genome_rate;
+    grid->mutation_rates.gene_rate = header.gene_rate;
+    grid->mutation_rates.bit_rate = header.bit_rate;
+
+    uint32_t num_cells = (uint32_t)header.width * header.height;
+    read_bytes(&stream, grid->cell_flags[0], (size_t)NUM_CELL_FLAGS * header.plane_words * sizeof(uint64_t));
+    read_bytes(&stream, grid->creature_ids, (size_t)num_cells * sizeof(uint32_t));
+    read_bytes(&stream, grid->live_creatures, (size_t)header.num_creatures * sizeof(uint32_t));
+    for (uint32_t i = 0; i < header.max_creatures; ++i) {
+        CheckpointCreature record;
+        read_bytes(&stream, &record, sizeof(record));
+        restored[i].position.x = record.x;
+        restored[i].position.y = record.y;
+        restored[i].energy = record.energy;
+        restored[i].id = record.id;
+        restored[i].age = record.age;
+        restored[i].generation = record.generation;
+    }
+    for (uint32_t i = 0; i < header.max_creatures; ++i) {
+        read_bytes(&stream, restored[i].neuron_values, sizeof(restored[i].neuron_values));
+    }
+    for (uint32_t i = 0; i < header.max_creatures && !stream.failed; ++i) {
+        restored[i].genome_length = (int)header.num_genomes;
+        restored[i].genome = arena_alloc(grid->genome_arena, (size_t)header.num_genomes * sizeof(Gene));
+        stream.failed = !restored[i].genome;
+        read_bytes(&stream, restored[i].genome, (size_t)header.num_genomes * sizeof(Gene));
+    }
+    read_bytes(&stream, values, (size_t)header.batch_values * value_size);
+    uint64_t checksum = stream.checksum;
+    CheckpointFooter footer;
+    read_bytes(&stream, &footer, sizeof(footer));
+    fclose(stream.file);
+    if (stream.failed || footer.magic != CHECKPOINT_MAGIC || footer.checksum != checksum) {
+        free(values);
+        free(restored);
+        free_grid(grid);
+        return NULL;  // Truncated or damaged
+    }
+
+    // Walls are only stored as a bitplane
+    build_wall_distances(grid);
+
+    // Compile the brains again; creatures with identical genomes share one as before
+    Gene** genomes = malloc((header.max_creatures ? header.max_creatures : 1) * sizeof(Gene*));
+    NeuralNetwork** brains = malloc((header.max_creatures ? header.max_creatures : 1) * sizeof(NeuralNetwork*));
+    if (!genomes || !brains) {
+        free(genomes);
+        free(brains);
+        free(values);
+        free(restored);
+        free_grid(grid);
+        return NULL;  // Allocation failed
+    }
+    for (uint32_t i = 0; i < header.max_creatures; ++i) {
+        genomes[i] = restored[i].genome;
+    }
+    acquire_brains(grid->brain_cache, grid->thread_pool, genomes, (int)header.num_genomes, NULL, NULL, brains, header.max_creatures);
+    for (uint32_t i = 0; i < header.max_creatures; ++i) {
+        restored[i].brain = brains[i];
+    }
+    free(genomes);
+    free(brains);
+
+    // The batch packs the same brains in the same layout, so the values left
+    // by the last step carry over
+    pack_brains(grid, restored);
+    uint32_t count;
+    size_t size;
+    void* batch = batch_values(grid->brain_batch, &count, &size);
+    if (batch && count == header.batch_values && grid->brain_batch->precision == (BrainPrecision)header.batch_precision) {
+        memcpy(batch, values, (size_t)count * size);
+    }
+    free(values);
+    *creatures = restored;
+    return grid;
+}
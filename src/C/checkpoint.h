@@ -0,0 +1,98 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdint.h>
+#include "grid.h"
+#include "simulation.h"
+
+// First word of every checkpoint, "ECKP" in a little-endian file
+#define CHECKPOINT_MAGIC 0x504B4345u
+// Version of the layout below, bumped on every incompatible change
+#define CHECKPOINT_VERSION 1
+
+/*
+ * The complete state of a run, in host byte order like a snapshot. A run
+ * restored from a checkpoint takes exactly the steps the saved run would have
+ * taken: every random stream is derived from the seed, the generation and the
+ * step (see rng.h), so those counters are the whole random state.
+ *
+ * A checkpoint is this header, followed by
+ * - num_planes bitplanes of plane_words 64-bit words each, as in a snapshot,
+ * - the creature ID of every cell, width * height uint32_t,
+ * - the live list, num_creatures uint32_t,
+ * - max_creatures CheckpointCreature records, by index,
+ * - the neuron values of every creature, max_creatures * TOTAL_NEURONS floats,
+ * - the genes of every creature, by index, num_genomes each,
+ * - the neuron values of the brain batch, batch_values values in the batch's
+ *   precision: floats, or int16_t in Q.12,
+ * - a CheckpointFooter.
+ *
+ * Compiled brains are not stored: they are compiled again from the genomes.
+ */
+typedef struct {
+    uint32_t magic;                  // CHECKPOINT_MAGIC
+    uint16_t version;                // CHECKPOINT_VERSION
+    uint16_t num_planes;             // Number of bitplanes, NUM_CELL_FLAGS
+    uint16_t width;                  // Width of the grid
+    uint16_t height;                 // Height of the grid
+    uint32_t plane_words;            // Words per bitplane, grid_plane_words(width, height)
+    uint32_t max_creatures;          // Length of the creature array
+    uint32_t max_steps;              // Steps per generation
+    uint32_t num_genomes;            // Genes per genome
+    uint32_t num_creatures;          // Length of the live list
+    uint64_t seed;                   // Seed of every random stream
+    uint64_t step;                   // Steps taken in the generation
+    uint64_t steps_taken;            // Steps taken since the run started
+    uint32_t generation;             // Times the creatures had been bred
+    uint32_t num_creatures_alive_last_gen;
+    uint32_t evaluation_mode;        // EvaluationMode
+    uint32_t activation_accuracy;    // ActivationAccuracy
+    uint32_t brain_precision;        // BrainPrecision
+    uint32_t selection_mode;         // SelectionMode
+    double genome_rate;              // MutationRates
+    double gene_rate;
+    double bit_rate;
+    uint32_t batch_precision;        // BrainPrecision of the saved batch values
+    uint32_t batch_values;           // Number of saved batch values, 0 without a batch
+} CheckpointHeader;
+
+// A creature, as stored in a checkpoint
+typedef struct {
+    uint16_t x;                 // Position of the creature
+    uint16_t y;
+    float energy;               // Energy left
+    uint32_t id;
+    uint32_t age;               // Steps lived
+    uint32_t generation;        // Generations the slot has been bred
+} CheckpointCreature;
+
+// End of a checkpoint
+typedef struct {
+    uint64_t checksum;          // FNV-1a of every byte before the footer
+    uint32_t magic;             // CHECKPOINT_MAGIC
+    uint32_t reserved;          // Zero
+} CheckpointFooter;
+
+/**
+ * Save the complete state of a run. The checkpoint is written to a temporary
+ * file next to the given one and renamed over it once complete, so an
+ * interrupted save leaves the previous checkpoint intact.
+ *
+ * @param grid Pointer to the grid.
+ * @param creatures The creatures of the current generation.
+ * @param filename Name of the checkpoint file.
+ * @return 0 on success, non-zero on failure.
+ */
+int save_checkpoint(const Grid* grid, const Creature* creatures, const char* filename);
+
+/**
+ * Restore a run saved with save_checkpoint into a new grid, compiling the
+ * brains of every creature again.
+ *
+ * @param filename Name of the checkpoint file.
+ * @param creatures Receives the creature array, max_creatures creatures, to be freed by the caller.
+ * @return Pointer to the restored grid, or NULL if the file is not a complete checkpoint or allocation failed.
+ */
+Grid* load_checkpoint(const char* filename, Creature** creatures);
+
+#endif // CHECKPOINT_H
@@ -1,5 +1,7 @@
 #include "genetic_operations.h"
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include <time.h>
 
 // Two-point Crossover
@@ -8,14 +10,14 @@
 // while genes inside the window are swapped. If offspring2 is NULL the caller
 // only expects one child.
 void two_point_crossover(Gene* parent1, Gene* parent2, Gene* offspring1,
-                         Gene* offspring2, int genome_length) {
+                         Gene* offspring2, int genome_length, RngStream* rng) {
     if (!parent1 || !parent2 || !offspring1 || genome_length <= 0) {
         return;
     }
 
     // Choose two crossover points along the genome
-    int crossover1 = rand() % genome_length;
-    int crossover2 = rand() % genome_length;
+    int crossover1 = rng_below(rng, genome_length);
+    int crossover2 = rng_below(rng, genome_length);
     if (crossover1 > crossover2) {
         int tmp = crossover1;
         crossover1 = crossover2;
@@ -39,17 +41,156 @@ void two_point_crossover(Gene* parent1, Gene* parent2, Gene* offspring1,
     }
 }
 
+// Number of units skipped before the next mutated one, geometric with the given
+// log(1 - rate); 0 when every unit mutates
+static uint64_t mutation_gap(RngStream* rng, double log_keep) {
+    if (log_keep == 0) {
+        return 0;
+    }
+    double u = ((rng_next(rng) >> 11) + 1) * (1.0 / 9007199254740992.0);  // In (0, 1]
+    double gap = floor(log(u) / log_keep);
+    return gap < (double)(UINT64_MAX >> 1) ? (uint64_t)gap : UINT64_MAX >> 1;
+}
+
+// Flip one random bit in each mutated unit of bits_per_unit bits, skipping from unit to unit
+static void mutate_units(Gene** genomes, uint32_t count, int genome_length, uint64_t bits_per_unit, double rate, RngStream* rng) {
+    if (rate <= 0 || count == 0 || genome_length <= 0) {
+        return;
+    }
+    uint64_t units_per_genome = (uint64_t)genome_length * 64 / bits_per_unit;
+    uint64_t total_units = count * units_per_genome;
+    double log_keep = rate < 1 ? log1p(-rate) : 0;
+    uint64_t unit = mutation_gap(rng, log_keep);
+    while (unit < total_units) {
+        Gene* genome = genomes[unit / units_per_genome];
+        uint64_t bit = unit % units_per_genome * bits_per_unit;
+        if (bits_per_unit > 1) {
+            bit += rng_below(rng, (uint32_t)bits_per_unit);
+        }
+        genome[bit / 64].gene ^= 1ULL << (bit % 64);
+        uint64_t gap = mutation_gap(rng, log_keep);
+        if (gap >= total_units - unit) {
+            break;
+        }
+        unit += gap + 1;
+    }
+}
+
+// Population mutation
+void mutate_population(Gene** genomes, uint32_t count, int genome_length, const MutationRates* rates, RngStream* rng) {
+    mutate_units(genomes, count, genome_length, (uint64_t)genome_length * 64, rates->genome_rate, rng);
+    mutate_units(genomes, count, genome_length, 64, rates->gene_rate, rng);
+    mutate_units(genomes, count, genome_length, 1, rates->bit_rate, rng);
+}
+
 // Mutation
-void mutate(Gene* genome, int genome_length) {
-    // 1% chance to mutate the entire genome
-    if (rand() / (float)RAND_MAX < MUTATION_RATE) {
-        // Select a random gene from the genome
-        int gene_to_mutate = rand() % genome_length;
-        
-        // Flip a random bit within that gene
-        uint64_t mask = 1ULL << (rand() % 64);  // 64 bits in your gene
-        genome[gene_to_mutate].gene ^= mask;
+void mutate(Gene* genome, int genome_length, const MutationRates* rates, RngStream* rng) {
+    mutate_population(&genome, 1, genome_length, rates, rng);
+}
+
+// Survivor index
+SurvivorIndex* build_survivor_index(const uint32_t* survivors, const float* fitness, uint32_t count, SelectionMode mode) {
+    SurvivorIndex* index = calloc(1, sizeof(SurvivorIndex));
+    if (!index) {
+        return NULL;  // Allocation failed
+    }
+    index->count = count;
+    index->mode = mode;
+    index->survivors = malloc(count * sizeof(uint32_t));
+    index->fitness = malloc(count * sizeof(float));
+    if (!index->survivors || !index->fitness) {
+        free_survivor_index(index);
+        return NULL;  // Allocation failed
     }
+    memcpy(index->survivors, survivors, count * sizeof(uint32_t));
+    memcpy(index->fitness, fitness, count * sizeof(float));
+    if (mode != SELECT_ROULETTE) {
+        return index;
+    }
+
+    // Vose's alias method: scale the weights so they average 1, then pair each
+    // slot below 1 with a slot above 1 that tops it up
+    index->alias_probability = malloc(count * sizeof(float));
+    index->alias = malloc(count * sizeof(uint32_t));
+    uint32_t* worklist = malloc(count * sizeof(uint32_t));
+    double* scaled = malloc(count * sizeof(double));
+    if (!index->alias_probability || !index->alias || !worklist || !scaled) {
+        free(worklist);
+        free(scaled);
+        free_survivor_index(index);
+        return NULL;  // Allocation failed
+    }
+    double total = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        total += fitness[i];
+    }
+    // Small slots fill the worklist from the front, large ones from the back
+    uint32_t num_small = 0;
+    uint32_t large_begin = count;
+    for (uint32_t i = 0; i < count; ++i) {
+        scaled[i] = total > 0 ? fitness[i] * count / total : 1.0;
+        if (scaled[i] < 1.0) {
+            worklist[num_small++] = i;
+        } else {
+            worklist[--large_begin] = i;
+        }
+    }
+    while (num_small > 0 && large_begin < count) {
+        uint32_t small = worklist[--num_small];
+        uint32_t large = worklist[large_begin];
+        index->alias_probability[small] = (float)scaled[small];
+        index->alias[small] = large;
+        scaled[large] -= 1.0 - scaled[small];
+        if (scaled[large] < 1.0) {
+            // The large slot has become small: move it across
+            large_begin++;
+            worklist[num_small++] = large;
+        }
+    }
+    // What is left is 1 up to rounding
+    while (num_small > 0) {
+        uint32_t slot = worklist[--num_small];
+        index->alias_probability[slot] = 1.0f;
+        index->alias[slot] = slot;
+    }
+    for (uint32_t k = large_begin; k < count; ++k) {
+        index->alias_probability[worklist[k]] = 1.0f;
+        index->alias[worklist[k]] = worklist[k];
+    }
+    free(worklist);
+    free(scaled);
+    return index;
 }
 
+void free_survivor_index(SurvivorIndex* index) {
+    if (!index) {
+        return;
+    }
+    free(index->survivors);
+    free(index->fitness);
+    free(index->alias_probability);
+    free(index->alias);
+    free(index);
+}
 
+uint32_t pick_survivor(const SurvivorIndex* index, RngStream* rng) {
+    uint32_t slot = rng_below(rng, index->count);
+    switch (index->mode) {
+        case SELECT_TOURNAMENT:
+            for (int round = 1; round < TOURNAMENT_SIZE; ++round) {
+                uint32_t challenger = rng_below(rng, index->count);
+                if (index->fitness[challenger] > index->fitness[slot]) {
+                    slot = challenger;
+                }
+            }
+            break;
+        case SELECT_ROULETTE:
+            if (rng_unit(rng) >= index->alias_probability[slot]) {
+                slot = index->alias[slot];
+            }
+            break;
+        default:
+            break;
+    }
+    return index->survivors[slot];
+}
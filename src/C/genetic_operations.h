@@ -2,20 +2,91 @@
 #define GENETIC_OPERATIONS_H
 
 #include "gene_encoding.h"  // Assuming this is where your Gene struct is defined
+#include "rng.h"
 
 // Mutation rate constant
 #define MUTATION_RATE 0.0001  // A 0.1% mutation rate
 
+// Chances of mutation at each level; every hit flips one bit. The levels are
+// independent, so a genome can be hit at several.
+typedef struct {
+    double genome_rate;  // Chance that a genome gets one random bit flipped
+    double gene_rate;    // Chance that a gene gets one random bit flipped
+    double bit_rate;     // Chance that any single bit flips
+} MutationRates;
+
+// Number of survivors drawn per tournament in SELECT_TOURNAMENT
+#define TOURNAMENT_SIZE 3
+
+// How parents are picked among the survivors of a generation
+typedef enum {
+    SELECT_UNIFORM,     // Every survivor equally likely
+    SELECT_TOURNAMENT,  // Fittest of TOURNAMENT_SIZE survivors drawn uniformly
+    SELECT_ROULETTE,    // Survivors drawn in proportion to their fitness
+} SelectionMode;
+
+/*
+ * The survivors of a generation, collected once so that every parent pick takes
+ * constant time however few creatures survived. Roulette selection samples an
+ * alias table (Vose's method) built from the fitness values.
+ */
+typedef struct {
+    uint32_t* survivors;        // Creature index of each survivor
+    float* fitness;             // Fitness of each survivor
+    float* alias_probability;   // Roulette: chance of keeping slot i rather than taking alias[i]
+    uint32_t* alias;            // Roulette: slot taken in place of slot i
+    uint32_t count;             // Number of survivors
+    SelectionMode mode;         // How pick_survivor picks
+} SurvivorIndex;
+
 // Function Prototypes
 
 /**
- * Performs two-point crossover on two parent genomes to create two offspring genomes.
+ * Collects the survivors of a generation for parent selection.
+ *
+ * @param survivors Creature index of each survivor.
+ * @param fitness Fitness of each survivor, non-negative; only read by tournament and roulette selection.
+ * @param count Number of survivors, at least 1.
+ * @param mode How parents are picked.
+ * @return Pointer to the new index, or NULL if allocation failed.
+ */
+SurvivorIndex* build_survivor_index(const uint32_t* survivors, const float* fitness, uint32_t count, SelectionMode mode);
+
+/**
+ * Deallocates a survivor index.
+ */
+void free_survivor_index(SurvivorIndex* index);
+
+/**
+ * Picks a parent in constant time, drawing from the given stream.
+ *
+ * @return Creature index of the parent.
+ */
+uint32_t pick_survivor(const SurvivorIndex* index, RngStream* rng);
+
+/**
+ * Performs two-point crossover on two parent genomes to create two offspring genomes,
+ * drawing the crossover points from the given stream.
+ */
+void two_point_crossover(Gene* parent1, Gene* parent2, Gene* offspring1, Gene* offspring2, int genome_length, RngStream* rng);
+
+/**
+ * Mutates a given genome based on the mutation rates, drawing from the given stream.
  */
-void two_point_crossover(Gene* parent1, Gene* parent2, Gene* offspring1, Gene* offspring2, int genome_length);
+void mutate(Gene* genome, int genome_length, const MutationRates* rates, RngStream* rng);
 
 /**
- * Mutates a given genome based on the mutation rate.
+ * Mutates many genomes in one pass. At each level the genomes are treated as one
+ * concatenated pool and the gap to the next mutated genome, gene or bit is drawn
+ * from a geometric distribution, so the cost is proportional to the number of
+ * mutations rather than to the size of the pool.
+ *
+ * @param genomes Genomes to mutate.
+ * @param count Number of genomes.
+ * @param genome_length Number of genes in every genome.
+ * @param rates Chances of mutation at each level.
+ * @param rng Stream every gap and flipped bit is drawn from.
  */
-void mutate(Gene* genome, int genome_length);
+void mutate_population(Gene** genomes, uint32_t count, int genome_length, const MutationRates* rates, RngStream* rng);
 
 #endif // GENETIC_OPERATIONS_H
@@ -0,0 +1,212 @@
+#include "genome_archive.h"
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifndef _WIN32
+
+// Round a size up to the alignment of the generations in the file
+static uint64_t align_block(uint64_t size) {
+    return (size + GENOME_ARCHIVE_ALIGNMENT - 1) & ~(uint64_t)(GENOME_ARCHIVE_ALIGNMENT - 1);
+}
+
+// Unmap a generation and move the arena that was on it back to its own block
+static void unmap_generation(MappedGeneration* mapped) {
+    if (mapped->arena) {
+        place_arena(mapped->arena, NULL, 0);
+    }
+    if (mapped->mapping) {
+        munmap(mapped->mapping, mapped->mapping_size);
+    }
+    memset(mapped, 0, sizeof(*mapped));
+}
+
+/**
+ * Open an archive for appending, creating it if it does not exist.
+ *
+ * @param filename Name of the archive file.
+ * @return Pointer to the archive, or NULL if the file is not an archive, cannot be opened or allocation failed.
+ */
+GenomeArchive* open_genome_archive(const char* filename) {
+    int fd = open(filename, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return NULL;  // File open failed
+    }
+    struct stat status;
+    GenomeArchiveHeader header;
+    uint64_t end;
+    if (fstat(fd, &status) != 0) {
+        close(fd);
+        return NULL;  // File open failed
+    }
+    if (status.st_size == 0) {
+        header.magic = GENOME_ARCHIVE_MAGIC;
+        header.version = GENOME_ARCHIVE_VERSION;
+        header.gene_size = sizeof(Gene);
+        end = align_block(sizeof(header));
+        if (pwrite(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) || ftruncate(fd, (off_t)end) != 0) {
+            close(fd);
+            return NULL;  // Write failed
+        }
+    } else {
+        // Append after whatever is there, every generation is self-contained
+        if (pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) || header.magic != GENOME_ARCHIVE_MAGIC ||
+            header.version != GENOME_ARCHIVE_VERSION || header.gene_size != sizeof(Gene)) {
+            close(fd);
+            return NULL;  // Not an archive of this version
+        }
+        end = align_block((uint64_t)status.st_size);
+    }
+
+    GenomeArchive* archive = calloc(1, sizeof(GenomeArchive));
+    if (!archive) {
+        close(fd);
+        return NULL;  // Allocation failed
+    }
+    archive->fd = fd;
+    archive->end = end;
+    long page_size = sysconf(_SC_PAGESIZE);
+    archive->page_size = page_size > 0 ? (size_t)page_size : 4096;
+    return archive;
+}
+
+/**
+ * Append a generation and place a genome arena on its genomes, so that
+ * genomes allocated from the arena, in creature order, are written to the
+ * archive. The generation the arena was on before is unmapped. Every parent
+ * starts as GENOME_ARCHIVE_NO_PARENT and nothing as survived.
+ *
+ * @param archive Pointer to the archive.
+ * @param arena The genome arena the generation is bred in.
+ * @param generation Times the creatures had been bred.
+ * @param num_genomes Number of genomes.
+ * @param genome_length Genes per genome.
+ * @return The new generation, or NULL if the archive failed, in which case the arena is back on its own block.
+ */
+GenomeArchiveGeneration* begin_archived_generation(GenomeArchive* archive, Arena* arena, uint32_t generation,
+                                                   uint32_t num_genomes, int genome_length) {
+    // Reuse the arena's slot, or take a free one
+    MappedGeneration* mapped = NULL;
+    for (int k = 0; k < 2 && !mapped; ++k) {
+        if (archive->mapped[k].arena == arena) {
+            mapped = &archive->mapped[k];
+        }
+    }
+    for (int k = 0; k < 2 && !mapped; ++k) {
+        if (!archive->mapped[k].arena) {
+            mapped = &archive->mapped[k];
+        }
+    }
+    if (!mapped) {
+        mapped = &archive->mapped[0];
+    }
+    unmap_generation(mapped);
+    place_arena(arena, NULL, 0);
+    if (archive->failed) {
+        return NULL;
+    }
+
+    // Genomes are laid out the way arena_alloc hands them out
+    uint64_t stride = ((uint64_t)genome_length * sizeof(Gene) + ARENA_ALIGNMENT - 1) & ~(uint64_t)(ARENA_ALIGNMENT - 1);
+    uint64_t genomes_offset = align_block(sizeof(GenomeArchiveGeneration) + (uint64_t)num_genomes * sizeof(GenomeArchiveRecord));
+    uint64_t size = align_block(genomes_offset + num_genomes * stride);
+    uint64_t offset = archive->end;
+    uint64_t map_start = offset & ~(uint64_t)(archive->page_size - 1);
+    if (ftruncate(archive->fd, (off_t)(offset + size)) != 0) {
+        archive->failed = true;
+        return NULL;  // Growing the file failed
+    }
+    void* mapping = mmap(NULL, offset + size - map_start, PROT_READ | PROT_WRITE, MAP_SHARED, archive->fd, (off_t)map_start);
+    if (mapping == MAP_FAILED) {
+        archive->failed = true;
+        return NULL;  // Mapping failed
+    }
+    archive->end = offset + size;
+
+    // The file was grown with zeros, so only the nonzero fields are written
+    GenomeArchiveGeneration* block = (GenomeArchiveGeneration*)((uint8_t*)mapping + (offset - map_start));
+    block->magic = GENOME_ARCHIVE_MAGIC;
+    block->generation = generation;
+    block->num_genomes = num_genomes;
+    block->genome_length = (uint32_t)genome_length;
+    block->genome_stride = (uint32_t)stride;
+    block->genomes_offset = genomes_offset;
+    block->size = size;
+    GenomeArchiveRecord* records = archived_records(block);
+    for (uint32_t i = 0; i < num_genomes; ++i) {
+        records[i].parents[0] = GENOME_ARCHIVE_NO_PARENT;
+        records[i].parents[1] = GENOME_ARCHIVE_NO_PARENT;
+    }
+
+    mapped->mapping = mapping;
+    mapped->mapping_size = offset + size - map_start;
+    mapped->generation = block;
+    mapped->arena = arena;
+    place_arena(arena, (uint8_t*)block + genomes_offset, num_genomes * stride);
+    return block;
+}
+
+/**
+ * Move the arenas placed on the archive back onto their own blocks, unmap
+ * every generation, close the file and deallocate the archive. Genomes
+ * allocated from the arenas while they were on the archive become invalid,
+ * and the arenas must still exist.
+ *
+ * @param archive Pointer to the archive, NULL is ignored.
+ */
+void close_genome_archive(GenomeArchive* archive) {
+    if (!archive) {
+        return;
+    }
+    for (int k = 0; k < 2; ++k) {
+        unmap_generation(&archive->mapped[k]);
+    }
+    close(archive->fd);
+    free(archive);
+}
+
+#else
+
+// Memory-mapped archives are only built on POSIX systems
+
+GenomeArchive* open_genome_archive(const char* filename) {
+    (void)filename;
+    return NULL;
+}
+
+GenomeArchiveGeneration* begin_archived_generation(GenomeArchive* archive, Arena* arena, uint32_t generation,
+                                                   uint32_t num_genomes, int genome_length) {
+    (void)archive;
+    (void)generation;
+    (void)num_genomes;
+    (void)genome_length;
+    place_arena(arena, NULL, 0);
+    return NULL;
+}
+
+void close_genome_archive(GenomeArchive* archive) {
+    free(archive);
+}
+
+#endif
+
+/**
+ * Find the generation an arena is placed on.
+ *
+ * @param archive Pointer to the archive, NULL is ignored.
+ * @param arena The genome arena.
+ * @return The generation, or NULL if the arena is not on one.
+ */
+GenomeArchiveGeneration* archived_generation(GenomeArchive* archive, const Arena* arena) {
+    for (int k = 0; archive && k < 2; ++k) {
+        if (archive->mapped[k].arena == arena) {
+            return archive->mapped[k].generation;
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,144 @@
+#ifndef GENOME_ARCHIVE_H
+#define GENOME_ARCHIVE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "arena.h"
+#include "gene_encoding.h"
+
+// First word of an archive and of every generation in it, "EGNA" in a little-endian file
+#define GENOME_ARCHIVE_MAGIC 0x414E4745u
+// Version of the layout below, bumped on every incompatible change
+#define GENOME_ARCHIVE_VERSION 1
+// Alignment of every generation in the file
+#define GENOME_ARCHIVE_ALIGNMENT 64
+// Parent of a genome that was spawned rather than bred
+#define GENOME_ARCHIVE_NO_PARENT 0xFFFFFFFFu
+
+/*
+ * An append-only file holding the genome of every creature of every
+ * generation, in host byte order like a snapshot. It starts with a
+ * GenomeArchiveHeader, padded to GENOME_ARCHIVE_ALIGNMENT; each generation
+ * follows as one aligned block: a GenomeArchiveGeneration, a
+ * GenomeArchiveRecord per genome, then at genomes_offset the genomes
+ * themselves, genome_stride bytes apart, exactly as they lay in the genome
+ * arena.
+ *
+ * The archive is mapped into memory and a generation's genome arena is placed
+ * on its block before breeding, so offspring are crossed over and mutated
+ * straight into the file: nothing is copied or serialized. Readers map the
+ * file and use the genomes in place (see archived_genome). A resumed run
+ * appends to the same file from the next generation it breeds, so the
+ * generation it was resumed in never has its survivors marked; a generation
+ * bred again after an older checkpoint appears twice, the later copy being the
+ * one that went on.
+ */
+typedef struct {
+    uint32_t magic;          // GENOME_ARCHIVE_MAGIC
+    uint16_t version;        // GENOME_ARCHIVE_VERSION
+    uint16_t gene_size;      // Bytes per gene, sizeof(Gene)
+} GenomeArchiveHeader;
+
+// Progress of a generation, bits of GenomeArchiveGeneration.flags
+typedef enum {
+    ARCHIVE_GENOMES_COMPLETE = 1,   // Every genome is bred and every parent recorded
+    ARCHIVE_SURVIVAL_RECORDED = 2   // The generation has ended and the survivors are marked
+} GenomeArchiveFlag;
+
+// Start of the block of a generation
+typedef struct {
+    uint32_t magic;            // GENOME_ARCHIVE_MAGIC
+    uint32_t generation;       // Times the creatures had been bred
+    uint32_t num_genomes;      // Number of genomes, one per creature index
+    uint32_t genome_length;    // Genes per genome
+    uint32_t genome_stride;    // Bytes from one genome to the next
+    uint32_t flags;            // GenomeArchiveFlag bits
+    uint32_t num_survivors;    // Genomes marked survived
+    uint32_t reserved;         // Zero
+    uint64_t genomes_offset;   // Offset of the first genome from the start of the block
+    uint64_t size;             // Size of the block in bytes, a multiple of GENOME_ARCHIVE_ALIGNMENT
+} GenomeArchiveGeneration;
+
+// Lineage and fate of one genome
+typedef struct {
+    uint32_t parents[2];       // Creature indices of the parents in the previous generation, the closer first
+    uint8_t survived;          // Whether the creature was chosen to breed at the end of its generation
+    uint8_t reserved[3];       // Zero
+} GenomeArchiveRecord;
+
+// A generation block mapped into memory
+typedef struct {
+    uint8_t* mapping;                     // Start of the mapping, page aligned
+    size_t mapping_size;
+    GenomeArchiveGeneration* generation;  // The block, within the mapping
+    Arena* arena;                         // Arena placed on the block's genomes
+} MappedGeneration;
+
+/*
+ * An archive being appended to. The generations whose genomes are still in
+ * use, the current one and the one being bred, stay mapped; older ones are
+ * unmapped once their arena moves on.
+ */
+typedef struct GenomeArchive {
+    int fd;                       // The archive file
+    uint64_t end;                 // Where the next generation goes
+    size_t page_size;
+    MappedGeneration mapped[2];   // Generations the grid's two genome arenas are placed on
+    bool failed;                  // Whether growing or mapping the file failed, which stops archiving
+} GenomeArchive;
+
+// Records of the genomes of a generation
+static inline GenomeArchiveRecord* archived_records(GenomeArchiveGeneration* generation) {
+    return (GenomeArchiveRecord*)(generation + 1);
+}
+
+// Genes of the index-th genome of a generation
+static inline Gene* archived_genome(GenomeArchiveGeneration* generation, uint32_t index) {
+    return (Gene*)((uint8_t*)generation + generation->genomes_offset + (size_t)index * generation->genome_stride);
+}
+
+/**
+ * Open an archive for appending, creating it if it does not exist.
+ *
+ * @param filename Name of the archive file.
+ * @return Pointer to the archive, or NULL if the file is not an archive, cannot be opened or allocation failed.
+ */
+GenomeArchive* open_genome_archive(const char* filename);
+
+/**
+ * Append a generation and place a genome arena on its genomes, so that
+ * genomes allocated from the arena, in creature order, are written to the
+ * archive. The generation the arena was on before is unmapped. Every parent
+ * starts as GENOME_ARCHIVE_NO_PARENT and nothing as survived.
+ *
+ * @param archive Pointer to the archive.
+ * @param arena The genome arena the generation is bred in.
+ * @param generation Times the creatures had been bred.
+ * @param num_genomes Number of genomes.
+ * @param genome_length Genes per genome.
+ * @return The new generation, or NULL if the archive failed, in which case the arena is back on its own block.
+ */
+GenomeArchiveGeneration* begin_archived_generation(GenomeArchive* archive, Arena* arena, uint32_t generation,
+                                                   uint32_t num_genomes, int genome_length);
+
+/**
+ * Find the generation an arena is placed on.
+ *
+ * @param archive Pointer to the archive, NULL is ignored.
+ * @param arena The genome arena.
+ * @return The generation, or NULL if the arena is not on one.
+ */
+GenomeArchiveGeneration* archived_generation(GenomeArchive* archive, const Arena* arena);
+
+/**
+ * Move the arenas placed on the archive back onto their own blocks, unmap
+ * every generation, close the file and deallocate the archive. Genomes
+ * allocated from the arenas while they were on the archive become invalid,
+ * and the arenas must still exist.
+ *
+ * @param archive Pointer to the archive, NULL is ignored.
+ */
+void close_genome_archive(GenomeArchive* archive);
+
+#endif // GENOME_ARCHIVE_H
@@ -2,6 +2,9 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+// Step of each wall direction, LW_n to LW_nw
+static const int8_t wall_dx[NUM_WALL_DIRECTIONS] = {0, 1, 1, 1, 0, -1, -1, -1};
+static const int8_t wall_dy[NUM_WALL_DIRECTIONS] = {-1, -1, 0, 1, 1, 1, 0, -1};
 
 /**
  * Initializes a new grid with the given width and height.
@@ -21,47 +24,217 @@ Grid* initialize_grid(uint16_t width, uint16_t height, uint32_t max_creatures, u
     grid->max_creatures = max_creatures;
     grid->max_steps = max_steps;
     grid->num_generations = 0;
+    grid->steps_taken = 0;
+    grid->generation = 0;
+    grid->seed = 0;
     grid->num_genomes = num_genomes;
     grid->num_creatures_alive_last_gen = 0;
-    grid->cells = malloc(width * height * sizeof(Cell));
-    if (!grid->cells) {
+    grid->evaluation_mode = EVAL_TOPOLOGICAL;
+    grid->activation_accuracy = ACTIVATION_PRECISE;
+    grid->brain_precision = BRAIN_PRECISION_FLOAT;
+    grid->selection_mode = SELECT_UNIFORM;
+    grid->mutation_rates.genome_rate = MUTATION_RATE;
+    grid->mutation_rates.gene_rate = 0;
+    grid->mutation_rates.bit_rate = 0;
+    grid->brain_batch = NULL;
+    grid->brain_cache = create_brain_cache(max_creatures);
+    grid->live_creatures = malloc((max_creatures ? max_creatures : 1) * sizeof(uint32_t));
+    // Every cell starts empty: all bitplanes share one zeroed block. Each plane has
+    // a spare word so reads of a few bits past the last cell stay in bounds.
+    uint32_t num_cells = (uint32_t)width * height;
+    uint32_t words_per_plane = grid_plane_words(width, height);
+    grid->cell_flags[0] = calloc((size_t)NUM_CELL_FLAGS * words_per_plane, sizeof(uint64_t));
+    for (int f = 1; f < NUM_CELL_FLAGS; ++f) {
+        grid->cell_flags[f] = grid->cell_flags[0] ? grid->cell_flags[f - 1] + words_per_plane : NULL;
+    }
+    uint32_t summary_words = words_per_plane / 64 + 1;
+    grid->changed_words[0] = calloc((size_t)NUM_CELL_FLAGS * summary_words, sizeof(uint64_t));
+    for (int f = 1; f < NUM_CELL_FLAGS; ++f) {
+        grid->changed_words[f] = grid->changed_words[0] ? grid->changed_words[f - 1] + summary_words : NULL;
+    }
+    grid->creature_ids = calloc(num_cells ? num_cells : 1, sizeof(uint32_t));
+    // There are no walls yet, so every distance starts at 0
+    grid->wall_distances[0] = calloc((size_t)NUM_WALL_DIRECTIONS * (num_cells ? num_cells : 1), sizeof(uint16_t));
+    for (int d = 1; d < NUM_WALL_DIRECTIONS; ++d) {
+        grid->wall_distances[d] = grid->wall_distances[0] ? grid->wall_distances[d - 1] + num_cells : NULL;
+    }
+    grid->num_tiles = ((width + GRID_TILE_SIZE - 1) / GRID_TILE_SIZE) * ((height + GRID_TILE_SIZE - 1) / GRID_TILE_SIZE);
+    grid->tile_offsets = malloc((grid->num_tiles + 1) * sizeof(uint32_t));
+    grid->tile_creatures = malloc((max_creatures ? max_creatures : 1) * sizeof(uint32_t));
+    grid->thread_pool = create_thread_pool(0, false);
+    // Room for every creature's genome, each allocation padded to the arena alignment
+    size_t genome_bytes = ((size_t)num_genomes * sizeof(Gene) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+    grid->genome_arena = create_arena((size_t)max_creatures * genome_bytes);
+    grid->next_genome_arena = create_arena((size_t)max_creatures * genome_bytes);
+    grid->genome_archive = NULL;
+    grid->free_cells.num_words = words_per_plane;
+    grid->free_cells.num_free = 0;
+    grid->free_cells.bits = malloc(words_per_plane * sizeof(uint64_t));
+    grid->free_cells.counts = malloc((words_per_plane + 1) * sizeof(uint32_t));
+    if (!grid->cell_flags[0] || !grid->changed_words[0] || !grid->creature_ids || !grid->wall_distances[0] || !grid->brain_cache ||
+        !grid->live_creatures || !grid->tile_offsets || !grid->tile_creatures || !grid->thread_pool || !grid->genome_arena || !grid->next_genome_arena ||
+        !grid->free_cells.bits || !grid->free_cells.counts) {
+        free(grid->free_cells.bits);
+        free(grid->free_cells.counts);
+        free_arena(grid->genome_arena);
+        free_arena(grid->next_genome_arena);
+        free_thread_pool(grid->thread_pool);
+        free(grid->tile_offsets);
+        free(grid->tile_creatures);
+        free(grid->wall_distances[0]);
+        free_brain_cache(grid->brain_cache);
+        free(grid->live_creatures);
+        free(grid->creature_ids);
+        free(grid->changed_words[0]);
+        free(grid->cell_flags[0]);
         free(grid);
         return NULL;  // Allocation failed
     }
-    // Initialize cell data to defaults
-    for (uint32_t i = 0; i < width * height; ++i) {
-        grid->cells[i].flags.occupied = 0;
-        grid->cells[i].flags.food = 0;
-        grid->cells[i].flags.poison = 0;
-        grid->cells[i].flags.wall = 0;
-        grid->cells[i].flags.sunlit = 0;
-        grid->cells[i].flags.water = 0;
-        grid->cells[i].creature_id = 0;
-    }
     return grid;
 }
 
 /**
- * Deallocate memory associated with the grid.
+ * Change the number of threads a step runs on. Results do not depend on it.
+ *
+ * @param grid Pointer to the grid.
+ * @param num_threads Number of threads, 0 for one per processor.
+ * @param pin_threads Bind each worker thread to its own processor.
+ * @return 0 on success, non-zero if the threads could not be started.
+ */
+int set_grid_threads(Grid* grid, uint32_t num_threads, bool pin_threads){
+    ThreadPool* pool = create_thread_pool(num_threads, pin_threads);
+    if (!pool) {
+        return 1;  // Allocation failed
+    }
+    free_thread_pool(grid->thread_pool);
+    grid->thread_pool = pool;
+    return 0;
+}
+
+/**
+ * Deallocate memory associated with the grid. Brains still held by creatures
+ * are freed along with the brain cache, and their genomes with the genome arenas.
  * 
  * @param grid Pointer to the grid to be deallocated.
  */
 void free_grid(Grid* grid){
-    free(grid->cells);
+    free_brain_batch(grid->brain_batch);
+    free_brain_cache(grid->brain_cache);
+    free_thread_pool(grid->thread_pool);
+    free_arena(grid->genome_arena);
+    free_arena(grid->next_genome_arena);
+    free(grid->free_cells.bits);
+    free(grid->free_cells.counts);
+    free(grid->tile_offsets);
+    free(grid->tile_creatures);
+    free(grid->live_creatures);
+    free(grid->creature_ids);
+    free(grid->changed_words[0]);
+    free(grid->cell_flags[0]);
+    free(grid->wall_distances[0]);
     free(grid);
 }
 
 
 /**
- * Retrieve the cell at the given coordinates.
+ * Retrieve a snapshot of the cell at the given coordinates. Changes to the
+ * snapshot are not stored; write them back with set_cell.
  * 
  * @param grid Pointer to the grid.
  * @param x X-coordinate.
  * @param y Y-coordinate.
- * @return Pointer to the Cell at the given coordinates.
+ * @return The flags and creature ID of the cell.
+ */
+Cell get_cell(const Grid* grid, uint16_t x, uint16_t y){
+    Cell cell;
+    cell.flags.occupied = get_cell_flag(grid, CELL_OCCUPIED, x, y);
+    cell.flags.food = get_cell_flag(grid, CELL_FOOD, x, y);
+    cell.flags.poison = get_cell_flag(grid, CELL_POISON, x, y);
+    cell.flags.wall = get_cell_flag(grid, CELL_WALL, x, y);
+    cell.flags.sunlit = get_cell_flag(grid, CELL_SUNLIT, x, y);
+    cell.flags.water = get_cell_flag(grid, CELL_WATER, x, y);
+    cell.flags.unused = 0;
+    cell.creature_id = get_creature_id(grid, x, y);
+    return cell;
+}
+
+/**
+ * Overwrite every flag and the creature ID of the cell at the given coordinates.
+ *
+ * @param grid Pointer to the grid.
+ * @param x X-coordinate.
+ * @param y Y-coordinate.
+ * @param cell New contents of the cell.
  */
-Cell* get_cell(Grid* grid, uint16_t x, uint16_t y){
-    return &grid->cells[y * grid->width + x];
+void set_cell(Grid* grid, uint16_t x, uint16_t y, Cell cell){
+    set_cell_flag(grid, CELL_OCCUPIED, x, y, cell.flags.occupied);
+    set_cell_flag(grid, CELL_FOOD, x, y, cell.flags.food);
+    set_cell_flag(grid, CELL_POISON, x, y, cell.flags.poison);
+    if (get_cell_flag(grid, CELL_WALL, x, y) != cell.flags.wall) {
+        set_wall(grid, x, y, cell.flags.wall);
+    }
+    set_cell_flag(grid, CELL_SUNLIT, x, y, cell.flags.sunlit);
+    set_cell_flag(grid, CELL_WATER, x, y, cell.flags.water);
+    grid->creature_ids[(uint32_t)y * grid->width + x] = cell.creature_id;
+}
+
+// Steps from (x, y) to the first wall in direction d, given the fields of its neighbor in that direction
+static uint16_t wall_steps(const Grid* grid, int d, int x, int y) {
+    int nx = x + wall_dx[d];
+    int ny = y + wall_dy[d];
+    if (nx < 0 || nx >= grid->width || ny < 0 || ny >= grid->height) {
+        return 0;
+    }
+    if (get_cell_flag(grid, CELL_WALL, nx, ny)) {
+        return 1;
+    }
+    uint16_t steps = grid->wall_distances[d][(uint32_t)ny * grid->width + nx];
+    return steps ? steps + 1 : 0;
+}
+
+/**
+ * Add or remove a wall and update the wall-distance fields of every cell that
+ * can see it, without rebuilding them.
+ *
+ * @param grid Pointer to the grid.
+ * @param x X-coordinate.
+ * @param y Y-coordinate.
+ * @param wall Whether the cell holds a wall.
+ */
+void set_wall(Grid* grid, uint16_t x, uint16_t y, bool wall){
+    set_cell_flag(grid, CELL_WALL, x, y, wall);
+    // Only the cells looking at (x, y) change: walk back from it in each direction
+    // until the ray leaves the grid or passes a wall, which hides everything behind it
+    for (int d = 0; d < NUM_WALL_DIRECTIONS; ++d) {
+        int cx = x - wall_dx[d];
+        int cy = y - wall_dy[d];
+        while (cx >= 0 && cx < grid->width && cy >= 0 && cy < grid->height) {
+            grid->wall_distances[d][(uint32_t)cy * grid->width + cx] = wall_steps(grid, d, cx, cy);
+            if (get_cell_flag(grid, CELL_WALL, cx, cy)) {
+                break;
+            }
+            cx -= wall_dx[d];
+            cy -= wall_dy[d];
+        }
+    }
+}
+
+/**
+ * Recompute the wall-distance fields of the whole grid from the wall bitplane.
+ *
+ * @param grid Pointer to the grid.
+ */
+void build_wall_distances(Grid* grid){
+    for (int d = 0; d < NUM_WALL_DIRECTIONS; ++d) {
+        // Sweep against the direction so each cell's neighbor is already done
+        for (int j = 0; j < grid->height; ++j) {
+            int y = wall_dy[d] < 0 ? j : grid->height - 1 - j;
+            for (int i = 0; i < grid->width; ++i) {
+                int x = wall_dx[d] < 0 ? i : grid->width - 1 - i;
+                grid->wall_distances[d][(uint32_t)y * grid->width + x] = wall_steps(grid, d, x, y);
+            }
+        }
+    }
 }
 
 /**
@@ -79,8 +252,8 @@ int output_grid_to_csv(Grid* grid, const char* filename){
     fprintf(file, "X,Y,Occupied,Food,Poison,Wall,Sunlit,Water,CreatureID\n");
     for (uint16_t y = 0; y < grid->height; ++y) {
         for (uint16_t x = 0; x < grid->width; ++x) {
-            Cell* cell = get_cell(grid, x, y);
-            fprintf(file, "%d,%d,%d,%d,%d,%d,%d,%d,%d\n", x, y, cell->flags.occupied, cell->flags.food, cell->flags.poison, cell->flags.wall, cell->flags.sunlit, cell->flags.water, cell->creature_id);
+            Cell cell = get_cell(grid, x, y);
+            fprintf(file, "%d,%d,%d,%d,%d,%d,%d,%d,%u\n", x, y, cell.flags.occupied, cell.flags.food, cell.flags.poison, cell.flags.wall, cell.flags.sunlit, cell.flags.water, cell.creature_id);
         }
     }
     fclose(file);
@@ -92,14 +265,89 @@ int output_grid_to_csv(Grid* grid, const char* filename){
  * in empty cells so it doesn't overwrite creatures or other items.
  */
 void scatter_food(Grid* grid, uint32_t amount) {
-    uint32_t placed = 0;
-    while (placed < amount) {
-        uint16_t x = rand() % grid->width;
-        uint16_t y = rand() % grid->height;
-        Cell* cell = get_cell(grid, x, y);
-        if (!cell->flags.occupied && !cell->flags.food && !cell->flags.wall) {
-            cell->flags.food = 1;
-            placed++;
+    RngStream rng = rng_stream(grid->seed, RNG_FOOD, grid->generation, (uint32_t)grid->num_generations, 0);
+    begin_free_cell_sampling(grid, 1u << CELL_OCCUPIED | 1u << CELL_FOOD | 1u << CELL_WALL);
+    uint16_t x, y;
+    for (uint32_t placed = 0; placed < amount && take_free_cell(grid, &rng, &x, &y); ++placed) {
+        set_cell_flag(grid, CELL_FOOD, x, y, true);
+    }
+}
+
+/**
+ * Collect the cells that have none of the given flags as the free cells that
+ * take_free_cell draws from. Changes to the grid afterwards are not seen.
+ *
+ * @param grid Pointer to the grid.
+ * @param blocking_flags Cells with any of these flags are not free, a mask of 1 << CellFlag.
+ */
+void begin_free_cell_sampling(Grid* grid, uint32_t blocking_flags) {
+    FreeCellSampler* sampler = &grid->free_cells;
+    uint32_t num_cells = (uint32_t)grid->width * grid->height;
+    sampler->num_free = 0;
+    sampler->counts[0] = 0;
+    for (uint32_t w = 0; w < sampler->num_words; ++w) {
+        uint64_t blocked = 0;
+        for (int f = 0; f < NUM_CELL_FLAGS; ++f) {
+            if (blocking_flags >> f & 1u) {
+                blocked |= grid->cell_flags[f][w];
+            }
         }
+        // Bits past the last cell are never free
+        uint64_t in_grid = (uint64_t)w * 64 + 64 <= num_cells ? ~(uint64_t)0
+                         : (uint64_t)w * 64 < num_cells ? ((uint64_t)1 << (num_cells - w * 64)) - 1 : 0;
+        sampler->bits[w] = ~blocked & in_grid;
+        sampler->counts[w + 1] = (uint32_t)__builtin_popcountll(sampler->bits[w]);
+        sampler->num_free += sampler->counts[w + 1];
     }
-}
\ No newline at end of file
+    // Turn the per-word counts into a Fenwick tree in place
+    for (uint32_t i = 1; i <= sampler->num_words; ++i) {
+        uint32_t parent = i + (i & -i);
+        if (parent <= sampler->num_words) {
+            sampler->counts[parent] += sampler->counts[i];
+        }
+    }
+}
+
+/**
+ * Draw a free cell uniformly at random and remove it from the free cells.
+ *
+ * @param grid Pointer to the grid.
+ * @param rng Stream the cell is drawn from.
+ * @param x Receives the X-coordinate of the cell.
+ * @param y Receives the Y-coordinate of the cell.
+ * @return false if no free cell is left.
+ */
+bool take_free_cell(Grid* grid, RngStream* rng, uint16_t* x, uint16_t* y) {
+    FreeCellSampler* sampler = &grid->free_cells;
+    if (sampler->num_free == 0) {
+        return false;
+    }
+    // Find the word holding the free cell of the drawn rank by descending the tree
+    uint32_t rank = rng_below(rng, sampler->num_free);
+    uint32_t position = 0;
+    uint32_t step = 1;
+    while (step * 2 <= sampler->num_words) {
+        step *= 2;
+    }
+    for (; step > 0; step /= 2) {
+        if (position + step <= sampler->num_words && sampler->counts[position + step] <= rank) {
+            position += step;
+            rank -= sampler->counts[position];
+        }
+    }
+    // Then the cell of the remaining rank within the word
+    uint64_t bits = sampler->bits[position];
+    for (; rank > 0; --rank) {
+        bits &= bits - 1;
+    }
+    uint32_t bit = (uint32_t)__builtin_ctzll(bits);
+    sampler->bits[position] &= ~((uint64_t)1 << bit);
+    for (uint32_t i = position + 1; i <= sampler->num_words; i += i & -i) {
+        sampler->counts[i]--;
+    }
+    sampler->num_free--;
+    uint32_t cell = position * 64 + bit;
+    *x = cell % grid->width;
+    *y = cell / grid->width;
+    return true;
+}
@@ -2,6 +2,15 @@
 #define GRID_H
 #include <stdbool.h>
 #include <stdint.h>
+#include "neuron_encoding.h"
+#include "activation.h"
+#include "brain_batch.h"
+#include "brain_cache.h"
+#include "thread_pool.h"
+#include "rng.h"
+#include "genetic_operations.h"
+#include "arena.h"
+#include "genome_archive.h"
 
 // Type definition for a single cell in the grid.
 typedef struct {
@@ -15,24 +24,133 @@ typedef struct {
 } CellFlags;
 
 
+// Snapshot of a single cell, as returned by get_cell
 typedef struct {
     CellFlags flags;
     uint32_t creature_id;
 } Cell;
 
+// Per-cell flags, one bitplane each
+typedef enum {
+    CELL_OCCUPIED,
+    CELL_FOOD,
+    CELL_POISON,
+    CELL_WALL,
+    CELL_SUNLIT,
+    CELL_WATER,
+    NUM_CELL_FLAGS
+} CellFlag;
+
+// Number of directions the LW_* sensors look for walls in
+#define NUM_WALL_DIRECTIONS 8
+
+// Side of the square tiles creatures are grouped into for parallel sensing
+#define GRID_TILE_SIZE 64
+
+/*
+ * Cells still free for placement: a bitplane of free cells plus a Fenwick tree
+ * of the number of free cells in each of its words, so a uniformly random free
+ * cell is found by rank in O(log words) however densely the grid is filled.
+ */
+typedef struct {
+    uint64_t* bits;       // One bit per free cell, laid out like a bitplane
+    uint32_t* counts;     // Fenwick tree of free cells per word, 1-based, num_words + 1 entries
+    uint32_t num_words;   // Words in bits
+    uint32_t num_free;    // Cells still free
+} FreeCellSampler;
+
 // Type definition for the entire grid.
 typedef struct {
-    Cell* cells;  // 2D array of cells
+    uint64_t* cell_flags[NUM_CELL_FLAGS]; // One bitplane per CellFlag, bit y * width + x of each
+    uint64_t* changed_words[NUM_CELL_FLAGS]; // One bit per word of each bitplane, set when the word is written; the replay recorder clears them
+    uint32_t* creature_ids; // ID of the creature in each cell, 0 if none, indexed by y * width + x
+    uint16_t* wall_distances[NUM_WALL_DIRECTIONS]; // Steps from each cell to the nearest wall in each LW_* direction, 0 if none
     uint16_t width;  // Width of the grid
     uint16_t height;  // Height of the grid
-    uint32_t num_creatures; // Number of creatures in the grid
+    uint32_t num_creatures; // Number of creatures in the grid, the length of live_creatures
+    uint32_t* live_creatures; // Indices of the creatures in the grid, in increasing order
     uint64_t num_generations; // Number of generations that have passed
+    uint32_t generation; // Number of times the creatures have been bred
+    uint64_t steps_taken; // Calls to update_grid since the run started, including those of a run it was restored from
+    uint64_t seed; // Seed every random stream is derived from, see rng.h
     uint32_t max_steps; // Maximum number of steps to run
     uint32_t max_creatures; // Maximum number of creatures to allow
     uint32_t num_genomes; // Number of genomes to start with
     uint32_t num_creatures_alive_last_gen; // Number of creatures alive in the last generation
+    EvaluationMode evaluation_mode; // How creature brains are evaluated each step
+    ActivationAccuracy activation_accuracy; // Accuracy of sigmoid and tanh in batched evaluation
+    BrainPrecision brain_precision; // Number format of batched evaluation
+    SelectionMode selection_mode; // How parents are picked among the survivors
+    MutationRates mutation_rates; // Chances of mutation of every offspring
+    BrainBatch* brain_batch; // Brains of the current generation packed for batched evaluation
+    BrainCache* brain_cache; // Compiled brains shared between creatures with identical genomes
+    ThreadPool* thread_pool; // Threads shared by stepping, mating and brain compilation
+    Arena* genome_arena; // Genomes of the current generation
+    Arena* next_genome_arena; // Genomes of the generation being bred, empty between generations
+    GenomeArchive* genome_archive; // Archive every generation's genomes are bred into, NULL if none; owned by the caller
+    uint32_t num_tiles; // Number of GRID_TILE_SIZE x GRID_TILE_SIZE tiles covering the grid
+    uint32_t* tile_offsets; // First entry of each tile in tile_creatures, num_tiles + 1 entries
+    uint32_t* tile_creatures; // Indices of the live creatures grouped by tile, in increasing order within a tile
+    FreeCellSampler free_cells; // Cells left to place creatures or food in, see begin_free_cell_sampling
 } Grid;
 
+/*
+ * Cell accessors. The flags are packed one bit per cell in separate bitplanes,
+ * so a query touches 1/64 of a word instead of a whole Cell; they are inline
+ * because sensing and movement call them for every creature every step.
+ */
+
+// Words per bitplane of a width x height grid: every cell rounded up to whole
+// words, plus a spare word so get_plane_bits3 can read past the last cell
+static inline uint32_t grid_plane_words(uint32_t width, uint32_t height) {
+    return (width * height + 63) / 64 + 1;
+}
+
+// Whether a flag is set in the cell at (x, y)
+static inline bool get_cell_flag(const Grid* grid, CellFlag flag, uint16_t x, uint16_t y) {
+    uint32_t i = (uint32_t)y * grid->width + x;
+    return grid->cell_flags[flag][i >> 6] >> (i & 63) & 1;
+}
+
+// Set or clear a flag in the cell at (x, y). Use set_wall for CELL_WALL.
+static inline void set_cell_flag(Grid* grid, CellFlag flag, uint16_t x, uint16_t y, bool value) {
+    uint32_t i = (uint32_t)y * grid->width + x;
+    uint64_t bit = (uint64_t)1 << (i & 63);
+    if (value) {
+        grid->cell_flags[flag][i >> 6] |= bit;
+    } else {
+        grid->cell_flags[flag][i >> 6] &= ~bit;
+    }
+    grid->changed_words[flag][i >> 12] |= (uint64_t)1 << (i >> 6 & 63);
+}
+
+// Three consecutive bits of a bitplane, starting at bit i of the row-major cell order
+static inline uint32_t get_plane_bits3(const uint64_t* plane, uint32_t i) {
+    uint32_t shift = i & 63;
+    uint64_t bits = plane[i >> 6] >> shift;
+    if (shift > 61) {
+        bits |= plane[(i >> 6) + 1] << (64 - shift);
+    }
+    return bits & 7;
+}
+
+// ID of the creature in the cell at (x, y), 0 if none
+static inline uint32_t get_creature_id(const Grid* grid, uint16_t x, uint16_t y) {
+    return grid->creature_ids[(uint32_t)y * grid->width + x];
+}
+
+// Put a creature in the cell at (x, y)
+static inline void place_creature(Grid* grid, uint16_t x, uint16_t y, uint32_t creature_id) {
+    set_cell_flag(grid, CELL_OCCUPIED, x, y, true);
+    grid->creature_ids[(uint32_t)y * grid->width + x] = creature_id;
+}
+
+// Empty the cell at (x, y) of its creature
+static inline void remove_creature(Grid* grid, uint16_t x, uint16_t y) {
+    set_cell_flag(grid, CELL_OCCUPIED, x, y, false);
+    grid->creature_ids[(uint32_t)y * grid->width + x] = 0;
+}
+
 /**
  * Initialize a new grid with the given dimensions.
  * 
@@ -42,6 +160,16 @@ typedef struct {
  */
 Grid* initialize_grid(uint16_t width, uint16_t height, uint32_t max_creatures, uint32_t max_steps, uint32_t num_genomes);
 
+/**
+ * Change the number of threads a step runs on. Results do not depend on it.
+ *
+ * @param grid Pointer to the grid.
+ * @param num_threads Number of threads, 0 for one per processor.
+ * @param pin_threads Bind each worker thread to its own processor.
+ * @return 0 on success, non-zero if the threads could not be started.
+ */
+int set_grid_threads(Grid* grid, uint32_t num_threads, bool pin_threads);
+
 /**
  * Deallocate memory associated with the grid.
  * 
@@ -51,14 +179,43 @@ void free_grid(Grid* grid);
 
 
 /**
- * Retrieve the cell at the given coordinates.
+ * Retrieve a snapshot of the cell at the given coordinates. Changes to the
+ * snapshot are not stored; write them back with set_cell.
  * 
  * @param grid Pointer to the grid.
  * @param x X-coordinate.
  * @param y Y-coordinate.
- * @return Pointer to the Cell at the given coordinates.
+ * @return The flags and creature ID of the cell.
  */
-Cell* get_cell(Grid* grid, uint16_t x, uint16_t y);
+Cell get_cell(const Grid* grid, uint16_t x, uint16_t y);
+
+/**
+ * Overwrite every flag and the creature ID of the cell at the given coordinates.
+ *
+ * @param grid Pointer to the grid.
+ * @param x X-coordinate.
+ * @param y Y-coordinate.
+ * @param cell New contents of the cell.
+ */
+void set_cell(Grid* grid, uint16_t x, uint16_t y, Cell cell);
+
+/**
+ * Add or remove a wall and update the wall-distance fields of every cell that
+ * can see it, without rebuilding them.
+ *
+ * @param grid Pointer to the grid.
+ * @param x X-coordinate.
+ * @param y Y-coordinate.
+ * @param wall Whether the cell holds a wall.
+ */
+void set_wall(Grid* grid, uint16_t x, uint16_t y, bool wall);
+
+/**
+ * Recompute the wall-distance fields of the whole grid from the wall bitplane.
+ *
+ * @param grid Pointer to the grid.
+ */
+void build_wall_distances(Grid* grid);
 
 /**
  * Output the grid state to a CSV file for visualization.
@@ -75,8 +232,28 @@ int output_grid_to_csv(Grid* grid, const char* filename);
  * Scatter a number of food items randomly across the grid.
  *
  * @param grid Pointer to the grid.
- * @param amount Number of food cells to place.
+ * @param amount Number of food cells to place, fewer if the grid runs out of free cells.
  */
 void scatter_food(Grid* grid, uint32_t amount);
 
+/**
+ * Collect the cells that have none of the given flags as the free cells that
+ * take_free_cell draws from. Changes to the grid afterwards are not seen.
+ *
+ * @param grid Pointer to the grid.
+ * @param blocking_flags Cells with any of these flags are not free, a mask of 1 << CellFlag.
+ */
+void begin_free_cell_sampling(Grid* grid, uint32_t blocking_flags);
+
+/**
+ * Draw a free cell uniformly at random and remove it from the free cells.
+ *
+ * @param grid Pointer to the grid.
+ * @param rng Stream the cell is drawn from.
+ * @param x Receives the X-coordinate of the cell.
+ * @param y Receives the Y-coordinate of the cell.
+ * @return false if no free cell is left.
+ */
+bool take_free_cell(Grid* grid, RngStream* rng, uint16_t* x, uint16_t* y);
+
 #endif // GRID_H
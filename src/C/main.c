@@ -1,15 +1,26 @@
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include "grid.h"
 #include "neuron_encoding.h"
 #include "genetic_operations.h"
 #include "simulation.h"
+#include "snapshot.h"
+#include "snapshot_writer.h"
+#include "replay.h"
+#include "checkpoint.h"
 
-int main() {
-    // Initialize random seed
-    srand(time(NULL));
+// Set by SIGINT and SIGTERM when checkpointing, so the run saves and stops after the current step
+static volatile sig_atomic_t stop_requested = 0;
 
+static void request_stop(int signal_number) {
+    (void)signal_number;
+    stop_requested = 1;
+}
+
+int main(int argc, char** argv) {
     // Grid parameters
     uint16_t width = 300;
     uint16_t height = 300;
@@ -17,74 +28,288 @@ int main() {
     uint32_t max_steps = 300 * 10000;
     uint32_t num_genomes = 32;
 
-    printf("Initializing grid...\n");
-    // Initialize the grid
-    Grid* grid = initialize_grid(width, height, max_creatures, 300, num_genomes);
-    if (!grid) {
-        fprintf(stderr, "Grid initialization failed.\n");
-        return 1;
+    // Resume a saved run instead of starting a new one; the options below
+    // still apply on top of the restored settings
+    const char* restore_file = NULL;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (strcmp(argv[i], "--restore") == 0) {
+            restore_file = argv[i + 1];
+        }
+    }
+    Grid* grid = NULL;
+    Creature* creatures = NULL;
+    if (restore_file) {
+        printf("Restoring %s...\n", restore_file);
+        grid = load_checkpoint(restore_file, &creatures);
+        if (!grid) {
+            fprintf(stderr, "Could not restore checkpoint %s.\n", restore_file);
+            return 1;
+        }
+        max_creatures = grid->max_creatures;
+    } else {
+        printf("Initializing grid...\n");
+        // Initialize the grid
+        grid = initialize_grid(width, height, max_creatures, 300, num_genomes);
+        if (!grid) {
+            fprintf(stderr, "Grid initialization failed.\n");
+            return 1;
+        }
+
+        // Random seed, unless one is given on the command line
+        grid->seed = (uint64_t)time(NULL);
     }
 
-    printf("Initializing creatures...\n");
-    // Initialize creatures
-    Creature* creatures = malloc(max_creatures * sizeof(Creature));
-    if (!creatures) {
-        fprintf(stderr, "Creature array initialization failed.\n");
+    // Command line options
+    uint32_t num_threads = 0;
+    bool pin_threads = false;
+    bool restart_threads = false;
+    const char* snapshot_dir = NULL;
+    SnapshotFormat snapshot_format = SNAPSHOT_BINARY;
+    uint32_t snapshot_queue = 16;
+    // A writer thread only pays off when it has a processor of its own
+    WriterPolicy snapshot_policy = default_thread_count() > 1 ? WRITER_BLOCK : WRITER_INLINE;
+    const char* replay_file = NULL;
+    uint32_t keyframe_interval = 0;
+    const char* checkpoint_file = NULL;
+    uint32_t checkpoint_interval = 10000;
+    const char* archive_file = NULL;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--recursive") == 0) {
+            // Evaluate brains with the original recursive propagation
+            grid->evaluation_mode = EVAL_RECURSIVE;
+        } else if (strcmp(argv[i], "--fast-activations") == 0) {
+            // Use the bounded-error sigmoid and tanh approximations
+            grid->activation_accuracy = ACTIVATION_FAST;
+        } else if (strcmp(argv[i], "--fixed-point") == 0) {
+            // Evaluate brains with Q.12 fixed-point weights and values
+            grid->brain_precision = BRAIN_PRECISION_FIXED;
+        } else if (strcmp(argv[i], "--selection") == 0 && i + 1 < argc) {
+            // How parents are picked among the survivors
+            ++i;
+            if (strcmp(argv[i], "uniform") == 0) {
+                grid->selection_mode = SELECT_UNIFORM;
+            } else if (strcmp(argv[i], "tournament") == 0) {
+                grid->selection_mode = SELECT_TOURNAMENT;
+            } else if (strcmp(argv[i], "roulette") == 0) {
+                grid->selection_mode = SELECT_ROULETTE;
+            } else {
+                fprintf(stderr, "Unknown selection mode: %s\n", argv[i]);
+                free(creatures);
+                free_grid(grid);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--genome-mutation-rate") == 0 && i + 1 < argc) {
+            // Chance that an offspring gets one random bit flipped
+            grid->mutation_rates.genome_rate = strtod(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--gene-mutation-rate") == 0 && i + 1 < argc) {
+            // Chance that each gene of an offspring gets one random bit flipped
+            grid->mutation_rates.gene_rate = strtod(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--bit-mutation-rate") == 0 && i + 1 < argc) {
+            // Chance that each bit of an offspring flips
+            grid->mutation_rates.bit_rate = strtod(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            // Seed of every random decision, the same seed replays the same run
+            grid->seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            // Number of threads the simulation runs on, 0 for one per processor
+            num_threads = (uint32_t)strtoul(argv[++i], NULL, 10);
+            restart_threads = true;
+        } else if (strcmp(argv[i], "--pin-threads") == 0) {
+            // Bind each worker thread to its own processor
+            pin_threads = true;
+            restart_threads = true;
+        } else if (strcmp(argv[i], "--snapshots") == 0 && i + 1 < argc) {
+            // Directory to write a binary snapshot of the grid to after every step
+            snapshot_dir = argv[++i];
+        } else if (strcmp(argv[i], "--snapshot-format") == 0 && i + 1 < argc) {
+            // File format of the snapshots, binary or the CSV format of output_grid_to_csv
+            ++i;
+            if (strcmp(argv[i], "binary") == 0) {
+                snapshot_format = SNAPSHOT_BINARY;
+            } else if (strcmp(argv[i], "csv") == 0) {
+                snapshot_format = SNAPSHOT_CSV;
+            } else {
+                fprintf(stderr, "Unknown snapshot format: %s\n", argv[i]);
+                free(creatures);
+                free_grid(grid);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--snapshot-queue") == 0 && i + 1 < argc) {
+            // Snapshots waiting to be written before the policy below applies
+            snapshot_queue = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--snapshot-policy") == 0 && i + 1 < argc) {
+            // What to do when the disk falls behind: wait for it, or drop or thin out snapshots,
+            // or write every snapshot on the simulation thread
+            ++i;
+            if (strcmp(argv[i], "inline") == 0) {
+                snapshot_policy = WRITER_INLINE;
+            } else if (strcmp(argv[i], "block") == 0) {
+                snapshot_policy = WRITER_BLOCK;
+            } else if (strcmp(argv[i], "drop") == 0) {
+                snapshot_policy = WRITER_DROP;
+            } else if (strcmp(argv[i], "decimate") == 0) {
+                snapshot_policy = WRITER_DECIMATE;
+            } else {
+                fprintf(stderr, "Unknown snapshot policy: %s\n", argv[i]);
+                free(creatures);
+                free_grid(grid);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            // File to record every step of the run to
+            replay_file = argv[++i];
+        } else if (strcmp(argv[i], "--keyframe-interval") == 0 && i + 1 < argc) {
+            // Steps between replay keyframes within a generation, 0 for one per generation
+            keyframe_interval = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+            // File to save the whole run to, to resume it later with --restore
+            checkpoint_file = argv[++i];
+        } else if (strcmp(argv[i], "--checkpoint-interval") == 0 && i + 1 < argc) {
+            // Steps between checkpoints, 0 to only save when the run stops
+            checkpoint_interval = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--genome-archive") == 0 && i + 1 < argc) {
+            // File to append the genome of every creature of every generation to
+            archive_file = argv[++i];
+        } else if (strcmp(argv[i], "--restore") == 0 && i + 1 < argc) {
+            ++i;  // Restored before the options were read
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            free(creatures);
+            free_grid(grid);
+            return 1;
+        }
+    }
+
+    if (restart_threads && set_grid_threads(grid, num_threads, pin_threads) != 0) {
+        fprintf(stderr, "Thread pool initialization failed.\n");
+        free(creatures);
         free_grid(grid);
         return 1;
     }
 
-    printf("Initializing genomes...\n");
-    // Spawn creatures on the grid
-    spawn_creatures(grid, creatures);
-    printf("Gen %d is begining.\n", 0);
+    if (!restore_file) {
+        printf("Initializing creatures...\n");
+        // Initialize creatures
+        creatures = malloc(max_creatures * sizeof(Creature));
+        if (!creatures) {
+            fprintf(stderr, "Creature array initialization failed.\n");
+            free_grid(grid);
+            return 1;
+        }
+    } else if (grid->brain_batch && (grid->brain_batch->precision != grid->brain_precision ||
+                                     grid->brain_batch->accuracy != grid->activation_accuracy)) {
+        // The options changed how the restored brains are evaluated
+        pack_brains(grid, creatures);
+    }
 
-    int gen = 0;
-    // Run the simulation for max_steps
-    for (uint32_t step = 0; step < max_steps; ++step) {
-        update_grid(grid, creatures);
-        if ( step != 0 && (step)% 300 == 0) {
-            printf("Gen %d:\n", gen);
-            if (grid->num_creatures_alive_last_gen > 0) {
-                printf("Survival Rate: %0.2f%%\n", ((float)grid->num_creatures_alive_last_gen / max_creatures) * 100);
-                // Pick a random creature, show its genome
-                int creature_index = rand() % grid->num_creatures_alive_last_gen;
-                if (creatures[creature_index].brain) {
-                    FILE *neuron_file = fopen("neurons.csv", "w");
-                    fprintf(neuron_file, "Index,Type,ID,Label\n");
+    // Snapshots and networks are written on a thread of their own; without
+    // --snapshots the ring only carries networks and needs no snapshot buffers
+    SnapshotWriter* writer = create_snapshot_writer(snapshot_dir ? grid : NULL, snapshot_queue, snapshot_policy);
+    if (!writer) {
+        fprintf(stderr, "Snapshot writer initialization failed.\n");
+        free(creatures);
+        free_grid(grid);
+        return 1;
+    }
 
-                    for (int i = 0; i < creatures[creature_index].brain->total_neurons; ++i) {
-                        Neuron* neuron = &creatures[creature_index].brain->neurons[i];
-                        fprintf(neuron_file, "%d,%s,%u,%s\n", i, neuron_type_to_string(neuron->type), neuron->id, neuron_id_to_string(neuron->id));
-                    }
+    if (archive_file) {
+        // Genomes are bred straight into the archive from here on
+        grid->genome_archive = open_genome_archive(archive_file);
+        if (!grid->genome_archive) {
+            fprintf(stderr, "Could not open genome archive %s.\n", archive_file);
+            close_snapshot_writer(writer);
+            free(creatures);
+            free_grid(grid);
+            return 1;
+        }
+    }
 
-                    fclose(neuron_file);
+    if (!restore_file) {
+        printf("Initializing genomes...\n");
+        // Spawn creatures on the grid
+        spawn_creatures(grid, creatures);
+    }
+    printf("Gen %u is begining.\n", grid->generation);
 
-                    FILE *connection_file = fopen("connections.csv", "w");
-                    fprintf(connection_file, "SourceID,TargetID,Weight,ActivationFunction\n");
+    if (checkpoint_file) {
+        // Save before stopping when the run is interrupted or preempted
+        signal(SIGINT, request_stop);
+        signal(SIGTERM, request_stop);
+    }
 
-                    for (int i = 0; i < creatures[creature_index].brain->total_neurons; ++i) {
-                        Neuron* neuron = &creatures[creature_index].brain->neurons[i];
-                        for (int j = 0; j < neuron->num_connections; ++j) {
-                            fprintf(connection_file, "%u,%u,%f,%s\n", neuron->id, neuron->connections[j].id, neuron->connections[j].weight, activation_function_to_string(neuron->connections[j].activation_function));
-                        }
-                    }
+    ReplayRecorder* recorder = NULL;
+    if (replay_file) {
+        recorder = create_replay_recorder(grid, replay_file, keyframe_interval);
+        if (!recorder || record_replay_step(recorder, grid, creatures) != 0) {
+            fprintf(stderr, "Could not record replay %s.\n", replay_file);
+            close_replay_recorder(recorder);
+            recorder = NULL;
+        }
+    }
 
-                    fclose(connection_file);
+    // Run the simulation for max_steps; a restored run counts the steps taken before it was saved
+    while (grid->steps_taken < max_steps && !stop_requested) {
+        uint32_t generation = grid->generation;
+        update_grid(grid, creatures);
+        if (snapshot_dir) {
+            char path[4096];
+            snprintf(path, sizeof(path), "%s/gen%06u_step%06u.%s", snapshot_dir, grid->generation, (uint32_t)grid->num_generations,
+                     snapshot_format == SNAPSHOT_CSV ? "csv" : "snap");
+            if (queue_snapshot(writer, grid, creatures, path, snapshot_format) != 0) {
+                fprintf(stderr, "Could not write snapshots to %s.\n", snapshot_dir);
+                snapshot_dir = NULL;
+            }
+        }
+        if (recorder && record_replay_step(recorder, grid, creatures) != 0) {
+            fprintf(stderr, "Could not record replay %s.\n", replay_file);
+            close_replay_recorder(recorder);
+            recorder = NULL;
+        }
+        // Report on every generation as it ends
+        if (grid->generation != generation) {
+            printf("Gen %u:\n", generation);
+            if (grid->num_creatures_alive_last_gen > 0) {
+                printf("Survival Rate: %0.2f%%\n", ((float)grid->num_creatures_alive_last_gen / max_creatures) * 100);
+                // Pick a random creature, show its genome
+                RngStream rng = rng_stream(grid->seed, RNG_REPORT, grid->generation, 0, 0);
+                int creature_index = rng_below(&rng, grid->num_creatures_alive_last_gen);
+                if (creatures[creature_index].brain &&
+                    queue_network(writer, creatures[creature_index].brain, "neurons.csv", "connections.csv") != 0) {
+                    fprintf(stderr, "Could not write neurons.csv and connections.csv.\n");
                 }
             } else {
                 printf("Survival Rate: 0.00%%\n");
             }
-            gen++;
+        }
+        if (checkpoint_file && checkpoint_interval && grid->steps_taken % checkpoint_interval == 0 &&
+            save_checkpoint(grid, creatures, checkpoint_file) != 0) {
+            fprintf(stderr, "Could not save checkpoint %s.\n", checkpoint_file);
+        }
+    }
+    if (checkpoint_file) {
+        if (stop_requested) {
+            printf("Stopping at generation %u, step %u.\n", grid->generation, (uint32_t)grid->num_generations);
+        }
+        if (save_checkpoint(grid, creatures, checkpoint_file) != 0) {
+            fprintf(stderr, "Could not save checkpoint %s.\n", checkpoint_file);
         }
     }
 
     // Clean up
+    if (recorder && close_replay_recorder(recorder) != 0) {
+        fprintf(stderr, "Could not record replay %s.\n", replay_file);
+    }
+    if (close_snapshot_writer(writer) != 0) {
+        fprintf(stderr, "Could not write every snapshot and network.\n");
+    }
     for (int i = 0; i < max_creatures; ++i) {
-        free(creatures[i].genome);
-        // If you dynamically allocate the neural network or other fields, free them here
+        release_brain(grid->brain_cache, creatures[i].brain);
     }
     free(creatures);
+    if (grid->genome_archive && grid->genome_archive->failed) {
+        fprintf(stderr, "Could not archive every generation to %s.\n", archive_file);
+    }
+    close_genome_archive(grid->genome_archive);
     free_grid(grid);
 
     return 0;
@@ -3,48 +3,75 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
 #include <stdbool.h>
 #include <math.h>
-
-// Initialize a neural network from a genome
-NeuralNetwork* initialize_neural_network(Gene* genome, int genome_length) {
-    NeuralNetwork* network = malloc(sizeof(NeuralNetwork));
-    if (!network) {
-        return NULL;  // Allocation failed
-    }
-
-    network->num_sensory_neurons = 0;
-    network->num_output_neurons = 0;
-    network->sensory_ids = malloc(genome_length * sizeof(uint16_t));  // Max possible size
-    network->output_ids = malloc(genome_length * sizeof(uint16_t));  // Max possible size
-
-    if (!network->sensory_ids || !network->output_ids) {
-        free(network);
-        return NULL;  // Allocation failed
+#include <float.h>
+
+// Depth-first search that appends neurons to `postorder` once all of their successors are placed
+static void order_neurons(int index, const uint32_t* successors, int neuron_count, uint32_t* visited, int* postorder, int* count) {
+    *visited |= 1u << index;
+    for (int next = 0; next < neuron_count; ++next) {
+        if ((successors[index] >> next & 1u) && !(*visited >> next & 1u)) {
+            order_neurons(next, successors, neuron_count, visited, postorder, count);
+        }
     }
+    postorder[(*count)++] = index;
+}
 
-    // Dynamic array to keep track of unique neuron IDs
-    uint16_t* unique_neurons = malloc(genome_length * 2 * sizeof(uint16_t));
-    if (!unique_neurons) {
-        free(network->sensory_ids);
-        free(network->output_ids);
-        free(network);
-        return NULL;  // Allocation failed
+// Hash a genome, mixing every gene with the SplitMix64 finalizer
+uint64_t hash_genome(const Gene* genome, int genome_length) {
+    uint64_t hash = (uint64_t)genome_length;
+    for (int i = 0; i < genome_length; ++i) {
+        uint64_t z = hash ^ genome[i].gene;
+        z += 0x9E3779B97F4A7C15ULL;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        hash = z ^ (z >> 31);
     }
+    return hash;
+}
 
-    int unique_count = 0;
-    Neuron* neurons = malloc(genome_length * 2 * sizeof(Neuron));
-    if (!neurons) {
-        free(unique_neurons);
-        free(network->sensory_ids);
-        free(network->output_ids);
-        free(network);
-        return NULL;  // Allocation failed
+// Whether initialize_neural_network would build a brain from a genome: some
+// neuron must first appear as a sensory source and some as an output target.
+// Cheap enough to reject a genome before compiling it.
+bool is_viable_genome(const Gene* genome, int genome_length) {
+    uint32_t seen = 0;  // Bitmask of neuron IDs seen so far
+    bool has_sensory = false;
+    bool has_output = false;
+    for (int i = 0; i < genome_length; ++i) {
+        uint16_t source_id = get_source_neuron_id(&genome[i]);
+        uint16_t dest_id = get_destination_neuron_id(&genome[i]);
+        if (source_id == 0xFFFF || dest_id == 0xFFFF) {
+            continue;
+        }
+        if (!(seen >> source_id & 1u)) {
+            seen |= 1u << source_id;
+            has_sensory |= get_input_type(&genome[i]) == SENSORY;
+        }
+        if (!(seen >> dest_id & 1u)) {
+            seen |= 1u << dest_id;
+            has_output |= get_output_type(&genome[i]) == OUTPUT;
+        }
     }
+    return has_sensory && has_output;
+}
 
+// Initialize a neural network from a genome. Neurons and connections that cannot
+// influence any output are dropped, so unused sensors are never read and dead
+// internal chains are never evaluated.
+NeuralNetwork* initialize_neural_network(Gene* genome, int genome_length) {
+    // Order of first appearance of every neuron ID seen so far, -1 if the ID is unused
+    int16_t index_of[TOTAL_NEURONS];
+    memset(index_of, -1, sizeof(index_of));
+    uint16_t neuron_ids[TOTAL_NEURONS];
+    uint32_t successors[TOTAL_NEURONS] = {0};  // Bitmask of targets, by order of appearance
     int neuron_count = 0;
+    int sensory_count = 0;
+    int output_count = 0;
+    uint32_t live = 0;  // Bitmask of neurons that can reach an output, by order of appearance
 
-    // Iterate through each gene in the genome
+    // First pass: number neurons in order of appearance
     for (int i = 0; i < genome_length; ++i) {
         uint16_t source_id = get_source_neuron_id(&genome[i]);
         uint16_t dest_id = get_destination_neuron_id(&genome[i]);
@@ -54,100 +81,265 @@ NeuralNetwork* initialize_neural_network(Gene* genome, int genome_length) {
             continue;
         }
 
-        int is_source_new = is_unique_id(unique_neurons, &unique_count, source_id);
-        int is_dest_new = is_unique_id(unique_neurons, &unique_count, dest_id);
-        if (is_source_new) {
-            initialize_neuron(&neurons[neuron_count], get_input_type(&genome[i]));
+        if (index_of[source_id] < 0) {
+            index_of[source_id] = neuron_count;
+            neuron_ids[neuron_count++] = source_id;
             if (get_input_type(&genome[i]) == SENSORY) {
-                network->sensory_ids[network->num_sensory_neurons] = source_id;
-                network->num_sensory_neurons++;
+                sensory_count++;
             }
-            neurons[neuron_count].id = source_id;  // Setting the ID
-            neuron_count++;
         }
-        if (is_dest_new) {
-            initialize_neuron(&neurons[neuron_count], get_output_type(&genome[i]));
+        if (index_of[dest_id] < 0) {
+            index_of[dest_id] = neuron_count;
+            neuron_ids[neuron_count++] = dest_id;
             if (get_output_type(&genome[i]) == OUTPUT) {
-                network->output_ids[network->num_output_neurons] = dest_id;
-                network->num_output_neurons++;
+                output_count++;
+                live |= 1u << index_of[dest_id];
             }
-            neurons[neuron_count].id = dest_id;  // Setting the ID
-            neuron_count++;
         }
+        successors[index_of[source_id]] |= 1u << index_of[dest_id];
     }
 
-    // Set up connections
-    build_connections(neurons, genome, genome_length, neuron_count);
+    // A brain that cannot sense or cannot act is not viable
+    if (sensory_count == 0 || output_count == 0) {
+        return NULL;
+    }
 
-    // Cleanup
-    free(unique_neurons);
+    // Walk back from the outputs: a neuron is live if any of its targets is
+    for (uint32_t previous = 0; previous != live;) {
+        previous = live;
+        for (int i = 0; i < neuron_count; ++i) {
+            if (successors[i] & live) {
+                live |= 1u << i;
+            }
+        }
+    }
 
-    // Reallocate neurons and ID arrays to actual sizes
-    neurons = realloc(neurons, neuron_count * sizeof(Neuron));
-    network->sensory_ids = realloc(network->sensory_ids, network->num_sensory_neurons * sizeof(uint16_t));
-    network->output_ids = realloc(network->output_ids, network->num_output_neurons * sizeof(uint16_t));
+    // Dense indices follow a topological order (reverse DFS postorder), so every
+    // connection to a higher index is feed-forward and every other one closes a cycle.
+    // The order is taken over the whole genome and then restricted to live neurons,
+    // so pruning never changes which connections close a cycle.
+    uint32_t visited = 0;
+    int postorder[TOTAL_NEURONS];
+    int ordered = 0;
+    for (int i = 0; i < neuron_count; ++i) {
+        if (!(visited >> i & 1u)) {
+            order_neurons(i, successors, neuron_count, &visited, postorder, &ordered);
+        }
+    }
+    int dense_index[TOTAL_NEURONS];
+    int live_count = 0;
+    for (int i = neuron_count - 1; i >= 0; --i) {
+        dense_index[postorder[i]] = (live >> postorder[i] & 1u) ? live_count++ : -1;
+    }
 
-    if (!neurons || !network->sensory_ids || !network->output_ids) {
-        // Handle realloc failure
-        return NULL;
+    // Count what survives pruning; a connection is live if its target is
+    int out_degree[TOTAL_NEURONS] = {0};
+    int connection_count = 0;
+    int live_sensory_count = 0;
+    for (int i = 0; i < genome_length; ++i) {
+        uint16_t source_id = get_source_neuron_id(&genome[i]);
+        uint16_t dest_id = get_destination_neuron_id(&genome[i]);
+        if (source_id != 0xFFFF && dest_id != 0xFFFF && dense_index[index_of[dest_id]] >= 0) {
+            out_degree[index_of[source_id]]++;
+            connection_count++;
+        }
+    }
+    for (int i = 0; i < neuron_count; ++i) {
+        if (dense_index[i] >= 0 && neuron_ids[i] < NUM_SENSORY_NEURONS) {
+            live_sensory_count++;
+        }
     }
 
-    network->neurons = neurons;
-    network->total_neurons = neuron_count;
+    // Carve the network, neurons, connections and slot arrays out of one block
+    size_t size = sizeof(NeuralNetwork)
+                + live_count * sizeof(Neuron)
+                + connection_count * sizeof(Connection)
+                + 2 * (live_sensory_count + output_count) * sizeof(uint16_t);
+    NeuralNetwork* network = malloc(size);
+    if (!network) {
+        return NULL;  // Allocation failed
+    }
+    network->neurons = (Neuron*)(network + 1);
+    network->connections = (Connection*)(network->neurons + live_count);
+    network->sensory_ids = (uint16_t*)(network->connections + connection_count);
+    network->sensory_indices = network->sensory_ids + live_sensory_count;
+    network->output_ids = network->sensory_indices + live_sensory_count;
+    network->output_indices = network->output_ids + output_count;
+    network->total_neurons = live_count;
+    network->num_connections = connection_count;
+    network->num_sensory_neurons = 0;
+    network->num_output_neurons = 0;
+    network->genome_hash = hash_genome(genome, genome_length);
+    network->ref_count = 1;
 
-    return network;
-}
+    // Sensory and output slots keep their order of appearance
+    for (int i = 0; i < neuron_count; ++i) {
+        if (dense_index[i] < 0) {
+            continue;
+        }
+        Neuron* neuron = &network->neurons[dense_index[i]];
+        uint16_t id = neuron_ids[i];
+        if (id < NUM_SENSORY_NEURONS) {
+            initialize_neuron(neuron, SENSORY);
+            network->sensory_ids[network->num_sensory_neurons] = id;
+            network->sensory_indices[network->num_sensory_neurons++] = dense_index[i];
+        } else if (id < NUM_SENSORY_NEURONS + NUM_INTERNAL_NEURONS) {
+            initialize_neuron(neuron, INTERNAL);
+        } else {
+            initialize_neuron(neuron, OUTPUT);
+            network->output_ids[network->num_output_neurons] = id;
+            network->output_indices[network->num_output_neurons++] = dense_index[i];
+        }
+        neuron->id = id;
+    }
 
+    // Each neuron owns a contiguous slice of the connection array, in dense order
+    int offset = 0;
+    for (int i = 0; i < live_count; ++i) {
+        Neuron* neuron = &network->neurons[i];
+        neuron->connections = &network->connections[offset];
+        offset += out_degree[index_of[neuron->id]];
+    }
 
-// Build connections between neurons
-void build_connections(Neuron* neural_network, Gene* genome, int genome_length, int neuron_count) {
-    // Iterate through each gene in the genome
+    // Second pass: fill in the live connections, keeping genome order per source
+    bool has_cycle = false;
     for (int i = 0; i < genome_length; ++i) {
         uint16_t source_id = get_source_neuron_id(&genome[i]);
-        uint16_t dest_id = get_destination_neuron_id(&genome[i]);\
+        uint16_t dest_id = get_destination_neuron_id(&genome[i]);
 
-        if (source_id == 0xFFFF || dest_id == 0xFFFF) {
-            // Handle error or reserved types
+        if (source_id == 0xFFFF || dest_id == 0xFFFF || dense_index[index_of[dest_id]] < 0) {
             continue;
         }
 
-        // Find the source and destination neurons
-        Neuron* source_neuron = find_neuron_by_id(neural_network, neuron_count, source_id);
+        Neuron* source = &network->neurons[dense_index[index_of[source_id]]];
+        Connection* connection = &source->connections[source->num_connections++];
+        connection->source = dense_index[index_of[source_id]];
+        connection->target = dense_index[index_of[dest_id]];
+        connection->id = dest_id;
+        connection->weight = get_weight(&genome[i]);
+        connection->activation_function = get_activation_function(&genome[i]);
+        if (connection->target <= connection->source) {
+            has_cycle = true;
+        }
+    }
 
-        
+    // Without sensors or cycles the outputs are the same every step, so the
+    // action can be chosen once here instead of every step
+    network->constant_action = -1;
+    if (network->num_sensory_neurons == 0 && !has_cycle) {
+        float values[TOTAL_NEURONS] = {0};
+        propagate_signal_topological(network, values);
+        network->constant_action = choose_action(network, values);
+    }
 
-        if (source_neuron) {  // Check if the pointers are valid
-            source_neuron->num_connections++;
-            Connection* new_connections = realloc(source_neuron->connections, source_neuron->num_connections * sizeof(Connection));
-            if (new_connections) {
-                source_neuron->connections = new_connections;
-                source_neuron->connections[source_neuron->num_connections - 1].id = dest_id;
-                source_neuron->connections[source_neuron->num_connections - 1].weight = get_weight(&genome[i]);
-                source_neuron->connections[source_neuron->num_connections - 1].activation_function = get_activation_function(&genome[i]);
-            } else {
-                // Handle realloc failure, for example:
-                source_neuron->num_connections--;  // Rollback the increment
-            }
-        }
+    return network;
+}
+
+// Size of the single block a network lives in
+static size_t network_size(const NeuralNetwork* network) {
+    return sizeof(NeuralNetwork)
+         + network->total_neurons * sizeof(Neuron)
+         + network->num_connections * sizeof(Connection)
+         + 2 * (network->num_sensory_neurons + network->num_output_neurons) * sizeof(uint16_t);
+}
+
+// Point the internal pointers of a copied block at the copy
+static void rebase_network(NeuralNetwork* copy, const NeuralNetwork* original) {
+    ptrdiff_t shift = (const char*)copy - (const char*)original;
+    copy->neurons = (Neuron*)((char*)copy->neurons + shift);
+    copy->connections = (Connection*)((char*)copy->connections + shift);
+    copy->sensory_ids = (uint16_t*)((char*)copy->sensory_ids + shift);
+    copy->sensory_indices = (uint16_t*)((char*)copy->sensory_indices + shift);
+    copy->output_ids = (uint16_t*)((char*)copy->output_ids + shift);
+    copy->output_indices = (uint16_t*)((char*)copy->output_indices + shift);
+    for (int i = 0; i < copy->total_neurons; ++i) {
+        copy->neurons[i].connections = (Connection*)((char*)copy->neurons[i].connections + shift);
+    }
+}
+
+// Copy a network into a block of its own, not shared with any creature
+NeuralNetwork* copy_neural_network(const NeuralNetwork* network) {
+    NeuralNetwork* copy = malloc(network_size(network));
+    if (!copy) {
+        return NULL;  // Allocation failed
     }
+    memcpy(copy, network, network_size(network));
+    rebase_network(copy, network);
+    copy->ref_count = 1;
+    return copy;
 }
 
-// Helper function to check if an ID is unique
-int is_unique_id(uint16_t* unique_neurons, int* unique_count, uint16_t id) {
-    for (int i = 0; i < *unique_count; ++i) {
-        if (unique_neurons[i] == id) {
-            return 0;
+// Compile a genome that differs from the genome of an already compiled network
+// only at the listed genes. If none of the changed genes connects different
+// neurons, the network's shape is the same, so the base is copied and only the
+// weights and activation functions of the changed connections are patched;
+// otherwise the genome is compiled from scratch.
+NeuralNetwork* derive_neural_network(const NeuralNetwork* base, const Gene* base_genome, Gene* genome, int genome_length,
+                                     const int* changed_genes, int num_changed) {
+    int last_changed = -1;
+    for (int c = 0; c < num_changed; ++c) {
+        const Gene* before = &base_genome[changed_genes[c]];
+        const Gene* after = &genome[changed_genes[c]];
+        if (get_source_neuron_id(before) != get_source_neuron_id(after) ||
+            get_destination_neuron_id(before) != get_destination_neuron_id(after) ||
+            get_input_type(before) != get_input_type(after) || get_output_type(before) != get_output_type(after)) {
+            return initialize_neural_network(genome, genome_length);
         }
+        if (changed_genes[c] > last_changed) {
+            last_changed = changed_genes[c];
+        }
+    }
+
+    NeuralNetwork* network = copy_neural_network(base);
+    if (!network) {
+        return NULL;  // Allocation failed
+    }
+    network->genome_hash = hash_genome(genome, genome_length);
+
+    // Live genes map to connections in genome order per source, so walk the
+    // genome up to the last change counting the connections of each source
+    int16_t dense_of[TOTAL_NEURONS];
+    memset(dense_of, -1, sizeof(dense_of));
+    for (int i = 0; i < network->total_neurons; ++i) {
+        dense_of[network->neurons[i].id] = i;
     }
-    unique_neurons[*unique_count] = id;
-    (*unique_count)++;
-    return 1;
+    int next_change = 0;
+    int seen[TOTAL_NEURONS] = {0};
+    bool weights_changed = false;
+    for (int i = 0; i <= last_changed; ++i) {
+        uint16_t source_id = get_source_neuron_id(&genome[i]);
+        uint16_t dest_id = get_destination_neuron_id(&genome[i]);
+        if (source_id == 0xFFFF || dest_id == 0xFFFF || dense_of[dest_id] < 0) {
+            continue;  // Not a connection of the compiled network
+        }
+        Connection* connection = &network->neurons[dense_of[source_id]].connections[seen[dense_of[source_id]]++];
+        while (next_change < num_changed && changed_genes[next_change] < i) {
+            next_change++;
+        }
+        if (next_change < num_changed && changed_genes[next_change] == i) {
+            connection->weight = get_weight(&genome[i]);
+            connection->activation_function = get_activation_function(&genome[i]);
+            weights_changed = true;
+        }
+    }
+
+    // A folded action depends on the weights, so fold it again
+    if (weights_changed && base->constant_action >= 0) {
+        float values[TOTAL_NEURONS] = {0};
+        propagate_signal_topological(network, values);
+        network->constant_action = choose_action(network, values);
+    }
+    return network;
+}
+
+// Release a network created by initialize_neural_network
+void free_neural_network(NeuralNetwork* network) {
+    free(network);
 }
 
 // Helper function to initialize a neuron
 void initialize_neuron(Neuron* neuron, uint8_t type) {
     neuron->type = type;
-    neuron->data = 0;
     neuron->connections = NULL;
     neuron->activation_threshold = 0;
     neuron->num_connections = 0;
@@ -190,52 +382,103 @@ float apply_activation_function(float x, uint8_t activation_function) {
     }
 }
 
-// Updated recursive function to propagate signal from a given neuron
-void propagate_signal_from_neuron(NeuronID id, NeuralNetwork* net, bool* visited) {
-    // Find the neuron
-    Neuron* neuron = find_neuron_by_id(net->neurons, net->total_neurons, id);
-    if (!neuron) {
-        return;
-    }
-    int neuron_index = (int)(neuron - net->neurons);
+// Updated recursive function to propagate signal from the neuron at a given dense index
+void propagate_signal_from_neuron(int index, const NeuralNetwork* net, float* values, bool* visited) {
+    const Neuron* neuron = &net->neurons[index];
     // Base case: if the neuron has no outgoing connections or is already visited, return
-    if (neuron->num_connections == 0 || visited[neuron_index]) {
+    if (neuron->num_connections == 0 || visited[index]) {
         return;
     }
 
     // Mark the current neuron as visited
-    visited[neuron_index] = true;
+    visited[index] = true;
 
     // Propagate signal through all connections
     for (int i = 0; i < neuron->num_connections; ++i) {
+        const Connection* connection = &neuron->connections[i];
         // Use activation function
-        float activated_output = apply_activation_function(neuron->data, neuron->connections[i].activation_function);
-
-        // Update the connected neuron's data
-        Neuron* target = find_neuron_by_id(net->neurons, net->total_neurons, neuron->connections[i].id);
-        if (target) {
-            target->data += neuron->connections[i].weight * activated_output;
-            // Recursively propagate signal from the connected neuron
-            propagate_signal_from_neuron(neuron->connections[i].id, net, visited);
-        }
+        float activated_output = apply_activation_function(values[index], connection->activation_function);
+
+        // Update the connected neuron's value
+        values[connection->target] += connection->weight * activated_output;
+        // Recursively propagate signal from the connected neuron
+        propagate_signal_from_neuron(connection->target, net, values, visited);
     }
 
     // Unmark the current neuron as visited for future calls
-    visited[neuron_index] = false;
+    visited[index] = false;
 
 }
 
-// Main function to initiate signal propagation from sensory neurons
-void propagate_signal(NeuralNetwork* network) {
+// Recursive evaluation: propagate signal along every path from each sensory neuron
+void propagate_signal_recursive(const NeuralNetwork* network, float* values) {
     // Create a visited array
     bool visited[network->total_neurons];
     memset(visited, 0, sizeof(visited));
 
     for (int i = 0; i < network->num_sensory_neurons; ++i) {
-        propagate_signal_from_neuron(network->sensory_ids[i], network, visited);
+        propagate_signal_from_neuron(network->sensory_indices[i], network, values, visited);
     }
 }
 
+// Topological evaluation: one pass over the connections in dense (topological) order.
+// Connections that close a cycle read the value their source had at the end of the
+// previous step, every other neuron is recomputed from scratch.
+void propagate_signal_topological(const NeuralNetwork* network, float* values) {
+    const Neuron* neurons = network->neurons;
+    float recurrent[network->total_neurons];
+    memset(recurrent, 0, sizeof(recurrent));
+
+    for (int i = 0; i < network->num_connections; ++i) {
+        const Connection* connection = &network->connections[i];
+        if (connection->target <= connection->source) {
+            recurrent[connection->target] += connection->weight * apply_activation_function(values[connection->source], connection->activation_function);
+        }
+    }
+    for (int i = 0; i < network->total_neurons; ++i) {
+        if (neurons[i].type != SENSORY) {
+            values[i] = recurrent[i];
+        }
+    }
+    for (int i = 0; i < network->num_connections; ++i) {
+        const Connection* connection = &network->connections[i];
+        if (connection->target > connection->source) {
+            values[connection->target] += connection->weight * apply_activation_function(values[connection->source], connection->activation_function);
+        }
+    }
+}
+
+// Main function to propagate the signal from the sensory neurons. `values` holds
+// the caller's neuron values, one per neuron of the network, by dense index.
+void propagate_signal(const NeuralNetwork* network, float* values, EvaluationMode mode) {
+    if (mode == EVAL_RECURSIVE) {
+        propagate_signal_recursive(network, values);
+    } else {
+        propagate_signal_topological(network, values);
+    }
+}
+
+// Pick the action of a network from its neuron values: the strongest output, if it
+// clears its activation threshold. Returns the action's neuron ID, or 0 for no action.
+uint16_t choose_action(const NeuralNetwork* network, const float* values) {
+    uint16_t action_id = 0;
+    int action_index = -1;
+    float data = -FLT_MAX;
+    // Iterate through each output slot
+    for (int i = 0; i < network->num_output_neurons; ++i) {
+        // Keep track of the highest data value
+        if (data < values[network->output_indices[i]]) {
+            action_id = network->output_ids[i];
+            action_index = network->output_indices[i];
+            data = values[network->output_indices[i]];
+        }
+    }
+    // The action only fires if the data is above the activation threshold
+    if (action_index >= 0 && data > network->neurons[action_index].activation_threshold) {
+        return action_id;
+    }
+    return 0;
+}
 
 // Function to return the string name for ActivationFunctionType enum
 const char* activation_function_to_string(ActivationFunctionType type) {
@@ -302,3 +545,31 @@ const char* neuron_type_to_string(NeuronType type) {
     }
 }
 // ... other utility functions as needed
+
+// Write the neurons and the connections of a network to two CSV files
+int output_network_to_csv(const NeuralNetwork* network, const char* neurons_filename, const char* connections_filename) {
+    FILE *neuron_file = fopen(neurons_filename, "w");
+    if (!neuron_file) {
+        return 1;  // File open failed
+    }
+    fprintf(neuron_file, "Index,Type,ID,Label\n");
+    for (int i = 0; i < network->total_neurons; ++i) {
+        const Neuron* neuron = &network->neurons[i];
+        fprintf(neuron_file, "%d,%s,%u,%s\n", i, neuron_type_to_string(neuron->type), neuron->id, neuron_id_to_string(neuron->id));
+    }
+    int failed = fclose(neuron_file) != 0;
+
+    FILE *connection_file = fopen(connections_filename, "w");
+    if (!connection_file) {
+        return 1;  // File open failed
+    }
+    fprintf(connection_file, "SourceID,TargetID,Weight,ActivationFunction\n");
+    for (int i = 0; i < network->total_neurons; ++i) {
+        const Neuron* neuron = &network->neurons[i];
+        for (int j = 0; j < neuron->num_connections; ++j) {
+            fprintf(connection_file, "%u,%u,%f,%s\n", neuron->id, neuron->connections[j].id, neuron->connections[j].weight, activation_function_to_string(neuron->connections[j].activation_function));
+        }
+    }
+    failed |= fclose(connection_file) != 0;
+    return failed;
+}
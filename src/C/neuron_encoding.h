@@ -43,10 +43,18 @@ typedef enum {
     // Add more as needed
 } ActivationFunctionType;
 
-// Struct to represent a single connection from this neuron to another
+// Enum to select how a brain is evaluated each step
+typedef enum {
+    EVAL_TOPOLOGICAL,   // Single pass in topological order, cycles read the previous step
+    EVAL_RECURSIVE,     // Original semantics: walk every path from every sensory neuron
+} EvaluationMode;
+
+// Struct to represent a single connection from one neuron to another
 typedef struct {
-    NeuronID id;  // Pointer to the target neuron
-    float weight;    // Weight of this connection
+    uint16_t source;  // Dense index of the source neuron
+    uint16_t target;  // Dense index of the target neuron
+    NeuronID id;      // ID of the target neuron
+    float weight;     // Weight of this connection
     ActivationFunctionType activation_function; // Type of activation function to use
 } Connection;
 
@@ -54,31 +62,62 @@ typedef struct {
 typedef struct {
     NeuronType type;                // Type of the neuron (sensory, internal, output, etc.)
     NeuronID id;                    // Unique identifier for the neuron
-    float data;                     // Float holding numeric data for the neuron
     float activation_threshold;     // Threshold for activation (relevant mainly for output neurons)
-    Connection* connections;        // Dynamic array of connections
-    int num_connections;            // Number of connections for memory management
+    Connection* connections;        // Outgoing connections, a slice of the network's connection array
+    int num_connections;            // Number of outgoing connections
 } Neuron;
 
+/*
+ * A compiled brain. Neurons are renumbered to dense indices in topological
+ * order, and every connection lives in one contiguous array grouped by source
+ * neuron (CSR layout), so evaluation never has to look a neuron up by ID. A
+ * connection whose target index is not above its source index closes a cycle.
+ * Sensory and output slots keep the order in which they appear in the genome.
+ * The whole network is a single allocation.
+ *
+ * Neurons and connections that cannot reach an output are pruned when the
+ * network is built. If what remains depends on no sensor and has no cycle, the
+ * outputs are the same every step under EVAL_TOPOLOGICAL, and the resulting
+ * action is stored in constant_action so evaluation can be skipped.
+ *
+ * A compiled network is immutable and can be shared by every creature with the
+ * same genome: the neuron values live with the creature and are passed to
+ * propagate_signal, indexed by dense index.
+ */
 typedef struct NeuralNetwork {
-    Neuron* neurons;              // Array of neurons
+    Neuron* neurons;              // Array of neurons, addressed by dense index
     int total_neurons;            // Total number of neurons
+    Connection* connections;      // All connections, grouped by source neuron
+    int num_connections;          // Total number of connections
     int num_sensory_neurons;      // Number of sensory neurons
     int num_output_neurons;       // Number of output neurons
-    uint16_t* sensory_ids;        // IDs of sensory neurons (if you find it useful)
-    uint16_t* output_ids;         // IDs of output neurons (if you find it useful)
+    uint16_t* sensory_ids;        // IDs of sensory neurons
+    uint16_t* output_ids;         // IDs of output neurons
+    uint16_t* sensory_indices;    // Dense indices of sensory neurons, parallel to sensory_ids
+    uint16_t* output_indices;     // Dense indices of output neurons, parallel to output_ids
+    int16_t constant_action;      // Action taken every step under EVAL_TOPOLOGICAL (0 for none), -1 if it depends on sensors
+    uint64_t genome_hash;         // Hash of the genome the network was compiled from
+    uint32_t ref_count;           // Number of creatures sharing the network, see brain_cache.h
 } NeuralNetwork;
 
-int is_unique_id(uint16_t* unique_neurons, int* unique_count, uint16_t id);
 void initialize_neuron(Neuron* neuron, uint8_t type);
-void build_connections(Neuron* neural_network, Gene* genome, int genome_length, int neuron_count);
 Neuron* find_neuron_by_id(Neuron* neural_network, int neuron_count, uint16_t id);
 float apply_activation_function(float x, uint8_t activation_function);
-void propagate_signal_from_neuron(NeuronID id, NeuralNetwork* net, bool* visited);
+void propagate_signal_from_neuron(int index, const NeuralNetwork* net, float* values, bool* visited);
+uint64_t hash_genome(const Gene* genome, int genome_length);
+bool is_viable_genome(const Gene* genome, int genome_length);
 NeuralNetwork* initialize_neural_network(Gene* genome, int genome_length);
-void propagate_signal(NeuralNetwork* network);
+NeuralNetwork* derive_neural_network(const NeuralNetwork* base, const Gene* base_genome, Gene* genome, int genome_length,
+                                     const int* changed_genes, int num_changed);
+NeuralNetwork* copy_neural_network(const NeuralNetwork* network);
+void free_neural_network(NeuralNetwork* network);
+void propagate_signal_recursive(const NeuralNetwork* network, float* values);
+void propagate_signal_topological(const NeuralNetwork* network, float* values);
+void propagate_signal(const NeuralNetwork* network, float* values, EvaluationMode mode);
+uint16_t choose_action(const NeuralNetwork* network, const float* values);
 const char* activation_function_to_string(ActivationFunctionType type);
 const char* neuron_id_to_string(NeuronID id);
 const char* neuron_type_to_string(NeuronType type);
+int output_network_to_csv(const NeuralNetwork* network, const char* neurons_filename, const char* connections_filename);
 
 #endif // NEURON_ENCODING_H
@@ -0,0 +1,492 @@
+#include "replay.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Words per bitplane, as laid out by initialize_grid
+static uint32_t plane_words(const Grid* grid) {
+    return grid_plane_words(grid->width, grid->height);
+}
+
+// Append one record to the file, remembering a failed write
+static void write_record(ReplayRecorder* recorder, ReplayRecordType type, uint32_t generation, uint32_t step,
+                         const void* payload, size_t size) {
+    ReplayRecordHeader header = {type, generation, step, (uint32_t)size};
+    if (fwrite(&header, sizeof(header), 1, recorder->file) != 1 ||
+        (size > 0 && fwrite(payload, size, 1, recorder->file) != 1)) {
+        recorder->failed = true;
+    }
+    recorder->offset += sizeof(header) + size;
+}
+
+/**
+ * Start recording a replay.
+ *
+ * @param grid Pointer to the grid that will be recorded.
+ * @param filename Name of the replay file, overwritten.
+ * @param keyframe_interval Steps between keyframes within a generation, 0 for one per generation.
+ * @return Pointer to the new recorder, or NULL if allocation failed or the file could not be opened.
+ */
+ReplayRecorder* create_replay_recorder(const Grid* grid, const char* filename, uint32_t keyframe_interval) {
+    ReplayRecorder* recorder = calloc(1, sizeof(ReplayRecorder));
+    if (!recorder) {
+        return NULL;  // Allocation failed
+    }
+    recorder->keyframe_interval = keyframe_interval;
+    recorder->plane_words = plane_words(grid);
+    recorder->max_creatures = grid->max_creatures ? grid->max_creatures : 1;
+    size_t delta_capacity = sizeof(ReplayDelta)
+                          + (size_t)recorder->max_creatures * (sizeof(ReplayMove) + sizeof(uint32_t))
+                          + (size_t)NUM_CELL_FLAGS * recorder->plane_words * sizeof(ReplayFlagChange);
+    size_t keyframe_capacity = snapshot_capacity(grid);
+    recorder->planes = malloc((size_t)NUM_CELL_FLAGS * recorder->plane_words * sizeof(uint64_t));
+    recorder->live = malloc(recorder->max_creatures * sizeof(uint32_t));
+    recorder->slots = malloc(recorder->max_creatures * sizeof(uint32_t));
+    recorder->positions = malloc(recorder->max_creatures * sizeof(Position));
+    recorder->buffer = malloc(delta_capacity > keyframe_capacity ? delta_capacity : keyframe_capacity);
+    recorder->file = fopen(filename, "wb");
+    if (!recorder->planes || !recorder->live || !recorder->slots || !recorder->positions || !recorder->buffer ||
+        !recorder->file) {
+        if (recorder->file) {
+            fclose(recorder->file);
+        }
+        free(recorder->planes);
+        free(recorder->live);
+        free(recorder->slots);
+        free(recorder->positions);
+        free(recorder->buffer);
+        free(recorder);
+        return NULL;  // Allocation failed or file open failed
+    }
+    ReplayFileHeader header = {REPLAY_MAGIC, REPLAY_VERSION, 0};
+    if (fwrite(&header, sizeof(header), 1, recorder->file) != 1) {
+        recorder->failed = true;
+    }
+    recorder->offset = sizeof(header);
+    return recorder;
+}
+
+// Write the whole state as a keyframe and make it what later deltas refer to
+static void record_keyframe(ReplayRecorder* recorder, Grid* grid, const Creature* creatures) {
+    uint32_t step = (uint32_t)grid->num_generations;
+    if (recorder->num_keyframes == recorder->index_capacity) {
+        uint32_t capacity = recorder->index_capacity ? 2 * recorder->index_capacity : 64;
+        ReplayIndexEntry* index = realloc(recorder->index, capacity * sizeof(ReplayIndexEntry));
+        if (!index) {
+            recorder->failed = true;
+            return;  // Allocation failed
+        }
+        recorder->index = index;
+        recorder->index_capacity = capacity;
+    }
+    ReplayIndexEntry entry = {grid->generation, step, recorder->offset};
+    recorder->index[recorder->num_keyframes++] = entry;
+
+    size_t size = encode_snapshot(grid, creatures, recorder->buffer);
+    write_record(recorder, REPLAY_KEYFRAME, grid->generation, step, recorder->buffer, size);
+
+    memcpy(recorder->planes, grid->cell_flags[0], (size_t)NUM_CELL_FLAGS * recorder->plane_words * sizeof(uint64_t));
+    memset(grid->changed_words[0], 0, (size_t)NUM_CELL_FLAGS * (recorder->plane_words / 64 + 1) * sizeof(uint64_t));
+    for (uint32_t k = 0; k < grid->num_creatures; ++k) {
+        uint32_t i = grid->live_creatures[k];
+        recorder->live[k] = i;
+        recorder->slots[i] = k;
+        recorder->positions[i] = creatures[i].position;
+    }
+    recorder->num_live = grid->num_creatures;
+    recorder->has_keyframe = true;
+    recorder->generation = grid->generation;
+    recorder->keyframe_step = step;
+}
+
+// Encode what changed since the last record into the buffer, returns the size of
+// the payload, or 0 if a creature is on the grid that the last keyframe lacks
+static size_t encode_delta(ReplayRecorder* recorder, Grid* grid, const Creature* creatures) {
+    ReplayDelta delta = {0, 0, 0, 0};
+    ReplayMove* moves = (ReplayMove*)(recorder->buffer + sizeof(ReplayDelta));
+    // Slots of the creatures that left are gathered at the back of the buffer
+    // and moved behind the moves once their number is known
+    uint32_t* departed = (uint32_t*)(moves + recorder->max_creatures);
+
+    // Both live lists are in increasing order, and nobody joins within a generation
+    uint32_t previous = 0;
+    for (uint32_t k = 0; k < grid->num_creatures; ++k) {
+        uint32_t i = grid->live_creatures[k];
+        while (previous < recorder->num_live && recorder->live[previous] < i) {
+            departed[delta.num_deaths++] = recorder->slots[recorder->live[previous++]];
+        }
+        if (previous == recorder->num_live || recorder->live[previous] != i) {
+            return 0;
+        }
+        previous++;
+        Position position = creatures[i].position;
+        if (position.x != recorder->positions[i].x || position.y != recorder->positions[i].y) {
+            ReplayMove move = {recorder->slots[i], position.x, position.y};
+            moves[delta.num_moves++] = move;
+            recorder->positions[i] = position;
+        }
+    }
+    while (previous < recorder->num_live) {
+        departed[delta.num_deaths++] = recorder->slots[recorder->live[previous++]];
+    }
+    uint8_t* out = (uint8_t*)(moves + delta.num_moves);
+    memmove(out, departed, delta.num_deaths * sizeof(uint32_t));
+    out += delta.num_deaths * sizeof(uint32_t);
+    memcpy(recorder->live, grid->live_creatures, grid->num_creatures * sizeof(uint32_t));
+    recorder->num_live = grid->num_creatures;
+
+    // Visit only the words of the bitplanes written since the last record, except
+    // the occupied plane, which the moves and deaths rebuild
+    uint32_t words = recorder->plane_words;
+    uint32_t summary_words = words / 64 + 1;
+    for (int f = 0; f < NUM_CELL_FLAGS; ++f) {
+        const uint64_t* plane = grid->cell_flags[f];
+        uint64_t* recorded = recorder->planes + (size_t)f * words;
+        for (uint32_t s = 0; s < summary_words; ++s) {
+            uint64_t written = grid->changed_words[f][s];
+            grid->changed_words[f][s] = 0;
+            while (written && f != CELL_OCCUPIED) {
+                uint32_t w = s * 64 + (uint32_t)__builtin_ctzll(written);
+                written &= written - 1;
+                uint64_t bits = plane[w] ^ recorded[w];
+                if (bits) {
+                    ReplayFlagChange change = {bits, f * words + w, 0};
+                    memcpy(out, &change, sizeof(change));
+                    out += sizeof(change);
+                    delta.num_flag_changes++;
+                    recorded[w] = plane[w];
+                }
+            }
+        }
+    }
+    memcpy(recorder->buffer, &delta, sizeof(delta));
+    return (size_t)(out - recorder->buffer);
+}
+
+/**
+ * Record the current step, as a keyframe at the start of a generation and
+ * every keyframe_interval steps, as a delta otherwise.
+ *
+ * @param recorder Pointer to the recorder.
+ * @param grid Pointer to the grid, whose changed_words are cleared.
+ * @param creatures The creatures of the current generation.
+ * @return 0 on success, non-zero if a write failed.
+ */
+int record_replay_step(ReplayRecorder* recorder, Grid* grid, const Creature* creatures) {
+    uint32_t step = (uint32_t)grid->num_generations;
+    bool keyframe = !recorder->has_keyframe || grid->generation != recorder->generation ||
+                    (recorder->keyframe_interval && step - recorder->keyframe_step >= recorder->keyframe_interval);
+    size_t size = keyframe ? 0 : encode_delta(recorder, grid, creatures);
+    if (size > 0) {
+        write_record(recorder, REPLAY_DELTA, grid->generation, step, recorder->buffer, size);
+    } else {
+        record_keyframe(recorder, grid, creatures);
+    }
+    return recorder->failed;
+}
+
+/**
+ * Write the keyframe index, close the file and deallocate the recorder.
+ *
+ * @param recorder Pointer to the recorder, NULL is ignored.
+ * @return 0 on success, non-zero if a write failed at any point of the recording.
+ */
+int close_replay_recorder(ReplayRecorder* recorder) {
+    if (!recorder) {
+        return 0;
+    }
+    ReplayFooter footer = {recorder->offset, recorder->num_keyframes, REPLAY_MAGIC};
+    write_record(recorder, REPLAY_INDEX, recorder->generation, recorder->keyframe_step, recorder->index,
+                 recorder->num_keyframes * sizeof(ReplayIndexEntry));
+    if (fwrite(&footer, sizeof(footer), 1, recorder->file) != 1) {
+        recorder->failed = true;
+    }
+    if (fclose(recorder->file) != 0) {
+        recorder->failed = true;
+    }
+    int failed = recorder->failed;
+    free(recorder->planes);
+    free(recorder->live);
+    free(recorder->slots);
+    free(recorder->positions);
+    free(recorder->buffer);
+    free(recorder->index);
+    free(recorder);
+    return failed;
+}
+
+// Read the index written when the recording was closed, returns 0 if there is none
+static int read_index(ReplayReader* reader) {
+    ReplayFooter footer;
+    ReplayRecordHeader header;
+    if (fseek(reader->file, -(long)sizeof(footer), SEEK_END) != 0 || fread(&footer, sizeof(footer), 1, reader->file) != 1 ||
+        footer.magic != REPLAY_MAGIC || fseek(reader->file, (long)footer.index_offset, SEEK_SET) != 0 ||
+        fread(&header, sizeof(header), 1, reader->file) != 1 || header.type != REPLAY_INDEX ||
+        header.size != footer.num_keyframes * sizeof(ReplayIndexEntry)) {
+        return 0;
+    }
+    reader->index = malloc(header.size ? header.size : 1);
+    if (!reader->index || (header.size && fread(reader->index, header.size, 1, reader->file) != 1)) {
+        return 0;
+    }
+    reader->num_keyframes = footer.num_keyframes;
+    return 1;
+}
+
+// Index the keyframes of a file whose recording was cut short by walking its records
+static void scan_index(ReplayReader* reader) {
+    free(reader->index);
+    reader->index = NULL;
+    reader->num_keyframes = 0;
+    uint32_t capacity = 0;
+    long offset = sizeof(ReplayFileHeader);
+    ReplayRecordHeader header;
+    while (fseek(reader->file, offset, SEEK_SET) == 0 && fread(&header, sizeof(header), 1, reader->file) == 1 &&
+           header.type != REPLAY_INDEX) {
+        if (header.type == REPLAY_KEYFRAME) {
+            if (reader->num_keyframes == capacity) {
+                capacity = capacity ? 2 * capacity : 64;
+                ReplayIndexEntry* index = realloc(reader->index, capacity * sizeof(ReplayIndexEntry));
+                if (!index) {
+                    return;  // Allocation failed, index what was found
+                }
+                reader->index = index;
+            }
+            ReplayIndexEntry entry = {header.generation, header.step, (uint64_t)offset};
+            reader->index[reader->num_keyframes++] = entry;
+        }
+        offset += sizeof(header) + header.size;
+    }
+}
+
+/**
+ * Open a replay for reading. No frame is decoded until next_replay_frame or
+ * seek_replay is called.
+ *
+ * @param filename Name of the replay file.
+ * @return Pointer to the new reader, or NULL if the file is not a replay or allocation failed.
+ */
+ReplayReader* open_replay(const char* filename) {
+    ReplayReader* reader = calloc(1, sizeof(ReplayReader));
+    if (!reader) {
+        return NULL;  // Allocation failed
+    }
+    reader->file = fopen(filename, "rb");
+    ReplayFileHeader header;
+    if (!reader->file || fread(&header, sizeof(header), 1, reader->file) != 1 ||
+        header.magic != REPLAY_MAGIC || header.version != REPLAY_VERSION) {
+        if (reader->file) {
+            fclose(reader->file);
+        }
+        free(reader);
+        return NULL;  // Not a replay
+    }
+    if (!read_index(reader)) {
+        scan_index(reader);
+    }
+    fseek(reader->file, sizeof(ReplayFileHeader), SEEK_SET);
+    return reader;
+}
+
+// Make room for n bytes in the reader's payload buffer, returns 0 if allocation failed
+static int reserve_buffer(ReplayReader* reader, size_t n) {
+    if (n <= reader->buffer_capacity) {
+        return 1;
+    }
+    uint8_t* buffer = realloc(reader->buffer, n);
+    if (!buffer) {
+        return 0;  // Allocation failed
+    }
+    reader->buffer = buffer;
+    reader->buffer_capacity = n;
+    return 1;
+}
+
+// Take the whole state from a keyframe payload, returns 0 if it is damaged
+static int decode_keyframe(ReplayReader* reader, size_t size) {
+    SnapshotHeader frame;
+    if (size < sizeof(frame)) {
+        return 0;
+    }
+    memcpy(&frame, reader->buffer, sizeof(frame));
+    size_t num_words = (size_t)frame.num_planes * frame.plane_words;
+    if (frame.magic != SNAPSHOT_MAGIC || frame.version != SNAPSHOT_VERSION || frame.num_planes <= CELL_OCCUPIED ||
+        size != sizeof(frame) + num_words * sizeof(uint64_t) + (size_t)frame.num_creatures * sizeof(SnapshotCreature)) {
+        return 0;
+    }
+    if (num_words > reader->plane_capacity) {
+        uint64_t* planes = realloc(reader->planes, num_words * sizeof(uint64_t));
+        if (!planes) {
+            return 0;  // Allocation failed
+        }
+        reader->planes = planes;
+        reader->plane_capacity = num_words;
+    }
+    if (frame.num_creatures > reader->slot_capacity) {
+        SnapshotCreature* creatures = realloc(reader->creatures, frame.num_creatures * sizeof(SnapshotCreature));
+        uint8_t* on_grid = creatures ? realloc(reader->on_grid, frame.num_creatures) : NULL;
+        if (creatures) {
+            reader->creatures = creatures;
+        }
+        if (!on_grid) {
+            return 0;  // Allocation failed
+        }
+        reader->on_grid = on_grid;
+        reader->slot_capacity = frame.num_creatures;
+    }
+    memcpy(reader->planes, reader->buffer + sizeof(frame), num_words * sizeof(uint64_t));
+    memcpy(reader->creatures, reader->buffer + sizeof(frame) + num_words * sizeof(uint64_t),
+           frame.num_creatures * sizeof(SnapshotCreature));
+    memset(reader->on_grid, 1, frame.num_creatures);
+    reader->num_slots = frame.num_creatures;
+    reader->frame = frame;
+    return 1;
+}
+
+// Set or clear the occupied bit of a creature's cell
+static void set_occupied(ReplayReader* reader, const SnapshotCreature* creature, bool value) {
+    uint32_t i = (uint32_t)creature->y * reader->frame.width + creature->x;
+    uint64_t* word = &reader->planes[CELL_OCCUPIED * reader->frame.plane_words + (i >> 6)];
+    uint64_t bit = (uint64_t)1 << (i & 63);
+    *word = value ? *word | bit : *word & ~bit;
+}
+
+// Apply a delta payload to the current frame, returns 0 if it is damaged
+static int apply_delta(ReplayReader* reader, size_t size) {
+    ReplayDelta delta;
+    if (size < sizeof(delta)) {
+        return 0;
+    }
+    memcpy(&delta, reader->buffer, sizeof(delta));
+    if (size != sizeof(delta) + (size_t)delta.num_moves * sizeof(ReplayMove) + (size_t)delta.num_deaths * sizeof(uint32_t)
+              + (size_t)delta.num_flag_changes * sizeof(ReplayFlagChange)) {
+        return 0;
+    }
+    const uint8_t* moves = reader->buffer + sizeof(delta);
+    const uint8_t* deaths = moves + delta.num_moves * sizeof(ReplayMove);
+    const uint8_t* changes = deaths + delta.num_deaths * sizeof(uint32_t);
+
+    // Vacate every cell first, so a creature may move into a cell left in the same step
+    for (uint32_t m = 0; m < delta.num_moves; ++m) {
+        ReplayMove move;
+        memcpy(&move, moves + m * sizeof(move), sizeof(move));
+        if (move.slot >= reader->num_slots || move.x >= reader->frame.width || move.y >= reader->frame.height) {
+            return 0;
+        }
+        set_occupied(reader, &reader->creatures[move.slot], false);
+    }
+    for (uint32_t d = 0; d < delta.num_deaths; ++d) {
+        uint32_t slot;
+        memcpy(&slot, deaths + d * sizeof(slot), sizeof(slot));
+        if (slot >= reader->num_slots) {
+            return 0;
+        }
+        set_occupied(reader, &reader->creatures[slot], false);
+        reader->on_grid[slot] = 0;
+    }
+    for (uint32_t m = 0; m < delta.num_moves; ++m) {
+        ReplayMove move;
+        memcpy(&move, moves + m * sizeof(move), sizeof(move));
+        reader->creatures[move.slot].x = move.x;
+        reader->creatures[move.slot].y = move.y;
+        set_occupied(reader, &reader->creatures[move.slot], true);
+    }
+    for (uint32_t c = 0; c < delta.num_flag_changes; ++c) {
+        ReplayFlagChange change;
+        memcpy(&change, changes + c * sizeof(change), sizeof(change));
+        if (change.word >= (size_t)reader->frame.num_planes * reader->frame.plane_words) {
+            return 0;
+        }
+        reader->planes[change.word] ^= change.bits;
+    }
+
+    // Every creature left on the grid lived through the step
+    reader->frame.num_creatures = 0;
+    for (uint32_t s = 0; s < reader->num_slots; ++s) {
+        if (reader->on_grid[s]) {
+            reader->creatures[s].age++;
+            reader->frame.num_creatures++;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Decode the step recorded after the current one.
+ *
+ * @param reader Pointer to the reader.
+ * @return 0 on success, non-zero at the end of the replay or if the file is damaged.
+ */
+int next_replay_frame(ReplayReader* reader) {
+    ReplayRecordHeader header;
+    if (fread(&header, sizeof(header), 1, reader->file) != 1 || header.type == REPLAY_INDEX) {
+        return 1;  // End of the replay
+    }
+    if (!reserve_buffer(reader, header.size) || (header.size && fread(reader->buffer, header.size, 1, reader->file) != 1)) {
+        return 1;  // Allocation failed or the file was cut short
+    }
+    if (header.type == REPLAY_KEYFRAME) {
+        if (!decode_keyframe(reader, header.size)) {
+            return 1;
+        }
+    } else if (header.type != REPLAY_DELTA || !reader->has_frame || !apply_delta(reader, header.size)) {
+        return 1;
+    }
+    reader->has_frame = true;
+    reader->frame.generation = header.generation;
+    reader->frame.step = header.step;
+    return 0;
+}
+
+/**
+ * Rebuild a recorded step from the keyframe before it and the deltas in between.
+ *
+ * @param reader Pointer to the reader.
+ * @param generation Generation of the step.
+ * @param step Step within the generation.
+ * @return 0 on success, non-zero if the step was not recorded.
+ */
+int seek_replay(ReplayReader* reader, uint32_t generation, uint32_t step) {
+    // Last keyframe at or before the step; keyframes are in recording order
+    uint32_t low = 0;
+    uint32_t high = reader->num_keyframes;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        const ReplayIndexEntry* entry = &reader->index[middle];
+        if (entry->generation < generation || (entry->generation == generation && entry->step <= step)) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (low == 0 || reader->index[low - 1].generation != generation) {
+        return 1;  // The generation was not recorded
+    }
+    reader->has_frame = false;
+    if (fseek(reader->file, (long)reader->index[low - 1].offset, SEEK_SET) != 0) {
+        return 1;
+    }
+    do {
+        if (next_replay_frame(reader) != 0 || reader->frame.generation != generation) {
+            return 1;
+        }
+    } while (reader->frame.step < step);
+    return reader->frame.step != step;
+}
+
+/**
+ * Close a replay and deallocate the reader.
+ *
+ * @param reader Pointer to the reader, NULL is ignored.
+ */
+void close_replay(ReplayReader* reader) {
+    if (!reader) {
+        return;
+    }
+    fclose(reader->file);
+    free(reader->planes);
+    free(reader->creatures);
+    free(reader->on_grid);
+    free(reader->buffer);
+    free(reader->index);
+    free(reader);
+}
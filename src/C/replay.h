@@ -0,0 +1,206 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "grid.h"
+#include "simulation.h"
+#include "snapshot.h"
+
+// First word of every replay file, "ERPL" in a little-endian file
+#define REPLAY_MAGIC 0x4C505245u
+// Version of the layout below, bumped on every incompatible change
+#define REPLAY_VERSION 1
+
+/*
+ * A replay is one append-only file holding every step of a run, in host byte
+ * order like a snapshot. It starts with a ReplayFileHeader, followed by one
+ * record per recorded step, each a ReplayRecordHeader and its payload:
+ *
+ * - REPLAY_KEYFRAME: a whole snapshot (see snapshot.h). One starts every
+ *   generation, and optionally every keyframe_interval steps within one. Its
+ *   creature records are numbered by slot, in order.
+ * - REPLAY_DELTA: what changed since the previous record: a ReplayDelta
+ *   giving the counts, then the ReplayMove of every creature that moved, the
+ *   slot of every creature that left the grid (uint32_t each), and a
+ *   ReplayFlagChange for every word of a bitplane other than CELL_OCCUPIED
+ *   that changed (food eaten or scattered, walls...). The occupied plane
+ *   follows from the moves and deaths. Ages advance by one per step; energy
+ *   is only stored in keyframes.
+ * - REPLAY_INDEX: written when the recorder is closed, the ReplayIndexEntry of
+ *   every keyframe, followed by a ReplayFooter ending the file.
+ *
+ * Any step is rebuilt from the keyframe before it and the deltas in between.
+ * A file whose recording was cut short has no index and is scanned instead.
+ */
+typedef struct {
+    uint32_t magic;      // REPLAY_MAGIC
+    uint16_t version;    // REPLAY_VERSION
+    uint16_t reserved;   // Zero
+} ReplayFileHeader;
+
+// Kinds of replay records
+typedef enum {
+    REPLAY_KEYFRAME = 1,
+    REPLAY_DELTA = 2,
+    REPLAY_INDEX = 3
+} ReplayRecordType;
+
+// Start of every record
+typedef struct {
+    uint32_t type;        // ReplayRecordType
+    uint32_t generation;  // Generation of the step recorded
+    uint32_t step;        // Step recorded, steps taken in the generation
+    uint32_t size;        // Size of the payload in bytes
+} ReplayRecordHeader;
+
+// Start of a delta payload
+typedef struct {
+    uint32_t num_moves;         // Number of ReplayMove entries
+    uint32_t num_deaths;        // Number of slots of creatures that left the grid
+    uint32_t num_flag_changes;  // Number of ReplayFlagChange entries
+    uint32_t reserved;          // Zero
+} ReplayDelta;
+
+// New position of a creature
+typedef struct {
+    uint32_t slot;  // Index of the creature in the last keyframe
+    uint16_t x;
+    uint16_t y;
+} ReplayMove;
+
+// Changed word of a bitplane
+typedef struct {
+    uint64_t bits;      // Bits that flipped
+    uint32_t word;      // Word in the bitplanes, plane * plane_words + word in the plane
+    uint32_t reserved;  // Zero
+} ReplayFlagChange;
+
+// Where a keyframe starts in the file
+typedef struct {
+    uint32_t generation;
+    uint32_t step;
+    uint64_t offset;  // Offset of the keyframe's record header
+} ReplayIndexEntry;
+
+// End of a complete replay file
+typedef struct {
+    uint64_t index_offset;   // Offset of the REPLAY_INDEX record header
+    uint32_t num_keyframes;  // Number of index entries
+    uint32_t magic;          // REPLAY_MAGIC
+} ReplayFooter;
+
+/*
+ * Writes a replay while the simulation runs. It keeps a copy of what it last
+ * recorded and writes only the differences. The grid marks every bitplane word
+ * it writes (see Grid.changed_words), so recording a step costs a pass over the
+ * live creatures and the marked words, not the whole grid. A grid can only be
+ * recorded by one recorder at a time, since recording clears the marks.
+ */
+typedef struct {
+    FILE* file;
+    uint64_t offset;              // Bytes written so far
+    uint32_t keyframe_interval;   // Steps between keyframes within a generation, 0 for one per generation
+    bool has_keyframe;            // Whether a keyframe was written yet
+    uint32_t generation;          // Generation of the last keyframe
+    uint32_t keyframe_step;       // Step of the last keyframe
+    uint32_t plane_words;         // Words per bitplane
+    uint64_t* planes;             // Bitplanes as last recorded
+    uint32_t max_creatures;       // Length of the per-creature arrays
+    uint32_t* live;               // Creatures on the grid as last recorded, in increasing order
+    uint32_t num_live;            // Length of live
+    uint32_t* slots;              // Slot of each creature in the last keyframe
+    Position* positions;          // Position of each creature as last recorded
+    uint8_t* buffer;              // Payload being encoded
+    ReplayIndexEntry* index;      // Every keyframe written
+    uint32_t num_keyframes;
+    uint32_t index_capacity;
+    bool failed;                  // Whether a write failed
+} ReplayRecorder;
+
+/*
+ * Rebuilds the steps of a replay. The current frame is kept in snapshot form:
+ * the creatures are the slots of the last keyframe, of which the ones still
+ * on the grid are marked.
+ */
+typedef struct {
+    FILE* file;
+    SnapshotHeader frame;         // Header of the current frame
+    uint64_t* planes;             // Bitplanes of the current frame
+    SnapshotCreature* creatures;  // Creatures of the last keyframe, by slot
+    uint8_t* on_grid;             // Whether each slot is still on the grid
+    uint32_t num_slots;           // Number of slots
+    uint32_t slot_capacity;
+    size_t plane_capacity;        // Words allocated for planes
+    uint8_t* buffer;              // Payload being decoded
+    size_t buffer_capacity;
+    ReplayIndexEntry* index;      // Every keyframe in the file, in file order
+    uint32_t num_keyframes;
+    bool has_frame;               // Whether a frame was decoded yet
+} ReplayReader;
+
+/**
+ * Start recording a replay.
+ *
+ * @param grid Pointer to the grid that will be recorded.
+ * @param filename Name of the replay file, overwritten.
+ * @param keyframe_interval Steps between keyframes within a generation, 0 for one per generation.
+ * @return Pointer to the new recorder, or NULL if allocation failed or the file could not be opened.
+ */
+ReplayRecorder* create_replay_recorder(const Grid* grid, const char* filename, uint32_t keyframe_interval);
+
+/**
+ * Record the current step, as a keyframe at the start of a generation and
+ * every keyframe_interval steps, as a delta otherwise.
+ *
+ * @param recorder Pointer to the recorder.
+ * @param grid Pointer to the grid, whose changed_words are cleared.
+ * @param creatures The creatures of the current generation.
+ * @return 0 on success, non-zero if a write failed.
+ */
+int record_replay_step(ReplayRecorder* recorder, Grid* grid, const Creature* creatures);
+
+/**
+ * Write the keyframe index, close the file and deallocate the recorder.
+ *
+ * @param recorder Pointer to the recorder, NULL is ignored.
+ * @return 0 on success, non-zero if a write failed at any point of the recording.
+ */
+int close_replay_recorder(ReplayRecorder* recorder);
+
+/**
+ * Open a replay for reading. No frame is decoded until next_replay_frame or
+ * seek_replay is called.
+ *
+ * @param filename Name of the replay file.
+ * @return Pointer to the new reader, or NULL if the file is not a replay or allocation failed.
+ */
+ReplayReader* open_replay(const char* filename);
+
+/**
+ * Decode the step recorded after the current one.
+ *
+ * @param reader Pointer to the reader.
+ * @return 0 on success, non-zero at the end of the replay or if the file is damaged.
+ */
+int next_replay_frame(ReplayReader* reader);
+
+/**
+ * Rebuild a recorded step from the keyframe before it and the deltas in between.
+ *
+ * @param reader Pointer to the reader.
+ * @param generation Generation of the step.
+ * @param step Step within the generation.
+ * @return 0 on success, non-zero if the step was not recorded.
+ */
+int seek_replay(ReplayReader* reader, uint32_t generation, uint32_t step);
+
+/**
+ * Close a replay and deallocate the reader.
+ *
+ * @param reader Pointer to the reader, NULL is ignored.
+ */
+void close_replay(ReplayReader* reader);
+
+#endif // REPLAY_H
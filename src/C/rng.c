@@ -0,0 +1,20 @@
+#include "rng.h"
+
+/**
+ * Start the random stream for one decision of the simulation.
+ *
+ * @param seed Seed of the simulation.
+ * @param purpose What the numbers are drawn for.
+ * @param generation Generation the numbers are drawn in.
+ * @param step Step of the generation, 0 outside of steps.
+ * @param index Creature ID or offspring index, 0 if the decision concerns no single creature.
+ * @return The stream, positioned at its first number.
+ */
+RngStream rng_stream(uint64_t seed, RngPurpose purpose, uint32_t generation, uint32_t step, uint32_t index) {
+    // Absorb one word at a time, like hash_genome
+    uint64_t key = rng_mix(seed + 0x9E3779B97F4A7C15ULL);
+    key = rng_mix(key ^ ((uint64_t)purpose << 32 | generation));
+    key = rng_mix(key ^ ((uint64_t)step << 32 | index));
+    RngStream rng = {key, 0};
+    return rng;
+}
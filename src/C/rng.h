@@ -0,0 +1,65 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+// What a random stream is drawn for, so streams keyed alike never coincide
+typedef enum {
+    RNG_GENOME,      // Genes of a spawned creature, keyed by creature ID
+    RNG_PLACEMENT,   // Cells creatures are placed in at the start of a generation
+    RNG_MATING,      // Parents, crossover and mutation of one offspring, keyed by its index
+    RNG_FOOD,        // Cells food is scattered in
+    RNG_MOVE,        // Direction of a random move, keyed by creature ID and step
+    RNG_REPORT,      // Choices made only for printing progress
+    RNG_MUTATION,    // Mutations of a whole generation of offspring
+} RngPurpose;
+
+/*
+ * A counter-based random stream (SplitMix64). The n-th number of a stream is a
+ * pure function of its key and n, and the key is a hash of the simulation
+ * seed, the purpose of the stream, the generation, the step and a creature or
+ * offspring index. Every random decision therefore depends only on where it
+ * happens in the simulation, never on which thread makes it or in what order,
+ * so runs with the same seed are reproducible for any number of threads.
+ * Streams are small values, created on the stack where they are needed.
+ */
+typedef struct {
+    uint64_t key;      // Hash of everything the stream is keyed by
+    uint64_t counter;  // Numbers drawn so far
+} RngStream;
+
+/**
+ * Start the random stream for one decision of the simulation.
+ *
+ * @param seed Seed of the simulation.
+ * @param purpose What the numbers are drawn for.
+ * @param generation Generation the numbers are drawn in.
+ * @param step Step of the generation, 0 outside of steps.
+ * @param index Creature ID or offspring index, 0 if the decision concerns no single creature.
+ * @return The stream, positioned at its first number.
+ */
+RngStream rng_stream(uint64_t seed, RngPurpose purpose, uint32_t generation, uint32_t step, uint32_t index);
+
+// SplitMix64 finalizer, a bijective 64-bit mix
+static inline uint64_t rng_mix(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Next 64 random bits of a stream
+static inline uint64_t rng_next(RngStream* rng) {
+    return rng_mix(rng->key + ++rng->counter * 0x9E3779B97F4A7C15ULL);
+}
+
+// Random integer in [0, bound), by multiply-shift; the bias is below bound / 2^32
+static inline uint32_t rng_below(RngStream* rng, uint32_t bound) {
+    return (uint32_t)(((rng_next(rng) >> 32) * bound) >> 32);
+}
+
+// Random float in [0, 1)
+static inline float rng_unit(RngStream* rng) {
+    return (float)(rng_next(rng) >> 40) * (1.0f / 16777216.0f);
+}
+
+#endif // RNG_H
@@ -2,8 +2,10 @@
 #include "neuron_encoding.h"
 #include "genetic_operations.h"
 #include "simulation.h"
+#include "brain_batch.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <float.h>
 
 
@@ -24,42 +26,77 @@ void spawn_creatures(Grid* grid, Creature* creatures){
     }
     // Initialize the grid
     grid->num_creatures = num_creatures;
+    // Spawn the genomes straight into the archive, if there is one
+    GenomeArchiveGeneration* archived = NULL;
+    if (grid->genome_archive) {
+        archived = begin_archived_generation(grid->genome_archive, grid->genome_arena, grid->generation, num_creatures, genome_length);
+    }
+    RngStream rng = rng_stream(grid->seed, RNG_PLACEMENT, grid->generation, 0, 0);
+    begin_free_cell_sampling(grid, 1u << CELL_OCCUPIED);
     for (int i = 0; i < num_creatures; ++i) {
-        // Place creature in a random location
-        int x = rand() % grid->width;
-        int y = rand() % grid->height;
-        while (get_cell(grid, x, y)->flags.occupied) {
-            x = rand() % grid->width;
-            y = rand() % grid->height;
-        }
-        get_cell(grid, x, y)->flags.occupied = 1;
-        get_cell(grid, x, y)->creature_id = i + 1;
-        spawn_creature(&creatures[i], genome_length);
+        // Place creature in a random free cell; there is one for each since the count is capped
+        uint16_t x, y;
+        take_free_cell(grid, &rng, &x, &y);
+        place_creature(grid, x, y, i + 1);
+        creatures[i].id = i + 1;
+        spawn_creature(grid, &creatures[i], genome_length);
         creatures[i].position.x = x;
         creatures[i].position.y = y;
         creatures[i].energy = 100;
-        creatures[i].id = i + 1;
+        grid->live_creatures[i] = i;
+    }
+    if (archived) {
+        archived->flags |= ARCHIVE_GENOMES_COMPLETE;
     }
     // scatter initial food across the grid
     scatter_food(grid, grid->max_creatures);
+    pack_brains(grid, creatures);
+}
+
+/**
+ * Pack the brains of the current generation into the grid's brain batch.
+ * If packing fails the grid falls back to evaluating creatures one at a time.
+ *
+ * @param grid The grid holding the batch.
+ * @param creatures The creatures of the current generation.
+ */
+void pack_brains(Grid* grid, Creature* creatures) {
+    free_brain_batch(grid->brain_batch);
+    grid->brain_batch = NULL;
+    NeuralNetwork** brains = malloc(grid->max_creatures * sizeof(NeuralNetwork*));
+    if (!brains) {
+        return;  // Allocation failed
+    }
+    for (uint32_t i = 0; i < grid->max_creatures; ++i) {
+        brains[i] = creatures[i].brain;
+    }
+    grid->brain_batch = build_brain_batch(brains, grid->max_creatures, grid->brain_precision);
+    if (grid->brain_batch) {
+        grid->brain_batch->accuracy = grid->activation_accuracy;
+    }
+    free(brains);
 }
 
-void spawn_creature(Creature* creature, int genome_length) {
+/**
+ * Give a creature a random genome and its compiled brain.
+ *
+ * @param grid The grid whose brain cache compiles the brain.
+ * @param creature The creature to initialize; its ID keys the random stream of its genome.
+ * @param genome_length Number of genes in the genome.
+ */
+void spawn_creature(Grid* grid, Creature* creature, int genome_length) {
     creature->genome_length = genome_length;
-    creature->genome = malloc(genome_length * sizeof(Gene));
+    creature->genome = arena_alloc(grid->genome_arena, genome_length * sizeof(Gene));
     if (!creature->genome) {
         return;  // Allocation failed
     }
-    /*
-     * Generates a random genome for a creature by setting each gene to a 64-bit integer
-     * created by concatenating two 32-bit random integers.
-     */
+    // Generates a random genome for a creature, every gene a full 64-bit random integer
+    RngStream rng = rng_stream(grid->seed, RNG_GENOME, grid->generation, 0, creature->id);
     for (int i = 0; i < genome_length; ++i) {
-        uint32_t random1 = rand();  // Generate a random 32-bit integer
-        uint32_t random2 = rand();  // Generate another random 32-bit integer
-        creature->genome[i].gene = ((uint64_t)random1 << 32) | random2;
+        creature->genome[i].gene = rng_next(&rng);
     }
-    creature->brain = initialize_neural_network(creature->genome, genome_length);
+    creature->brain = acquire_brain(grid->brain_cache, creature->genome, genome_length);
+    memset(creature->neuron_values, 0, sizeof(creature->neuron_values));
     if (!creature->brain) {
         creature->energy = 0;
         return;
@@ -72,116 +109,341 @@ void spawn_creature(Creature* creature, int genome_length) {
 
 /**
  * @brief Updates the given grid by simulating one time step of the creatures' behavior.
+ * Only the creatures in the grid's live list are visited, once each, so a step
+ * costs time in proportion to the population rather than the grid area.
  * 
  * @param grid A pointer to the grid to be updated.
  */
 void update_grid(Grid* grid, Creature* creatures){
+    grid->steps_taken++;
     // If the maximum number of steps has been reached, reset the grid
     if (grid->num_generations >= grid->max_steps) {
         grid->num_generations = 0;
         mate_creatures(grid, creatures);
+    } else if (grid->evaluation_mode == EVAL_TOPOLOGICAL && grid->brain_batch) {
+        grid->num_generations++;
+        update_grid_batched(grid, creatures);
     } else {
         grid->num_generations++;
-        // Iterate through each cell in the grid
-        for (int i = 0; i < grid->width * grid->height; ++i) {
-            // Check if the cell contains a creature
-            if (grid->cells[i].flags.occupied) {
-                // Check if Creature ID is valid
-                if (grid->cells[i].creature_id <= 0) {
-                    grid->cells[i].flags.occupied = 0;
-                    continue;
-                }
-                // Fetch the creature in the cell
-                Creature* creature = &creatures[grid->cells[i].creature_id - 1];
-                // Update the creature's state
-                update_creature(grid, creature);
+        // Step every live creature in index order; the ones that die are dropped from the list
+        uint32_t num_live = grid->num_creatures;
+        uint32_t kept = 0;
+        for (uint32_t k = 0; k < num_live; ++k) {
+            uint32_t index = grid->live_creatures[k];
+            if (update_creature(grid, &creatures[index])) {
+                grid->live_creatures[kept++] = index;
             }
         }
     }
     
 }
 
+// Shared state of the parallel phases of a batched step
+typedef struct {
+    Grid* grid;
+    Creature* creatures;
+} StepContext;
+
+// Fill the sensory slots of every creature in one tile. Only reads the grid.
+static void sense_tile(void* context, uint32_t tile) {
+    StepContext* step = context;
+    Grid* grid = step->grid;
+    BrainBatch* batch = grid->brain_batch;
+    for (uint32_t k = grid->tile_offsets[tile]; k < grid->tile_offsets[tile + 1]; ++k) {
+        uint32_t i = grid->tile_creatures[k];
+        Creature* creature = &step->creatures[i];
+        if (batch->sensor_offsets[i] == batch->sensor_offsets[i + 1]) {
+            continue;
+        }
+        uint16_t neighborhood = sense_neighborhood(grid, creature->position.x, creature->position.y);
+        for (uint32_t s = batch->sensor_offsets[i]; s < batch->sensor_offsets[i + 1]; ++s) {
+            batch->sensor_inputs[s] = get_neighborhood_sensory_data(batch->sensor_ids[s], neighborhood, creature->position.x, creature->position.y, grid);
+        }
+    }
+}
+
+// Evaluate one block of the brain batch
+static void evaluate_block_task(void* context, uint32_t block) {
+    StepContext* step = context;
+    evaluate_brain_block(step->grid->brain_batch, block);
+}
+
+/**
+ * @brief Simulates one time step with every brain evaluated through the grid's brain batch.
+ *
+ * Unlike update_creature, which senses and acts one creature at a time, the
+ * step runs in phases: every creature starts its step (death, food, age), then
+ * all creatures are sensed tile by tile and all brains are evaluated, both in
+ * parallel on the grid's thread pool, writing only their own creature's sensor
+ * inputs and chosen action. The chosen actions are then committed one at a time
+ * in creature order, so a lower creature ID wins any contested cell. Nothing a
+ * thread computes depends on the others, so the result is the same for any
+ * number of threads.
+ *
+ * @param grid A pointer to the grid to be updated.
+ * @param creatures The creatures of the current generation.
+ */
+void update_grid_batched(Grid* grid, Creature* creatures){
+    BrainBatch* batch = grid->brain_batch;
+    memset(batch->active, 0, batch->num_creatures);
+    memset(grid->tile_offsets, 0, (grid->num_tiles + 1) * sizeof(uint32_t));
+    uint32_t tiles_per_row = (grid->width + GRID_TILE_SIZE - 1) / GRID_TILE_SIZE;
+    uint32_t num_live = grid->num_creatures;
+    uint32_t kept = 0;
+    for (uint32_t k = 0; k < num_live; ++k) {
+        uint32_t i = grid->live_creatures[k];
+        Creature* creature = &creatures[i];
+        if (!begin_creature_step(grid, creature)) {
+            continue;
+        }
+        grid->live_creatures[kept++] = i;
+        batch->active[i] = 1;
+        grid->tile_offsets[(creature->position.y / GRID_TILE_SIZE) * tiles_per_row + creature->position.x / GRID_TILE_SIZE + 1]++;
+    }
+
+    // Group the live creatures by tile, keeping creature order within a tile
+    for (uint32_t t = 0; t < grid->num_tiles; ++t) {
+        grid->tile_offsets[t + 1] += grid->tile_offsets[t];
+    }
+    for (uint32_t k = 0; k < kept; ++k) {
+        Creature* creature = &creatures[grid->live_creatures[k]];
+        uint32_t tile = (creature->position.y / GRID_TILE_SIZE) * tiles_per_row + creature->position.x / GRID_TILE_SIZE;
+        grid->tile_creatures[grid->tile_offsets[tile]++] = grid->live_creatures[k];
+    }
+    for (uint32_t t = grid->num_tiles; t > 0; --t) {
+        grid->tile_offsets[t] = grid->tile_offsets[t - 1];
+    }
+    grid->tile_offsets[0] = 0;
+
+    StepContext step = {grid, creatures};
+    parallel_for(grid->thread_pool, grid->num_tiles, sense_tile, &step);
+    parallel_for(grid->thread_pool, batch->num_blocks, evaluate_block_task, &step);
+
+    // Commit the chosen actions in creature order
+    for (uint32_t k = 0; k < kept; ++k) {
+        uint32_t i = grid->live_creatures[k];
+        if (batch->actions[i]) {
+            perform_action(batch->actions[i], grid, &creatures[i]);
+        }
+    }
+}
+
+// Shared state of the parallel breeding of a generation
+typedef struct {
+    const SurvivorIndex* survivors;  // Creatures that can parent
+    const Creature* creatures;
+    int genome_length;
+    const MutationRates* mutation_rates;
+    uint32_t* parents;        // Two parents per offspring, picked before breeding
+    RngStream* streams;       // Stream of each offspring, past its parent picks
+    Gene** genomes;           // Genome of each offspring, allocated before breeding
+} MatingContext;
+
+// Cross one offspring over from its parents. Only reads the parent generation.
+static void cross_offspring(void* context, uint32_t index) {
+    MatingContext* mating = context;
+    const Creature* parent1 = &mating->creatures[mating->parents[2 * index]];
+    const Creature* parent2 = &mating->creatures[mating->parents[2 * index + 1]];
+    two_point_crossover(parent1->genome, parent2->genome, mating->genomes[index], NULL, mating->genome_length, &mating->streams[index]);
+}
+
+// Number of genes in which two genomes differ
+static int count_changed_genes(const Gene* genome, const Gene* other, int genome_length) {
+    int changed = 0;
+    for (int i = 0; i < genome_length; ++i) {
+        changed += memcmp(&genome[i], &other[i], sizeof(Gene)) != 0;
+    }
+    return changed;
+}
+
+// Breed a mutated offspring again, from new parents, until it can sense and act.
+// Leaves the parent whose genome is closer to the offspring's first, so its
+// brain can be patched into the offspring's.
+static void settle_offspring(void* context, uint32_t index) {
+    MatingContext* mating = context;
+    int genome_length = mating->genome_length;
+    RngStream* rng = &mating->streams[index];
+    uint32_t* parents = &mating->parents[2 * index];
+    Gene* offspring_genome = mating->genomes[index];
+    while (!is_viable_genome(offspring_genome, genome_length)) {
+        parents[0] = pick_survivor(mating->survivors, rng);
+        parents[1] = pick_survivor(mating->survivors, rng);
+        two_point_crossover(mating->creatures[parents[0]].genome, mating->creatures[parents[1]].genome,
+                            offspring_genome, NULL, genome_length, rng);
+        mutate(offspring_genome, genome_length, mating->mutation_rates, rng);
+    }
+    const Creature* parent1 = &mating->creatures[parents[0]];
+    const Creature* parent2 = &mating->creatures[parents[1]];
+    if (!parent1->brain || (parent2->brain && count_changed_genes(offspring_genome, parent2->genome, genome_length) <
+                                              count_changed_genes(offspring_genome, parent1->genome, genome_length))) {
+        uint32_t closer = parents[1];
+        parents[1] = parents[0];
+        parents[0] = closer;
+    }
+}
+
 /**
  * @brief Mates the creatures in the given grid.
+ *
+ * Parents are picked serially, then the offspring genomes are bred and their
+ * brains compiled in parallel on the grid's thread pool. Mutation is one
+ * serial pass over all offspring that only visits the bits it flips. Each offspring draws
+ * from its own random stream, so the new generation does not depend on the
+ * number of threads.
  * 
  * @param grid A pointer to the grid containing the creatures to mate.
  */
 void mate_creatures(Grid* grid, Creature* creatures) {
-    // Count the number of creatures that are alive and in the top half of the grid
-    int num_creatures = 0;
-    for (int i = 0; i < grid->max_creatures; ++i) {
+    uint32_t* survivor_ids = malloc(grid->max_creatures * sizeof(uint32_t));
+    float* fitness = malloc(grid->max_creatures * sizeof(float));
+    if (!survivor_ids || !fitness) {
+        // Handle allocation failure
+        free(survivor_ids);
+        free(fitness);
+        return;
+    }
+    // Collect the creatures that are alive and in the top half of the grid, their energy is their fitness
+    uint32_t num_survivors = 0;
+    for (uint32_t i = 0; i < grid->max_creatures; ++i) {
         if (creatures[i].position.y < grid->height / 2 && creatures[i].energy > 0) {
-            num_creatures++;
+            survivor_ids[num_survivors] = i;
+            fitness[num_survivors++] = creatures[i].energy;
+        }
+    }
+    grid->num_creatures_alive_last_gen = num_survivors;
+    // Mark the survivors in the archive before their generation is dropped
+    GenomeArchiveGeneration* archived = archived_generation(grid->genome_archive, grid->genome_arena);
+    if (archived) {
+        GenomeArchiveRecord* records = archived_records(archived);
+        for (uint32_t k = 0; k < num_survivors; ++k) {
+            if (survivor_ids[k] < archived->num_genomes) {
+                records[survivor_ids[k]].survived = 1;
+            }
+        }
+        archived->num_survivors = num_survivors;
+        archived->flags |= ARCHIVE_SURVIVAL_RECORDED;
+    }
+    if (num_survivors == 0) {
+        // Nobody survived: breed from the whole generation rather than die out
+        for (uint32_t i = 0; i < grid->max_creatures; ++i) {
+            survivor_ids[i] = i;
+            fitness[i] = 1;
         }
+        num_survivors = grid->max_creatures;
     }
-    grid->num_creatures_alive_last_gen = num_creatures;
+    SurvivorIndex* survivors = build_survivor_index(survivor_ids, fitness, num_survivors, grid->selection_mode);
+    free(survivor_ids);
+    free(fitness);
     int genome_length = creatures[0].genome_length;  // Assuming all creatures have the same genome length
+    // Everything drawn from here on belongs to the new generation, which only
+    // becomes the grid's once its genomes have been allocated
+    uint32_t generation = grid->generation + 1;
 
     Creature* new_creatures = malloc(grid->max_creatures * sizeof(Creature));
-    if (!new_creatures) {
+    Gene** offspring_genomes = malloc(grid->max_creatures * sizeof(Gene*));
+    NeuralNetwork** offspring_brains = malloc(grid->max_creatures * sizeof(NeuralNetwork*));
+    uint32_t* parents = malloc(2 * grid->max_creatures * sizeof(uint32_t));
+    RngStream* streams = malloc(grid->max_creatures * sizeof(RngStream));
+    Gene** parent_genomes = malloc(grid->max_creatures * sizeof(Gene*));
+    NeuralNetwork** parent_brains = malloc(grid->max_creatures * sizeof(NeuralNetwork*));
+    if (!survivors || !new_creatures || !offspring_genomes || !offspring_brains || !parents || !streams ||
+        !parent_genomes || !parent_brains) {
         // Handle allocation failure
+        free_survivor_index(survivors);
+        free(new_creatures);
+        free(offspring_genomes);
+        free(offspring_brains);
+        free(parents);
+        free(streams);
+        free(parent_genomes);
+        free(parent_brains);
         return;
     }
 
-    int new_creature_count = 0;
-    while (new_creature_count < grid->max_creatures) {
-        Creature* parent1 = NULL;
-        Creature* parent2 = NULL;
-
-        // Find parent1
-        while (!parent1) {
-            int rand_id = rand() % grid->max_creatures;  // Generate random creature id
-            if (creatures[rand_id].position.y < grid->height / 2 && creatures[rand_id].energy > 0) {
-                parent1 = &creatures[rand_id];
-            }
-        }
-
-        // Find parent2
-        while (!parent2) {
-            int rand_id = rand() % grid->max_creatures;  // Generate random creature id
-            if (creatures[rand_id].position.y < grid->height / 2 && creatures[rand_id].energy > 0) {
-                parent2 = &creatures[rand_id];
-            }
-        }
-
-        // Perform mating to produce one offspring
-        Gene* offspring_genome = malloc(genome_length * sizeof(Gene));
-        if (!offspring_genome) {
-            // Handle allocation failure
+    // Pick the parents of every offspring, each from the offspring's own stream,
+    // and give each offspring its genome in the arena of the next generation.
+    // With an archive the arena is placed on the generation's block in the
+    // file, so the offspring are bred straight into it.
+    GenomeArchiveGeneration* offspring_archive = NULL;
+    if (grid->genome_archive) {
+        offspring_archive = begin_archived_generation(grid->genome_archive, grid->next_genome_arena, generation,
+                                                      grid->max_creatures, genome_length);
+    } else {
+        reset_arena(grid->next_genome_arena);
+    }
+    for (uint32_t i = 0; i < grid->max_creatures; ++i) {
+        streams[i] = rng_stream(grid->seed, RNG_MATING, generation, 0, i);
+        parents[2 * i] = pick_survivor(survivors, &streams[i]);
+        parents[2 * i + 1] = pick_survivor(survivors, &streams[i]);
+        offspring_genomes[i] = arena_alloc(grid->next_genome_arena, genome_length * sizeof(Gene));
+        if (!offspring_genomes[i]) {
+            // Handle allocation failure, leaving the current generation as it was
+            reset_arena(grid->next_genome_arena);
+            free_survivor_index(survivors);
+            free(new_creatures);
+            free(offspring_genomes);
+            free(offspring_brains);
+            free(parents);
+            free(streams);
+            free(parent_genomes);
+            free(parent_brains);
             return;
         }
+    }
+    grid->generation = generation;
 
-        // Two-point crossover to produce one offspring
-        two_point_crossover(parent1->genome, parent2->genome, offspring_genome, NULL, genome_length);
-
-        // Mutation
-        mutate(offspring_genome, genome_length);
-
-        NeuralNetwork* brain = initialize_neural_network(offspring_genome, genome_length);
-        if (!brain) {
-            free(offspring_genome);
-            continue;
-        }
-
+    // Cross the offspring genomes over on the thread pool, mutate them all in one
+    // pass, then breed any that cannot sense or act again
+    MatingContext mating = {survivors, creatures, genome_length, &grid->mutation_rates, parents, streams, offspring_genomes};
+    parallel_for(grid->thread_pool, grid->max_creatures, cross_offspring, &mating);
+    RngStream mutation_rng = rng_stream(grid->seed, RNG_MUTATION, grid->generation, 0, 0);
+    mutate_population(offspring_genomes, grid->max_creatures, genome_length, &grid->mutation_rates, &mutation_rng);
+    parallel_for(grid->thread_pool, grid->max_creatures, settle_offspring, &mating);
+    free_survivor_index(survivors);
+    free(streams);
+    for (uint32_t i = 0; i < grid->max_creatures; ++i) {
         // Assign the offspring genome to a new creature
-        new_creatures[new_creature_count].genome = offspring_genome;
-        new_creatures[new_creature_count].genome_length = genome_length;
-        new_creatures[new_creature_count].brain = brain;
-        new_creatures[new_creature_count].energy = 100;
-        new_creatures[new_creature_count].age = 0;
+        new_creatures[i].genome = offspring_genomes[i];
+        new_creatures[i].genome_length = genome_length;
+        new_creatures[i].energy = 100;
+        new_creatures[i].age = 0;
+        // The closer parent's genome and brain are the base of the offspring's brain
+        parent_genomes[i] = creatures[parents[2 * i]].genome;
+        parent_brains[i] = creatures[parents[2 * i]].brain;
+    }
+    if (offspring_archive) {
+        GenomeArchiveRecord* records = archived_records(offspring_archive);
+        for (uint32_t i = 0; i < grid->max_creatures; ++i) {
+            records[i].parents[0] = parents[2 * i];
+            records[i].parents[1] = parents[2 * i + 1];
+        }
+        offspring_archive->flags |= ARCHIVE_GENOMES_COMPLETE;
+    }
+    free(parents);
 
-        new_creature_count++;
+    // Compile the offspring brains on the thread pool; offspring identical to a
+    // living creature share its compiled brain, and offspring a few genes away
+    // from their closer parent patch a copy of the parent's brain
+    acquire_brains(grid->brain_cache, grid->thread_pool, offspring_genomes, genome_length, parent_genomes, parent_brains,
+                   offspring_brains, grid->max_creatures);
+    for (int i = 0; i < grid->max_creatures; ++i) {
+        new_creatures[i].brain = offspring_brains[i];
     }
+    free(offspring_genomes);
+    free(offspring_brains);
+    free(parent_genomes);
+    free(parent_brains);
 
     // Overwrite old creatures with new creatures
     for (int i = 0; i < grid->max_creatures; ++i) {
-        // Free the old genome
-        free(creatures[i].genome);
+        // Release the old brain; the old genome goes with its arena
+        release_brain(grid->brain_cache, creatures[i].brain);
 
         // Copy the new genome
         creatures[i].genome = new_creatures[i].genome;
         creatures[i].genome_length = new_creatures[i].genome_length;
         creatures[i].brain = new_creatures[i].brain;
+        memset(creatures[i].neuron_values, 0, sizeof(creatures[i].neuron_values));
         creatures[i].energy = new_creatures[i].energy;
         creatures[i].age = new_creatures[i].age;
         creatures[i].generation++;
@@ -190,226 +452,246 @@ void mate_creatures(Grid* grid, Creature* creatures) {
     // Free the new_creatures array, but not the genomes
     free(new_creatures);
 
+    // The offspring genomes become the current generation; the parents' are dropped at once
+    Arena* parent_arena = grid->genome_arena;
+    grid->genome_arena = grid->next_genome_arena;
+    grid->next_genome_arena = parent_arena;
+    reset_arena(parent_arena);
 
-    // Place each new creature in a random free cell
-    for (int i = 0; i < grid->max_creatures; ++i) {
-        int x, y;
-        do {
-            x = rand() % grid->width;
-            y = rand() % grid->height;
-        } while (get_cell(grid, x, y)->flags.occupied);
+    // Take the survivors of the last generation off the grid
+    for (uint32_t k = 0; k < grid->num_creatures; ++k) {
+        Creature* creature = &creatures[grid->live_creatures[k]];
+        remove_creature(grid, creature->position.x, creature->position.y);
+    }
 
+
+    // Place each new creature in a random free cell; any that find none are born dead
+    RngStream rng = rng_stream(grid->seed, RNG_PLACEMENT, grid->generation, 0, 0);
+    begin_free_cell_sampling(grid, 1u << CELL_OCCUPIED);
+    grid->num_creatures = 0;
+    for (int i = 0; i < grid->max_creatures; ++i) {
+        uint16_t x, y;
+        if (!take_free_cell(grid, &rng, &x, &y)) {
+            creatures[i].energy = 0;
+            continue;
+        }
         creatures[i].position.x = x;
         creatures[i].position.y = y;
-        get_cell(grid, x, y)->flags.occupied = 1;
-        get_cell(grid, x, y)->creature_id = i + 1;
+        place_creature(grid, x, y, i + 1);
+        grid->live_creatures[grid->num_creatures++] = i;
     }
-    grid->num_creatures = grid->max_creatures;
     // replenish food for new generation
     scatter_food(grid, grid->max_creatures);
+    pack_brains(grid, creatures);
 }
 
 /**
- * @brief Updates the state of a creature in the given grid.
- * 
+ * @brief Starts a creature's time step: removes it from the grid if it has died,
+ * feeds it if it stands on food and ages it.
+ *
  * @param grid Pointer to the grid containing the creature.
  * @param creature The creature to update.
+ * @return true if the creature is alive and should sense and act this step.
  */
-void update_creature(Grid* grid, Creature* creature){
-    // Fetch the cell the creature is currently in
-    Cell* cell = get_cell(grid, creature->position.x, creature->position.y);
+bool begin_creature_step(Grid* grid, Creature* creature){
+    // Coordinates of the cell the creature is currently in
+    uint16_t x = creature->position.x;
+    uint16_t y = creature->position.y;
     if (!creature->brain) {
-        cell->flags.occupied = 0;
-        cell->creature_id = 0;
+        remove_creature(grid, x, y);
         grid->num_creatures--;
-        return;
+        return false;
     }
     // Check if the creature is dead
     if (creature->energy <= 0) {
-        cell->flags.occupied = 0;
-        cell->creature_id = 0;
+        remove_creature(grid, x, y);
         grid->num_creatures--;
-        return;
+        return false;
     }
     // Gain energy if standing on food
-    if (cell->flags.food) {
+    if (get_cell_flag(grid, CELL_FOOD, x, y)) {
         creature->energy += 25;
-        cell->flags.food = 0;
+        set_cell_flag(grid, CELL_FOOD, x, y, false);
     }
     // Update the creature's age
     creature->age++;
     // Update the creature's energy
     creature->energy -= 0.01f;
+    return true;
+}
+
+/**
+ * @brief Updates the state of a creature in the given grid.
+ * 
+ * @param grid Pointer to the grid containing the creature.
+ * @param creature The creature to update.
+ * @return true if the creature is still alive, false if it was removed from the grid.
+ */
+bool update_creature(Grid* grid, Creature* creature){
+    if (!begin_creature_step(grid, creature)) {
+        return false;
+    }
     // Fetch the creature's brain
     NeuralNetwork* brain = creature->brain;
-    // Fetch the creature's sensory neurons
-    uint16_t* sensory_ids = brain->sensory_ids;
-    // Iterate through each sensory neuron
-    for (int i = 0; i < brain->num_sensory_neurons; ++i) {
-        // Fetch the data for the sensory neuron
-        float data = get_sensory_data(sensory_ids[i], creature->position.x, creature->position.y, grid);
-        // Fetch the sensory neuron
-        Neuron* neuron = find_neuron_by_id(brain->neurons, brain->total_neurons, sensory_ids[i]);
-        // Update the sensory neuron's data
-        neuron->data = data;
-    }
-    // Update the creature's brain
-    propagate_signal(brain);
-    // Fetch the creature's output neurons
-    uint16_t* output_ids = brain->output_ids;
-    // Action ID to perform
-    uint16_t action_id = 0;
-    float data = -FLT_MAX;
-    // Iterate through each output neuron
-    for (int i = 0; i < brain->num_output_neurons; ++i) {
-        // Fetch the output neuron
-        Neuron* neuron = find_neuron_by_id(brain->neurons, brain->total_neurons, output_ids[i]);
-        // Keep track of the highest data value
-        if (data < neuron->data) {
-            action_id = output_ids[i];
-            data = neuron->data;
+    uint16_t action_id;
+    if (grid->evaluation_mode == EVAL_TOPOLOGICAL && brain->constant_action >= 0) {
+        // Folded brain: the action does not depend on what the creature senses
+        action_id = brain->constant_action;
+    } else {
+        float* values = creature->neuron_values;
+        uint16_t neighborhood = sense_neighborhood(grid, creature->position.x, creature->position.y);
+        // Fill every sensory slot, addressed by its dense index
+        for (int i = 0; i < brain->num_sensory_neurons; ++i) {
+            values[brain->sensory_indices[i]] = get_neighborhood_sensory_data(brain->sensory_ids[i], neighborhood, creature->position.x, creature->position.y, grid);
         }
+        // Update the creature's brain
+        propagate_signal(brain, values, grid->evaluation_mode);
+        action_id = choose_action(brain, values);
     }
-    // If the data is above the activation threshold, perform the action
-    if (action_id >15 && data > find_neuron_by_id(brain->neurons, brain->total_neurons, action_id)->activation_threshold) {
+    // Perform the strongest action if it cleared its threshold
+    if (action_id) {
         perform_action(action_id, grid, creature);
     }
+    return true;
 }
 
+// Step of each move action, M_n to M_nw
+static const int8_t move_dx[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+static const int8_t move_dy[8] = {-1, -1, 0, 1, 1, 1, 0, -1};
+
 void perform_action(uint16_t action_id, Grid* grid, Creature* creature) {
-    Cell* cell;
     if (action_id == M_r){
-        // Set the action ID to a random movement action (21 to 28)
-        action_id = rand() % 8 + 21;
-    }
-    switch (action_id) {
-        case M_n:
-            if (creature->position.y > 0) {
-                cell = get_cell(grid, creature->position.x, creature->position.y - 1);
-                if (!cell->flags.occupied) {
-                    cell->flags.occupied = 1;
-                    cell->creature_id = creature->id;
-                    get_cell(grid, creature->position.x, creature->position.y)->flags.occupied = 0;
-                    get_cell(grid, creature->position.x, creature->position.y)->creature_id = 0;
-                    creature->position.y--;
-                    if (cell->flags.food) { creature->energy += 25; cell->flags.food = 0; }
-                }
-            }
-            break;
-        case M_ne:
-            if (creature->position.x < grid->width - 1 && creature->position.y > 0) {
-                cell = get_cell(grid, creature->position.x + 1, creature->position.y - 1);
-                if (!cell->flags.occupied) {
-                    cell->flags.occupied = 1;
-                    cell->creature_id = creature->id;
-                    get_cell(grid, creature->position.x, creature->position.y)->flags.occupied = 0;
-                    get_cell(grid, creature->position.x, creature->position.y)->creature_id = 0;
-                    creature->position.x++;
-                    creature->position.y--;
-                    if (cell->flags.food) { creature->energy += 25; cell->flags.food = 0; }
-                }
-            }
-            break;
-        case M_e:
-            if (creature->position.x < grid->width - 1) {
-                cell = get_cell(grid, creature->position.x + 1, creature->position.y);
-                if (!cell->flags.occupied) {
-                    cell->flags.occupied = 1;
-                    cell->creature_id = creature->id;
-                    get_cell(grid, creature->position.x, creature->position.y)->flags.occupied = 0;
-                    get_cell(grid, creature->position.x, creature->position.y)->creature_id = 0;
-                    creature->position.x++;
-                    if (cell->flags.food) { creature->energy += 25; cell->flags.food = 0; }
-                }
-            }
-            break;
-        case M_se:
-            if (creature->position.x < grid->width - 1 && creature->position.y < grid->height - 1) {
-                cell = get_cell(grid, creature->position.x + 1, creature->position.y + 1);
-                if (!cell->flags.occupied) {
-                    cell->flags.occupied = 1;
-                    cell->creature_id = creature->id;
-                    get_cell(grid, creature->position.x, creature->position.y)->flags.occupied = 0;
-                    get_cell(grid, creature->position.x, creature->position.y)->creature_id = 0;
-                    creature->position.x++;
-                    creature->position.y++;
-                    if (cell->flags.food) { creature->energy += 25; cell->flags.food = 0; }
-                }
-            }
-            break;
-        case M_s:
-            if (creature->position.y < grid->height - 1) {
-                cell = get_cell(grid, creature->position.x, creature->position.y + 1);
-                if (!cell->flags.occupied) {
-                    cell->flags.occupied = 1;
-                    cell->creature_id = creature->id;
-                    get_cell(grid, creature->position.x, creature->position.y)->flags.occupied = 0;
-                    get_cell(grid, creature->position.x, creature->position.y)->creature_id = 0;
-                    creature->position.y++;
-                    if (cell->flags.food) { creature->energy += 25; cell->flags.food = 0; }
-                }
-            }
-            break;
-        case M_sw:
-            if (creature->position.x > 0 && creature->position.y < grid->height - 1) {
-                cell = get_cell(grid, creature->position.x - 1, creature->position.y + 1);
-                if (!cell->flags.occupied) {
-                    cell->flags.occupied = 1;
-                    cell->creature_id = creature->id;
-                    get_cell(grid, creature->position.x, creature->position.y)->flags.occupied = 0;
-                    get_cell(grid, creature->position.x, creature->position.y)->creature_id = 0;
-                    creature->position.x--;
-                    creature->position.y++;
-                    if (cell->flags.food) { creature->energy += 25; cell->flags.food = 0; }
-                }
-            }
-            break;
-        case M_w:
-            if (creature->position.x > 0) {
-                cell = get_cell(grid, creature->position.x - 1, creature->position.y);
-                if (!cell->flags.occupied) {
-                    cell->flags.occupied = 1;
-                    cell->creature_id = creature->id;
-                    get_cell(grid, creature->position.x, creature->position.y)->flags.occupied = 0;
-                    get_cell(grid, creature->position.x, creature->position.y)->creature_id = 0;
-                    creature->position.x--;
-                    if (cell->flags.food) { creature->energy += 25; cell->flags.food = 0; }
-                }
-            }
-            break;
-        case M_nw:
-            if (creature->position.x > 0 && creature->position.y > 0) {
-                cell = get_cell(grid, creature->position.x - 1, creature->position.y - 1);
-                if (!cell->flags.occupied) {
-                    cell->flags.occupied = 1;
-                    cell->creature_id = creature->id;
-                    get_cell(grid, creature->position.x, creature->position.y)->flags.occupied = 0;
-                    get_cell(grid, creature->position.x, creature->position.y)->creature_id = 0;
-                    creature->position.x--;
-                    creature->position.y--;
-                    if (cell->flags.food) { creature->energy += 25; cell->flags.food = 0; }
-                }
-            }
-            break;
+        // Set the action ID to a random movement action (21 to 28), drawn from the creature's stream for this step
+        RngStream rng = rng_stream(grid->seed, RNG_MOVE, grid->generation, (uint32_t)grid->num_generations, creature->id);
+        action_id = rng_below(&rng, 8) + 21;
+    }
+    if (action_id < M_n || action_id > M_nw) {
+        return;
+    }
+    int x = creature->position.x + move_dx[action_id - M_n];
+    int y = creature->position.y + move_dy[action_id - M_n];
+    // Move into the neighbouring cell if it is inside the grid and free
+    if (x < 0 || x >= grid->width || y < 0 || y >= grid->height || get_cell_flag(grid, CELL_OCCUPIED, x, y)) {
+        return;
+    }
+    place_creature(grid, x, y, creature->id);
+    remove_creature(grid, creature->position.x, creature->position.y);
+    creature->position.x = x;
+    creature->position.y = y;
+    if (get_cell_flag(grid, CELL_FOOD, x, y)) {
+        creature->energy += 25;
+        set_cell_flag(grid, CELL_FOOD, x, y, false);
+    }
+}
+
+// Look value of the cell at (x, y): -1 for a creature, 1 for food, 0 if empty
+static float look_at(Grid* grid, uint16_t x, uint16_t y) {
+    if (get_cell_flag(grid, CELL_OCCUPIED, x, y)) {
+        return -1.0;
+    } else if (get_cell_flag(grid, CELL_FOOD, x, y)) {
+        return 1.0;
+    }
+    return 0.0;
+}
+
+// Reorder a 9-bit row-major mask of the 3x3 neighborhood into one bit per look
+// sensor, L_n in bit 0 to L_nw in bit 7: cells 1, 2, 5, 8, 7, 6, 3 and 0
+static uint32_t gather_look_cells(uint32_t cells) {
+    return (cells >> 1 & 1) | (cells >> 2 & 1) << 1 | (cells >> 5 & 1) << 2 | (cells >> 8 & 1) << 3 |
+           (cells >> 7 & 1) << 4 | (cells >> 6 & 1) << 5 | (cells >> 3 & 1) << 6 | (cells & 1) << 7;
+}
+
+// Value of each two-bit neighborhood code: empty, food, creature, outside the grid
+static const float look_values[4] = {0.0f, 1.0f, -1.0f, -2.0f};
+
+/**
+ * Gather the 3x3 neighborhood of a cell in one fetch: for each look direction,
+ * L_n to L_nw, two bits hold 0 for an empty cell, 1 for food, 2 for a creature
+ * and 3 outside the grid.
+ *
+ * @param grid Pointer to the grid.
+ * @param x X-coordinate of the center cell.
+ * @param y Y-coordinate of the center cell.
+ * @return The packed neighborhood, direction d in bits 2d and 2d + 1.
+ */
+uint16_t sense_neighborhood(Grid* grid, uint16_t x, uint16_t y) {
+    // Columns x - 1, x and x + 1 that lie inside the grid
+    uint32_t columns = (x > 0 ? 1 : 0) | 2 | (x + 1 < grid->width ? 4 : 0);
+    uint32_t first = x > 0 ? x - 1 : x;  // Column of the first bit read in each row
+    uint32_t shift = x > 0 ? 0 : 1;      // Moves that bit to the column it belongs to
+    uint32_t inside = 0;
+    uint32_t occupied = 0;
+    uint32_t food = 0;
+    // One three-bit read per row and bitplane, as 9-bit row-major masks
+    // Rows outside the grid read the center row instead and are masked out
+    const uint64_t* occupied_plane = grid->cell_flags[CELL_OCCUPIED];
+    const uint64_t* food_plane = grid->cell_flags[CELL_FOOD];
+    for (int row = 0; row < 3; ++row) {
+        int r = y + row - 1;
+        bool valid = r >= 0 && r < grid->height;
+        uint32_t row_columns = valid ? columns : 0;
+        uint32_t i = (uint32_t)(valid ? r : y) * grid->width + first;
+        inside |= row_columns << (3 * row);
+        occupied |= ((get_plane_bits3(occupied_plane, i) << shift) & row_columns) << (3 * row);
+        food |= ((get_plane_bits3(food_plane, i) << shift) & row_columns) << (3 * row);
+    }
+    // Codes as two bit masks: the high bit is set outside the grid or on a creature,
+    // the low bit outside the grid or on food without a creature
+    uint32_t high = ~inside | occupied;
+    uint32_t low = ~inside | (food & ~occupied);
+    uint32_t high_bits = gather_look_cells(high);
+    uint32_t low_bits = gather_look_cells(low);
+    // Interleave the two masks so direction d ends up in bits 2d and 2d + 1
+    high_bits = (high_bits | high_bits << 4) & 0x0F0F;
+    high_bits = (high_bits | high_bits << 2) & 0x3333;
+    high_bits = (high_bits | high_bits << 1) & 0x5555;
+    low_bits = (low_bits | low_bits << 4) & 0x0F0F;
+    low_bits = (low_bits | low_bits << 2) & 0x3333;
+    low_bits = (low_bits | low_bits << 1) & 0x5555;
+    return (uint16_t)(high_bits << 1 | low_bits);
+}
+
+/**
+ * Read a sensor, taking the look sensors from a neighborhood gathered by
+ * sense_neighborhood and falling back to get_sensory_data for the others.
+ *
+ * @param id Sensory neuron to read.
+ * @param neighborhood Neighborhood of the cell at (x, y).
+ * @param x X-coordinate of the sensing creature.
+ * @param y Y-coordinate of the sensing creature.
+ * @param grid Pointer to the grid.
+ * @return The same value get_sensory_data returns.
+ */
+float get_neighborhood_sensory_data(NeuronID id, uint16_t neighborhood, uint16_t x, uint16_t y, Grid* grid) {
+    if (id <= L_nw) {
+        return look_values[neighborhood >> (2 * id) & 3];
+    }
+    return get_sensory_data(id, x, y, grid);
+}
+
+// Value a wall sensor reports when its ray reaches the edge of the grid without meeting a wall
+static float boundary_distance(NeuronID id, uint16_t x, uint16_t y, Grid* grid) {
+    switch (id) {
+        case LW_n: return y;
+        case LW_ne: return y < grid->width - x ? y : grid->width - x;
+        case LW_e: return grid->width - x;
+        case LW_se: return y < grid->width - x ? grid->height - y : grid->width - x;
+        case LW_s: return grid->height - y;
+        case LW_sw: return y < x ? grid->height - y : x;
+        case LW_w: return x;
+        case LW_nw: return y < x ? y : x;
+        default: return 0;
     }
 }
 
 float get_sensory_data(NeuronID id, uint16_t x, uint16_t y, Grid* grid) {
-    Cell* cell;
     int dx, dy;  // Delta x and y for calculating positions
     float data = -FLT_MAX;  // Default value
     switch (id) {
         case L_n:
             dy = y - 1;
             if (dy >= 0) {
-                cell = get_cell(grid, x, dy);
-                if (cell->flags.occupied) {
-                    data = -1.0;
-                } else if (cell->flags.food) {
-                    data = 1.0;
-                } else {
-                    data = 0.0;
-                }
+                data = look_at(grid, x, dy);
             } else {
                 data = -2.0;  // Out of bounds
             }
@@ -418,14 +700,7 @@ float get_sensory_data(NeuronID id, uint16_t x, uint16_t y, Grid* grid) {
             dx = x + 1;
             dy = y - 1;
             if (dx < grid->width && dy >= 0) {
-                cell = get_cell(grid, dx, dy);
-                if (cell->flags.occupied) {
-                    data = -1.0;
-                } else if (cell->flags.food) {
-                    data = 1.0;
-                } else {
-                    data = 0.0;
-                }
+                data = look_at(grid, dx, dy);
             } else {
                 data = -2.0;  // Out of bounds
             }
@@ -433,14 +708,7 @@ float get_sensory_data(NeuronID id, uint16_t x, uint16_t y, Grid* grid) {
         case L_e:
             dx = x + 1;
             if (dx < grid->width) {
-                cell = get_cell(grid, dx, y);
-                if (cell->flags.occupied) {
-                    data = -1.0;
-                } else if (cell->flags.food) {
-                    data = 1.0;
-                } else {
-                    data = 0.0;
-                }
+                data = look_at(grid, dx, y);
             } else {
                 data = -2.0;  // Out of bounds
             }
@@ -449,14 +717,7 @@ float get_sensory_data(NeuronID id, uint16_t x, uint16_t y, Grid* grid) {
             dx = x + 1;
             dy = y + 1;
             if (dx < grid->width && dy < grid->height) {
-                cell = get_cell(grid, dx, dy);
-                if (cell->flags.occupied) {
-                    data = -1.0;
-                } else if (cell->flags.food) {
-                    data = 1.0;
-                } else {
-                    data = 0.0;
-                }
+                data = look_at(grid, dx, dy);
             } else {
                 data = -2.0;  // Out of bounds
             }
@@ -464,14 +725,7 @@ float get_sensory_data(NeuronID id, uint16_t x, uint16_t y, Grid* grid) {
         case L_s:
             dy = y + 1;
             if (dy < grid->height) {
-                cell = get_cell(grid, x, dy);
-                if (cell->flags.occupied) {
-                    data = -1.0;
-                } else if (cell->flags.food) {
-                    data = 1.0;
-                } else {
-                    data = 0.0;
-                }
+                data = look_at(grid, x, dy);
             } else {
                 data = -2.0;  // Out of bounds
             }
@@ -480,14 +734,7 @@ float get_sensory_data(NeuronID id, uint16_t x, uint16_t y, Grid* grid) {
             dx = x - 1;
             dy = y + 1;
             if (dx >= 0 && dy < grid->height) {
-                cell = get_cell(grid, dx, dy);
-                if (cell->flags.occupied) {
-                    data = -1.0;
-                } else if (cell->flags.food) {
-                    data = 1.0;
-                } else {
-                    data = 0.0;
-                }
+                data = look_at(grid, dx, dy);
             } else {
                 data = -2.0;  // Out of bounds
             }
@@ -495,14 +742,7 @@ float get_sensory_data(NeuronID id, uint16_t x, uint16_t y, Grid* grid) {
         case L_w:
             dx = x - 1;
             if (dx >= 0) {
-                cell = get_cell(grid, dx, y);
-                if (cell->flags.occupied) {
-                    data = -1.0;
-                } else if (cell->flags.food) {
-                    data = 1.0;
-                } else {
-                    data = 0.0;
-                }
+                data = look_at(grid, dx, y);
             } else {
                 data = -2.0;  // Out of bounds
             }
@@ -511,112 +751,23 @@ float get_sensory_data(NeuronID id, uint16_t x, uint16_t y, Grid* grid) {
             dx = x - 1;
             dy = y - 1;
             if (dx >= 0 && dy >= 0) {
-                cell = get_cell(grid, dx, dy);
-                if (cell->flags.occupied) {
-                    data = -1.0;
-                } else if (cell->flags.food) {
-                    data = 1.0;
-                } else {
-                    data = 0.0;
-                }
+                data = look_at(grid, dx, dy);
             } else {
                 data = -2.0;  // Out of bounds
             }
             break;
         case LW_n:
-            for (dy = y - 1; dy >= 0; dy--) {
-                cell = get_cell(grid, x, dy);
-                if (cell->flags.wall) {
-                    data = y - dy;  // Distance to the wall
-                    break;
-                }
-            }
-            if (dy < 0) {  // Reached the boundary without finding a wall
-                data = y;
-            }
-            break;
         case LW_ne:
-            for (dx = x + 1, dy = y - 1; dx < grid->width && dy >= 0; dx++, dy--) {
-                cell = get_cell(grid, dx, dy);
-                if (cell->flags.wall) {
-                    data = y - dy;  // Distance to the wall
-                    break;
-                }
-            }
-            if (dx >= grid->width || dy < 0) {  // Reached the boundary without finding a wall
-                data = y < grid->width - x ? y : grid->width - x;
-            }
-            break;
         case LW_e:
-            for (dx = x + 1; dx < grid->width; dx++) {
-                cell = get_cell(grid, dx, y);
-                if (cell->flags.wall) {
-                    data = dx - x;  // Distance to the wall
-                    break;
-                }
-            }
-            if (dx >= grid->width) {  // Reached the boundary without finding a wall
-                data = grid->width - x;
-            }
-            break;
         case LW_se:
-            for (dx = x + 1, dy = y + 1; dx < grid->width && dy < grid->height; dx++, dy++) {
-                cell = get_cell(grid, dx, dy);
-                if (cell->flags.wall) {
-                    data = dy - y;  // Distance to the wall
-                    break;
-                }
-            }
-            if (dx >= grid->width || dy >= grid->height) {  // Reached the boundary without finding a wall
-                data = y < grid->width - x ? grid->height - y : grid->width - x;
-            }
-            break;
         case LW_s:
-            for (dy = y + 1; dy < grid->height; dy++) {
-                cell = get_cell(grid, x, dy);
-                if (cell->flags.wall) {
-                    data = dy - y;  // Distance to the wall
-                    break;
-                }
-            }
-            if (dy >= grid->height) {  // Reached the boundary without finding a wall
-                data = grid->height - y;
-            }
-            break;
         case LW_sw:
-            for (dx = x - 1, dy = y + 1; dx >= 0 && dy < grid->height; dx--, dy++) {
-                cell = get_cell(grid, dx, dy);
-                if (cell->flags.wall) {
-                    data = dy - y;  // Distance to the wall
-                    break;
-                }
-            }
-            if (dx < 0 || dy >= grid->height) {  // Reached the boundary without finding a wall
-                data = y < x ? grid->height - y : x;
-            }
-            break;
         case LW_w:
-            for (dx = x - 1; dx >= 0; dx--) {
-                cell = get_cell(grid, dx, y);
-                if (cell->flags.wall) {
-                    data = x - dx;  // Distance to the wall
-                    break;
-                }
-            }
-            if (dx < 0) {  // Reached the boundary without finding a wall
-                data = x;
-            }
-            break;
         case LW_nw:
-            for (dx = x - 1, dy = y - 1; dx >= 0 && dy >= 0; dx--, dy--) {
-                cell = get_cell(grid, dx, dy);
-                if (cell->flags.wall) {
-                    data = x - dx;  // Distance to the wall
-                    break;
-                }
-            }
-            if (dx < 0 || dy < 0) {  // Reached the boundary without finding a wall
-                data = y < x ? y : x;
+            // Steps to the nearest wall, read from the precomputed distance field
+            data = grid->wall_distances[id - LW_n][(uint32_t)y * grid->width + x];
+            if (data == 0) {  // No wall before the boundary
+                data = boundary_distance(id, x, y, grid);
             }
             break;
         default:
@@ -11,13 +11,14 @@ typedef struct{
 
 typedef struct{
     Position position;
-    NeuralNetwork* brain;
+    NeuralNetwork* brain;                   // Compiled brain, shared with every creature of the same genome
+    float neuron_values[TOTAL_NEURONS];     // Value of each brain neuron, by dense index
     float energy;
     uint32_t id;
     uint32_t age;
     uint32_t generation;
     int genome_length;
-    Gene* genome;
+    Gene* genome;                           // Genes, in the grid's genome arena of the current generation
 } Creature;
 
 /**
@@ -34,14 +35,45 @@ void update_grid(Grid* grid, Creature* creatures);
  * @param num_creatures The number of creatures to spawn.
  */
 void spawn_creatures(Grid* grid, Creature* creatures);
+/**
+ * @brief Simulates one time step with every brain evaluated through the grid's brain batch.
+ *
+ * @param grid A pointer to the grid to be updated.
+ * @param creatures The creatures of the current generation.
+ */
+void update_grid_batched(Grid* grid, Creature* creatures);
+/**
+ * Pack the brains of the current generation into the grid's brain batch.
+ *
+ * @param grid The grid holding the batch.
+ * @param creatures The creatures of the current generation.
+ */
+void pack_brains(Grid* grid, Creature* creatures);
+/**
+ * @brief Starts a creature's time step: removes it from the grid if it has died,
+ * feeds it if it stands on food and ages it.
+ *
+ * @param grid Pointer to the grid containing the creature.
+ * @param creature The creature to update.
+ * @return true if the creature is alive and should sense and act this step.
+ */
+bool begin_creature_step(Grid* grid, Creature* creature);
 /**
  * @brief Updates the state of a creature in the given grid.
  * 
  * @param grid Pointer to the grid containing the creature.
  * @param creature The creature to update.
+ * @return true if the creature is still alive, false if it was removed from the grid.
  */
-void update_creature(Grid* grid, Creature* creature);
-void spawn_creature(Creature* creature, int genome_length);
+bool update_creature(Grid* grid, Creature* creature);
+/**
+ * Give a creature a random genome and its compiled brain.
+ *
+ * @param grid The grid whose brain cache compiles the brain.
+ * @param creature The creature to initialize.
+ * @param genome_length Number of genes in the genome.
+ */
+void spawn_creature(Grid* grid, Creature* creature, int genome_length);
 /**
  * @brief Mates the creatures in the given grid.
  * 
@@ -49,6 +81,29 @@ void spawn_creature(Creature* creature, int genome_length);
  */
 void mate_creatures(Grid* grid, Creature* creatures);
 float get_sensory_data(NeuronID id, uint16_t x, uint16_t y, Grid* grid);
+/**
+ * Gather the 3x3 neighborhood of a cell in one fetch: for each look direction,
+ * L_n to L_nw, two bits hold 0 for an empty cell, 1 for food, 2 for a creature
+ * and 3 outside the grid.
+ *
+ * @param grid Pointer to the grid.
+ * @param x X-coordinate of the center cell.
+ * @param y Y-coordinate of the center cell.
+ * @return The packed neighborhood, direction d in bits 2d and 2d + 1.
+ */
+uint16_t sense_neighborhood(Grid* grid, uint16_t x, uint16_t y);
+/**
+ * Read a sensor, taking the look sensors from a neighborhood gathered by
+ * sense_neighborhood and falling back to get_sensory_data for the others.
+ *
+ * @param id Sensory neuron to read.
+ * @param neighborhood Neighborhood of the cell at (x, y).
+ * @param x X-coordinate of the sensing creature.
+ * @param y Y-coordinate of the sensing creature.
+ * @param grid Pointer to the grid.
+ * @return The same value get_sensory_data returns.
+ */
+float get_neighborhood_sensory_data(NeuronID id, uint16_t neighborhood, uint16_t x, uint16_t y, Grid* grid);
 void perform_action(uint16_t action_id, Grid* grid, Creature* creature);
 
 #endif
@@ -0,0 +1,202 @@
+#include "snapshot.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Words per bitplane, as laid out by initialize_grid
+static uint32_t plane_words(const Grid* grid) {
+    return grid_plane_words(grid->width, grid->height);
+}
+
+/**
+ * Largest size a snapshot of a grid can take, with every creature on it.
+ *
+ * @param grid Pointer to the grid.
+ * @return Size in bytes.
+ */
+size_t snapshot_capacity(const Grid* grid) {
+    return sizeof(SnapshotHeader)
+         + (size_t)NUM_CELL_FLAGS * plane_words(grid) * sizeof(uint64_t)
+         + (size_t)grid->max_creatures * sizeof(SnapshotCreature);
+}
+
+/**
+ * Encode the current state of the grid into a snapshot in memory.
+ *
+ * @param grid Pointer to the grid.
+ * @param creatures The creatures of the current generation.
+ * @param buffer Receives the snapshot, at least snapshot_capacity bytes.
+ * @return Size of the snapshot in bytes.
+ */
+size_t encode_snapshot(const Grid* grid, const Creature* creatures, void* buffer) {
+    uint8_t* out = buffer;
+    SnapshotHeader header;
+    header.magic = SNAPSHOT_MAGIC;
+    header.version = SNAPSHOT_VERSION;
+    header.num_planes = NUM_CELL_FLAGS;
+    header.width = grid->width;
+    header.height = grid->height;
+    header.plane_words = plane_words(grid);
+    header.generation = grid->generation;
+    header.step = (uint32_t)grid->num_generations;
+    header.num_creatures = grid->num_creatures;
+    header.reserved = 0;
+    memcpy(out, &header, sizeof(header));
+    out += sizeof(header);
+
+    // The bitplanes are one block already
+    size_t plane_bytes = (size_t)NUM_CELL_FLAGS * header.plane_words * sizeof(uint64_t);
+    memcpy(out, grid->cell_flags[0], plane_bytes);
+    out += plane_bytes;
+
+    for (uint32_t k = 0; k < grid->num_creatures; ++k) {
+        const Creature* creature = &creatures[grid->live_creatures[k]];
+        SnapshotCreature record;
+        record.id = get_creature_id(grid, creature->position.x, creature->position.y);
+        record.x = creature->position.x;
+        record.y = creature->position.y;
+        record.energy = creature->energy;
+        record.age = creature->age;
+        memcpy(out, &record, sizeof(record));
+        out += sizeof(record);
+    }
+    return (size_t)(out - (uint8_t*)buffer);
+}
+
+/**
+ * Name of the temporary file a file is written to before replace_file moves it
+ * into place: the name with ".tmp" appended.
+ *
+ * @param filename Name of the file.
+ * @return The name, to be freed by the caller, or NULL if allocation failed.
+ */
+char* temporary_filename(const char* filename) {
+    size_t name_length = strlen(filename);
+    char* temporary = malloc(name_length + 5);
+    if (!temporary) {
+        return NULL;  // Allocation failed
+    }
+    memcpy(temporary, filename, name_length);
+    memcpy(temporary + name_length, ".tmp", 5);
+    return temporary;
+}
+
+/**
+ * Finish writing a file through its temporary file. A complete temporary file
+ * is renamed over the file, so readers never see a partly written one; a
+ * failed one is removed and the file is left as it was.
+ *
+ * @param temporary Name of the temporary file, see temporary_filename.
+ * @param filename Name of the file.
+ * @param failed Whether writing the temporary file failed.
+ * @return 0 on success, non-zero if writing or renaming failed.
+ */
+int replace_file(const char* temporary, const char* filename, int failed) {
+    if (!failed && rename(temporary, filename) != 0) {
+        // Some platforms refuse to rename over an existing file
+        remove(filename);
+        failed = rename(temporary, filename) != 0;
+    }
+    if (failed) {
+        remove(temporary);
+    }
+    return failed;
+}
+
+/**
+ * Write an encoded snapshot to a file, in a single write to a temporary file
+ * that is then renamed over it.
+ *
+ * @param snapshot The snapshot, as encoded by encode_snapshot.
+ * @param size Size of the snapshot in bytes.
+ * @param filename Name of the output file.
+ * @return 0 on success, non-zero on failure.
+ */
+int write_snapshot(const void* snapshot, size_t size, const char* filename) {
+    char* temporary = temporary_filename(filename);
+    if (!temporary) {
+        return 1;  // Allocation failed
+    }
+    FILE* file = fopen(temporary, "wb");
+    if (!file) {
+        free(temporary);
+        return 1;  // File open failed
+    }
+    // Unbuffered, the frame is already in one block
+    setvbuf(file, NULL, _IONBF, 0);
+    int failed = fwrite(snapshot, 1, size, file) != size;
+    failed |= fclose(file) != 0;
+    failed = replace_file(temporary, filename, failed);
+    free(temporary);
+    return failed;
+}
+
+/**
+ * Write an encoded snapshot to a file in the CSV format of output_grid_to_csv,
+ * through a temporary file that is then renamed over it.
+ *
+ * @param snapshot The snapshot, as encoded by encode_snapshot.
+ * @param filename Name of the output file.
+ * @return 0 on success, non-zero on failure.
+ */
+int write_snapshot_csv(const void* snapshot, const char* filename) {
+    SnapshotHeader header;
+    memcpy(&header, snapshot, sizeof(header));
+    const uint64_t* planes = (const uint64_t*)((const uint8_t*)snapshot + sizeof(header));
+    const uint8_t* records = (const uint8_t*)(planes + (size_t)header.num_planes * header.plane_words);
+
+    // Creature IDs of cells follow from the creature positions
+    uint32_t num_cells = (uint32_t)header.width * header.height;
+    uint32_t* ids = calloc(num_cells, sizeof(uint32_t));
+    if (!ids) {
+        return 1;  // Allocation failed
+    }
+    for (uint32_t k = 0; k < header.num_creatures; ++k) {
+        SnapshotCreature record;
+        memcpy(&record, records + k * sizeof(record), sizeof(record));
+        ids[(uint32_t)record.y * header.width + record.x] = record.id;
+    }
+
+    char* temporary = temporary_filename(filename);
+    FILE *file = temporary ? fopen(temporary, "w") : NULL;
+    if (!file) {
+        free(temporary);
+        free(ids);
+        return 1;  // Allocation or file open failed
+    }
+    fprintf(file, "X,Y,Occupied,Food,Poison,Wall,Sunlit,Water,CreatureID\n");
+    for (uint32_t i = 0; i < num_cells; ++i) {
+        int flags[NUM_CELL_FLAGS];
+        for (int f = 0; f < NUM_CELL_FLAGS; ++f) {
+            flags[f] = (int)(planes[(size_t)f * header.plane_words + (i >> 6)] >> (i & 63) & 1);
+        }
+        fprintf(file, "%u,%u,%d,%d,%d,%d,%d,%d,%u\n", i % header.width, i / header.width,
+                flags[CELL_OCCUPIED], flags[CELL_FOOD], flags[CELL_POISON], flags[CELL_WALL],
+                flags[CELL_SUNLIT], flags[CELL_WATER], ids[i]);
+    }
+    int failed = fclose(file) != 0;
+    failed = replace_file(temporary, filename, failed);
+    free(temporary);
+    free(ids);
+    return failed;
+}
+
+/**
+ * Output the grid state to a binary snapshot file, in a single write. Much
+ * smaller and faster than output_grid_to_csv.
+ *
+ * @param grid Pointer to the grid.
+ * @param creatures The creatures of the current generation.
+ * @param filename Name of the output file.
+ * @return 0 on success, non-zero on failure.
+ */
+int output_grid_snapshot(const Grid* grid, const Creature* creatures, const char* filename) {
+    void* buffer = malloc(snapshot_capacity(grid));
+    if (!buffer) {
+        return 1;  // Allocation failed
+    }
+    size_t size = encode_snapshot(grid, creatures, buffer);
+    int failed = write_snapshot(buffer, size, filename);
+    free(buffer);
+    return failed;
+}
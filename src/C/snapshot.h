@@ -0,0 +1,116 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "grid.h"
+#include "simulation.h"
+
+// First word of every snapshot, "ESNP" in a little-endian file
+#define SNAPSHOT_MAGIC 0x504E5345u
+// Version of the layout below, bumped on every incompatible change
+#define SNAPSHOT_VERSION 1
+
+/*
+ * A binary frame of the grid, in host byte order (little-endian on every
+ * platform the simulation builds on). A frame is this header, followed by
+ * num_planes bitplanes of plane_words 64-bit words each, in CellFlag order,
+ * where bit i of a plane is the cell at x = i % width, y = i / width, followed
+ * by num_creatures SnapshotCreature records of the creatures on the grid, in
+ * increasing index order. Creature IDs of cells are not stored: they follow
+ * from the creature positions.
+ */
+typedef struct {
+    uint32_t magic;          // SNAPSHOT_MAGIC
+    uint16_t version;        // SNAPSHOT_VERSION
+    uint16_t num_planes;     // Number of bitplanes, NUM_CELL_FLAGS
+    uint16_t width;          // Width of the grid
+    uint16_t height;         // Height of the grid
+    uint32_t plane_words;    // Words per bitplane, grid_plane_words(width, height)
+    uint32_t generation;     // Times the creatures had been bred
+    uint32_t step;           // Steps taken in the generation
+    uint32_t num_creatures;  // Number of creature records
+    uint32_t reserved;       // Zero
+} SnapshotHeader;
+
+// A creature on the grid, as stored in a snapshot
+typedef struct {
+    uint32_t id;      // ID of the creature, as stored in the cell it occupies
+    uint16_t x;       // Position of the creature
+    uint16_t y;
+    float energy;     // Energy left
+    uint32_t age;     // Steps lived
+} SnapshotCreature;
+
+/**
+ * Largest size a snapshot of a grid can take, with every creature on it.
+ *
+ * @param grid Pointer to the grid.
+ * @return Size in bytes.
+ */
+size_t snapshot_capacity(const Grid* grid);
+
+/**
+ * Encode the current state of the grid into a snapshot in memory.
+ *
+ * @param grid Pointer to the grid.
+ * @param creatures The creatures of the current generation.
+ * @param buffer Receives the snapshot, at least snapshot_capacity bytes.
+ * @return Size of the snapshot in bytes.
+ */
+size_t encode_snapshot(const Grid* grid, const Creature* creatures, void* buffer);
+
+/**
+ * Name of the temporary file a file is written to before replace_file moves it
+ * into place: the name with ".tmp" appended.
+ *
+ * @param filename Name of the file.
+ * @return The name, to be freed by the caller, or NULL if allocation failed.
+ */
+char* temporary_filename(const char* filename);
+
+/**
+ * Finish writing a file through its temporary file. A complete temporary file
+ * is renamed over the file, so readers never see a partly written one; a
+ * failed one is removed and the file is left as it was.
+ *
+ * @param temporary Name of the temporary file, see temporary_filename.
+ * @param filename Name of the file.
+ * @param failed Whether writing the temporary file failed.
+ * @return 0 on success, non-zero if writing or renaming failed.
+ */
+int replace_file(const char* temporary, const char* filename, int failed);
+
+/**
+ * Write an encoded snapshot to a file, in a single write to a temporary file
+ * that is then renamed over it.
+ *
+ * @param snapshot The snapshot, as encoded by encode_snapshot.
+ * @param size Size of the snapshot in bytes.
+ * @param filename Name of the output file.
+ * @return 0 on success, non-zero on failure.
+ */
+int write_snapshot(const void* snapshot, size_t size, const char* filename);
+
+/**
+ * Write an encoded snapshot to a file in the CSV format of output_grid_to_csv,
+ * through a temporary file that is then renamed over it.
+ *
+ * @param snapshot The snapshot, as encoded by encode_snapshot.
+ * @param filename Name of the output file.
+ * @return 0 on success, non-zero on failure.
+ */
+int write_snapshot_csv(const void* snapshot, const char* filename);
+
+/**
+ * Output the grid state to a binary snapshot file, in a single write. Much
+ * smaller and faster than output_grid_to_csv.
+ *
+ * @param grid Pointer to the grid.
+ * @param creatures The creatures of the current generation.
+ * @param filename Name of the output file.
+ * @return 0 on success, non-zero on failure.
+ */
+int output_grid_snapshot(const Grid* grid, const Creature* creatures, const char* filename);
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,259 @@
+#include "snapshot_writer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Longest stride of a decimating writer, one frame in 2^16
+#define MAX_STRIDE (1u << 16)
+
+// Write one job to its files, each through a temporary file renamed over it
+static int write_job(WriterJob* job) {
+    if (job->kind == JOB_NETWORK) {
+        char* neurons_temporary = temporary_filename(job->filename);
+        char* connections_temporary = temporary_filename(job->second_filename);
+        int failed = 1;  // Allocation failed
+        if (neurons_temporary && connections_temporary) {
+            failed = output_network_to_csv(job->network, neurons_temporary, connections_temporary);
+            failed = replace_file(neurons_temporary, job->filename, failed);
+            failed = replace_file(connections_temporary, job->second_filename, failed);
+        }
+        free(neurons_temporary);
+        free(connections_temporary);
+        free_neural_network(job->network);
+        job->network = NULL;
+        return failed;
+    }
+    if (job->format == SNAPSHOT_CSV) {
+        return write_snapshot_csv(job->data, job->filename);
+    }
+    return write_snapshot(job->data, job->size, job->filename);
+}
+
+// Body of the writer thread: write jobs in queue order until stopped and drained
+static void* writer_main(void* argument) {
+    SnapshotWriter* writer = argument;
+    pthread_mutex_lock(&writer->mutex);
+    for (;;) {
+        while (writer->num_queued == 0 && !writer->stop) {
+            pthread_cond_wait(&writer->job_ready, &writer->mutex);
+        }
+        if (writer->num_queued == 0) {
+            break;  // Stopped, and nothing left to write
+        }
+        // The slot stays taken while it is written, so the lock can be dropped
+        WriterJob* job = &writer->jobs[writer->head];
+        pthread_mutex_unlock(&writer->mutex);
+        int failed = write_job(job);
+        pthread_mutex_lock(&writer->mutex);
+
+        writer->failed |= failed != 0;
+        if (job->kind == JOB_SNAPSHOT) {
+            writer->frames_written++;
+        }
+        writer->head = (writer->head + 1) % writer->num_slots;
+        writer->num_queued--;
+        if (writer->num_queued == 0) {
+            writer->stride = 1;  // Caught up, stop decimating
+        }
+        pthread_cond_broadcast(&writer->slot_free);
+    }
+    pthread_mutex_unlock(&writer->mutex);
+    return NULL;
+}
+
+// Take the next free slot, waiting for one if the job can't be dropped or the
+// policy is to block. Returns NULL if the frame is dropped instead.
+static WriterJob* reserve_job(SnapshotWriter* writer, bool droppable) {
+    pthread_mutex_lock(&writer->mutex);
+    if (droppable) {
+        if (writer->frames_offered++ % writer->stride != 0) {
+            writer->frames_dropped++;  // Decimated
+            pthread_mutex_unlock(&writer->mutex);
+            return NULL;
+        }
+    }
+    while (writer->num_queued == writer->num_slots) {
+        if (droppable && writer->policy != WRITER_BLOCK) {
+            if (writer->policy == WRITER_DECIMATE && writer->stride < MAX_STRIDE) {
+                writer->stride *= 2;
+            }
+            writer->frames_dropped++;
+            pthread_mutex_unlock(&writer->mutex);
+            return NULL;
+        }
+        pthread_cond_wait(&writer->slot_free, &writer->mutex);
+    }
+    // Only this thread queues, so the slot stays free once the lock is dropped
+    WriterJob* job = &writer->jobs[(writer->head + writer->num_queued) % writer->num_slots];
+    pthread_mutex_unlock(&writer->mutex);
+    return job;
+}
+
+// Hand a filled slot to the writer thread, or write it at once without one
+static int commit_job(SnapshotWriter* writer) {
+    if (writer->policy == WRITER_INLINE) {
+        WriterJob* job = &writer->jobs[writer->head];
+        writer->failed |= write_job(job) != 0;
+        if (job->kind == JOB_SNAPSHOT) {
+            writer->frames_written++;
+        }
+        return writer->failed;
+    }
+    pthread_mutex_lock(&writer->mutex);
+    writer->num_queued++;
+    int failed = writer->failed;
+    pthread_cond_signal(&writer->job_ready);
+    pthread_mutex_unlock(&writer->mutex);
+    return failed;
+}
+
+/**
+ * Start a writer thread for the snapshots of a grid, or with WRITER_INLINE a
+ * writer that writes on the calling thread.
+ *
+ * @param grid Pointer to the grid whose snapshots will be written, NULL for a writer of networks only,
+ *             which allocates no snapshot buffers.
+ * @param num_slots Capacity of the ring, at least 1; WRITER_INLINE uses a single slot.
+ * @param policy What to do with a frame when the ring is full.
+ * @return Pointer to the new writer, or NULL if allocation failed or the thread could not be started.
+ */
+SnapshotWriter* create_snapshot_writer(const Grid* grid, uint32_t num_slots, WriterPolicy policy) {
+    if (num_slots == 0 || policy == WRITER_INLINE) {
+        num_slots = 1;
+    }
+    SnapshotWriter* writer = calloc(1, sizeof(SnapshotWriter));
+    if (!writer) {
+        return NULL;  // Allocation failed
+    }
+    size_t capacity = grid ? snapshot_capacity(grid) : 0;
+    writer->jobs = calloc(num_slots, sizeof(WriterJob));
+    writer->buffers = capacity ? malloc(num_slots * capacity) : NULL;
+    if (!writer->jobs || (capacity && !writer->buffers)) {
+        free(writer->jobs);
+        free(writer->buffers);
+        free(writer);
+        return NULL;  // Allocation failed
+    }
+    for (uint32_t i = 0; i < num_slots && writer->buffers; ++i) {
+        writer->jobs[i].data = writer->buffers + i * capacity;
+    }
+    writer->num_slots = num_slots;
+    writer->policy = policy;
+    writer->stride = 1;
+
+    pthread_mutex_init(&writer->mutex, NULL);
+    pthread_cond_init(&writer->job_ready, NULL);
+    pthread_cond_init(&writer->slot_free, NULL);
+    if (policy != WRITER_INLINE && pthread_create(&writer->thread, NULL, writer_main, writer) != 0) {
+        pthread_cond_destroy(&writer->slot_free);
+        pthread_cond_destroy(&writer->job_ready);
+        pthread_mutex_destroy(&writer->mutex);
+        free(writer->jobs);
+        free(writer->buffers);
+        free(writer);
+        return NULL;  // Thread creation failed
+    }
+    return writer;
+}
+
+/**
+ * Queue a snapshot of the current state of the grid.
+ *
+ * @param writer Pointer to the writer.
+ * @param grid Pointer to the grid.
+ * @param creatures The creatures of the current generation.
+ * @param filename Name of the output file.
+ * @param format File format of the snapshot.
+ * @return 0 if the frame was queued or dropped under the policy, non-zero if the name is too long, the writer
+ *         only writes networks or a write failed.
+ */
+int queue_snapshot(SnapshotWriter* writer, const Grid* grid, const Creature* creatures, const char* filename, SnapshotFormat format) {
+    if (strlen(filename) >= SNAPSHOT_PATH_MAX || !writer->buffers) {
+        return 1;  // Name too long, or no snapshot buffers
+    }
+    WriterJob* job = reserve_job(writer, true);
+    if (!job) {
+        pthread_mutex_lock(&writer->mutex);
+        int failed = writer->failed;
+        pthread_mutex_unlock(&writer->mutex);
+        return failed;
+    }
+    job->kind = JOB_SNAPSHOT;
+    job->format = format;
+    job->size = encode_snapshot(grid, creatures, job->data);
+    strcpy(job->filename, filename);
+    return commit_job(writer);
+}
+
+/**
+ * Queue a copy of a network to be written in CSV files, waiting for a free
+ * slot if the ring is full.
+ *
+ * @param writer Pointer to the writer.
+ * @param network The network, which may be released as soon as this returns.
+ * @param neurons_filename Name of the neurons file.
+ * @param connections_filename Name of the connections file.
+ * @return 0 if the network was queued, non-zero if allocation failed or a name is too long.
+ *         Failures to write it are reported by close_snapshot_writer.
+ */
+int queue_network(SnapshotWriter* writer, const NeuralNetwork* network, const char* neurons_filename, const char* connections_filename) {
+    if (strlen(neurons_filename) >= SNAPSHOT_PATH_MAX || strlen(connections_filename) >= SNAPSHOT_PATH_MAX) {
+        return 1;  // Name too long
+    }
+    // Brains are shared and released by the simulation, so the writer gets its own
+    NeuralNetwork* copy = copy_neural_network(network);
+    if (!copy) {
+        return 1;  // Allocation failed
+    }
+    WriterJob* job = reserve_job(writer, false);
+    job->kind = JOB_NETWORK;
+    job->network = copy;
+    strcpy(job->filename, neurons_filename);
+    strcpy(job->second_filename, connections_filename);
+    commit_job(writer);
+    return 0;
+}
+
+/**
+ * Wait until every queued job is written.
+ *
+ * @param writer Pointer to the writer.
+ * @return 0 on success, non-zero if a write failed.
+ */
+int flush_snapshot_writer(SnapshotWriter* writer) {
+    pthread_mutex_lock(&writer->mutex);
+    while (writer->num_queued > 0) {
+        pthread_cond_wait(&writer->slot_free, &writer->mutex);
+    }
+    int failed = writer->failed;
+    pthread_mutex_unlock(&writer->mutex);
+    return failed;
+}
+
+/**
+ * Write every queued job, stop the writer thread and deallocate the writer.
+ *
+ * @param writer Pointer to the writer, NULL is ignored.
+ * @return 0 on success, non-zero if a write failed at any point.
+ */
+int close_snapshot_writer(SnapshotWriter* writer) {
+    if (!writer) {
+        return 0;
+    }
+    pthread_mutex_lock(&writer->mutex);
+    writer->stop = true;
+    pthread_cond_signal(&writer->job_ready);
+    pthread_mutex_unlock(&writer->mutex);
+    if (writer->policy != WRITER_INLINE) {
+        pthread_join(writer->thread, NULL);
+    }
+
+    int failed = writer->failed;
+    pthread_cond_destroy(&writer->slot_free);
+    pthread_cond_destroy(&writer->job_ready);
+    pthread_mutex_destroy(&writer->mutex);
+    free(writer->jobs);
+    free(writer->buffers);
+    free(writer);
+    return failed;
+}
@@ -0,0 +1,136 @@
+#ifndef SNAPSHOT_WRITER_H
+#define SNAPSHOT_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "grid.h"
+#include "neuron_encoding.h"
+#include "simulation.h"
+#include "snapshot.h"
+
+// Longest file name a job can be queued with, including the terminator
+#define SNAPSHOT_PATH_MAX 1024
+
+// What queue_snapshot does with a frame when every slot of the ring is taken
+typedef enum {
+    WRITER_BLOCK,     // Wait for the writer to free a slot, no frame is lost
+    WRITER_DROP,      // Drop the frame
+    WRITER_DECIMATE,  // Drop the frame and keep only every other frame from then on, halving again each
+                      // time the ring fills, until the writer catches up
+    WRITER_INLINE     // No writer thread: write every job as it is queued, no frame is lost
+} WriterPolicy;
+
+// File format a queued frame is written in
+typedef enum {
+    SNAPSHOT_BINARY,  // A snapshot file, see snapshot.h
+    SNAPSHOT_CSV      // The CSV format of output_grid_to_csv
+} SnapshotFormat;
+
+// Kinds of writer jobs
+typedef enum {
+    JOB_SNAPSHOT,     // Write the encoded snapshot in data
+    JOB_NETWORK       // Write the network in CSV files, see output_network_to_csv
+} WriterJobKind;
+
+// A slot of the ring
+typedef struct {
+    WriterJobKind kind;
+    SnapshotFormat format;              // Format of a snapshot
+    uint8_t* data;                      // Snapshot, snapshot_capacity bytes owned by the slot
+    size_t size;                        // Size of the snapshot in bytes
+    NeuralNetwork* network;             // Private copy of a network, freed once written
+    char filename[SNAPSHOT_PATH_MAX];   // File to write, the neurons file of a network
+    char second_filename[SNAPSHOT_PATH_MAX];  // Connections file of a network
+} WriterJob;
+
+/*
+ * Writes snapshots and networks to files on a thread of its own, so that the
+ * simulation does not wait on the disk. Queuing a frame encodes the grid
+ * straight into a free slot of a fixed ring, a copy of a few hundred
+ * kilobytes; the writer thread turns the slots into files in queue order.
+ * When the ring is full, the policy decides whether the simulation waits or
+ * frames are lost. Networks are never dropped.
+ *
+ * On a single processor the writer thread only competes with the simulation,
+ * and handing it every frame costs more than writing the frame directly.
+ * WRITER_INLINE starts no thread and writes each job from its one slot as it
+ * is queued instead.
+ *
+ * Jobs must be queued from a single thread, the one running the simulation.
+ */
+typedef struct {
+    WriterJob* jobs;              // The ring, num_slots jobs
+    uint8_t* buffers;             // Snapshot buffers of every slot, one block, NULL for a writer of networks only
+    uint32_t num_slots;           // Capacity of the ring
+    WriterPolicy policy;          // What to do with a frame when the ring is full
+    pthread_t thread;             // The writer thread, not started under WRITER_INLINE
+    pthread_mutex_t mutex;        // Guards the fields below
+    pthread_cond_t job_ready;     // Signalled when a job is queued or the writer stops
+    pthread_cond_t slot_free;     // Signalled when the writer finishes a job
+    uint32_t head;                // Slot of the oldest job
+    uint32_t num_queued;          // Jobs in the ring, including the one being written
+    uint32_t stride;              // Frames kept while decimating, one in stride
+    uint64_t frames_offered;      // Frames passed to queue_snapshot
+    uint64_t frames_written;      // Frames written to files
+    uint64_t frames_dropped;      // Frames dropped under the policy
+    bool stop;                    // Set when the writer is closed
+    bool failed;                  // Whether a write failed
+} SnapshotWriter;
+
+/**
+ * Start a writer thread for the snapshots of a grid, or with WRITER_INLINE a
+ * writer that writes on the calling thread.
+ *
+ * @param grid Pointer to the grid whose snapshots will be written, NULL for a writer of networks only,
+ *             which allocates no snapshot buffers.
+ * @param num_slots Capacity of the ring, at least 1; WRITER_INLINE uses a single slot.
+ * @param policy What to do with a frame when the ring is full.
+ * @return Pointer to the new writer, or NULL if allocation failed or the thread could not be started.
+ */
+SnapshotWriter* create_snapshot_writer(const Grid* grid, uint32_t num_slots, WriterPolicy policy);
+
+/**
+ * Queue a snapshot of the current state of the grid.
+ *
+ * @param writer Pointer to the writer.
+ * @param grid Pointer to the grid.
+ * @param creatures The creatures of the current generation.
+ * @param filename Name of the output file.
+ * @param format File format of the snapshot.
+ * @return 0 if the frame was queued or dropped under the policy, non-zero if the name is too long, the writer
+ *         only writes networks or a write failed.
+ */
+int queue_snapshot(SnapshotWriter* writer, const Grid* grid, const Creature* creatures, const char* filename, SnapshotFormat format);
+
+/**
+ * Queue a copy of a network to be written in CSV files, waiting for a free
+ * slot if the ring is full.
+ *
+ * @param writer Pointer to the writer.
+ * @param network The network, which may be released as soon as this returns.
+ * @param neurons_filename Name of the neurons file.
+ * @param connections_filename Name of the connections file.
+ * @return 0 if the network was queued, non-zero if allocation failed or a name is too long.
+ *         Failures to write it are reported by close_snapshot_writer.
+ */
+int queue_network(SnapshotWriter* writer, const NeuralNetwork* network, const char* neurons_filename, const char* connections_filename);
+
+/**
+ * Wait until every queued job is written.
+ *
+ * @param writer Pointer to the writer.
+ * @return 0 on success, non-zero if a write failed.
+ */
+int flush_snapshot_writer(SnapshotWriter* writer);
+
+/**
+ * Write every queued job, stop the writer thread and deallocate the writer.
+ *
+ * @param writer Pointer to the writer, NULL is ignored.
+ * @return 0 on success, non-zero if a write failed at any point.
+ */
+int close_snapshot_writer(SnapshotWriter* writer);
+
+#endif // SNAPSHOT_WRITER_H
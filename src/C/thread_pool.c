@@ -0,0 +1,240 @@
+#define _GNU_SOURCE  // pthread_setaffinity_np
+#include "thread_pool.h"
+#include <stdlib.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+// Pack the range [begin, end) into one word
+static uint64_t pack_range(uint32_t begin, uint32_t end) {
+    return (uint64_t)end << 32 | begin;
+}
+
+// Take the index at the front of a thread's own queue, returns false once the queue is empty
+static bool pop_index(WorkQueue* queue, uint32_t* index) {
+    uint64_t range = atomic_load(&queue->range);
+    for (;;) {
+        uint32_t begin = (uint32_t)range;
+        uint32_t end = (uint32_t)(range >> 32);
+        if (begin >= end) {
+            return false;
+        }
+        if (atomic_compare_exchange_weak(&queue->range, &range, pack_range(begin + 1, end))) {
+            *index = begin;
+            return true;
+        }
+    }
+}
+
+// Take the back half of another thread's queue, all of it if one index is left;
+// returns false if the queue is empty
+static bool steal_range(WorkQueue* victim, uint32_t* stolen_begin, uint32_t* stolen_end) {
+    uint64_t range = atomic_load(&victim->range);
+    for (;;) {
+        uint32_t begin = (uint32_t)range;
+        uint32_t end = (uint32_t)(range >> 32);
+        if (begin >= end) {
+            return false;
+        }
+        uint32_t middle = begin + (end - begin) / 2;
+        if (atomic_compare_exchange_weak(&victim->range, &range, pack_range(begin, middle))) {
+            *stolen_begin = middle;
+            *stolen_end = end;
+            return true;
+        }
+    }
+}
+
+// Run the indices of the current loop from the thread's own queue, then steal
+// from the others until every queue is empty
+static void run_tasks(ThreadPool* pool, uint32_t self) {
+    WorkQueue* own = &pool->queues[self];
+    for (;;) {
+        uint32_t index;
+        while (pop_index(own, &index)) {
+            pool->task(pool->context, index);
+        }
+        bool stolen = false;
+        for (uint32_t k = 1; k < pool->num_threads && !stolen; ++k) {
+            uint32_t begin, end;
+            if (steal_range(&pool->queues[(self + k) % pool->num_threads], &begin, &end)) {
+                // Publish the rest of the stolen range so it can be stolen in turn
+                atomic_store(&own->range, pack_range(begin + 1, end));
+                pool->task(pool->context, begin);
+                stolen = true;
+            }
+        }
+        if (!stolen) {
+            return;
+        }
+    }
+}
+
+// Body of every worker: wait for a loop, help run it, report back
+static void* worker_main(void* argument) {
+    PoolWorker* worker = argument;
+    ThreadPool* pool = worker->pool;
+    uint64_t seen = 0;
+    pthread_mutex_lock(&pool->mutex);
+    for (;;) {
+        while (!pool->stop && pool->generation == seen) {
+            pthread_cond_wait(&pool->work_ready, &pool->mutex);
+        }
+        if (pool->stop) {
+            break;
+        }
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->mutex);
+        run_tasks(pool, worker->index);
+        pthread_mutex_lock(&pool->mutex);
+        if (--pool->busy_workers == 0) {
+            pthread_cond_signal(&pool->work_done);
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+// Bind a worker to the index-th processor the calling thread may run on, wrapping around
+static void pin_worker(PoolWorker* worker) {
+#ifdef __linux__
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0) {
+        return;
+    }
+    int target = worker->index % CPU_COUNT(&allowed);
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &allowed) && target-- == 0) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            pthread_setaffinity_np(worker->thread, sizeof(set), &set);
+            return;
+        }
+    }
+#else
+    (void)worker;
+#endif
+}
+
+/**
+ * Number of processors online, the default number of threads.
+ *
+ * @return Number of processors, at least 1.
+ */
+uint32_t default_thread_count(void) {
+#ifdef _SC_NPROCESSORS_ONLN
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (uint32_t)count : 1;
+#else
+    return 1;
+#endif
+}
+
+/**
+ * Start a pool of threads.
+ *
+ * @param num_threads Threads taking part in each loop, including the caller; 0 picks default_thread_count.
+ * @param pin_threads Bind worker i to the i-th processor the caller may run on, leaving the first to the caller. Ignored where unsupported.
+ * @return Pointer to the new pool, or NULL if allocation or thread creation failed.
+ */
+ThreadPool* create_thread_pool(uint32_t num_threads, bool pin_threads) {
+    ThreadPool* pool = calloc(1, sizeof(ThreadPool));
+    if (!pool) {
+        return NULL;  // Allocation failed
+    }
+    pool->num_threads = num_threads ? num_threads : default_thread_count();
+    pool->pinned = pin_threads;
+    pool->workers = malloc(pool->num_threads * sizeof(PoolWorker));
+    pool->queues = malloc(pool->num_threads * sizeof(WorkQueue));
+    if (!pool->workers || !pool->queues) {
+        free(pool->workers);
+        free(pool->queues);
+        free(pool);
+        return NULL;  // Allocation failed
+    }
+    for (uint32_t i = 0; i < pool->num_threads; ++i) {
+        atomic_init(&pool->queues[i].range, 0);
+    }
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->work_ready, NULL);
+    pthread_cond_init(&pool->work_done, NULL);
+    for (uint32_t i = 0; i + 1 < pool->num_threads; ++i) {
+        PoolWorker* worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->index = i + 1;
+        if (pthread_create(&worker->thread, NULL, worker_main, worker) != 0) {
+            // Keep the workers that did start
+            pool->num_threads = i + 1;
+            break;
+        }
+        if (pin_threads) {
+            pin_worker(worker);
+        }
+    }
+    return pool;
+}
+
+/**
+ * Stop the workers and deallocate the pool.
+ *
+ * @param pool Pointer to the pool to be deallocated.
+ */
+void free_thread_pool(ThreadPool* pool) {
+    if (!pool) {
+        return;
+    }
+    pthread_mutex_lock(&pool->mutex);
+    pool->stop = true;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->mutex);
+    for (uint32_t i = 0; i + 1 < pool->num_threads; ++i) {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+    pthread_cond_destroy(&pool->work_done);
+    pthread_cond_destroy(&pool->work_ready);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool->queues);
+    free(pool->workers);
+    free(pool);
+}
+
+/**
+ * Run task(context, i) for every i in [0, count) across the pool and wait for
+ * all of them to finish. Must not be called from inside a task.
+ *
+ * @param pool Pointer to the pool, NULL runs the loop on the calling thread.
+ * @param count Number of indices.
+ * @param task Task to run for each index.
+ * @param context Context passed to every call.
+ */
+void parallel_for(ThreadPool* pool, uint32_t count, ParallelTask task, void* context) {
+    if (!pool || pool->num_threads <= 1 || count <= 1) {
+        for (uint32_t i = 0; i < count; ++i) {
+            task(context, i);
+        }
+        return;
+    }
+    pthread_mutex_lock(&pool->mutex);
+    pool->task = task;
+    pool->context = context;
+    // Deal the indices out in one contiguous range per thread
+    for (uint32_t t = 0; t < pool->num_threads; ++t) {
+        uint32_t begin = (uint32_t)((uint64_t)count * t / pool->num_threads);
+        uint32_t end = (uint32_t)((uint64_t)count * (t + 1) / pool->num_threads);
+        atomic_store(&pool->queues[t].range, pack_range(begin, end));
+    }
+    pool->busy_workers = pool->num_threads - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->mutex);
+
+    run_tasks(pool, 0);
+
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->busy_workers > 0) {
+        pthread_cond_wait(&pool->work_done, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
@@ -0,0 +1,88 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+// A task run for every index of a parallel_for, with the context passed to it
+typedef void (*ParallelTask)(void* context, uint32_t index);
+
+// Indices of a loop still waiting to run on one thread, begin in the low and end in the high 32 bits
+typedef struct {
+    _Atomic uint64_t range;      // Packed [begin, end), empty when begin >= end
+    char padding[64 - sizeof(uint64_t)];  // Spread the queues so no two share a cache line
+} WorkQueue;
+
+struct ThreadPool;
+
+// A worker thread and the slot of its queue
+typedef struct {
+    struct ThreadPool* pool;     // Pool the worker belongs to
+    uint32_t index;              // Index of the worker's queue, 1 to num_threads - 1
+    pthread_t thread;            // The thread itself
+} PoolWorker;
+
+/*
+ * A fixed set of worker threads that run parallel_for loops. The calling thread
+ * takes part in every loop, so a pool of n threads starts n - 1 workers, and a
+ * pool of one thread runs everything inline. The threads are started once and
+ * reused by every loop.
+ *
+ * Each thread owns a work queue, and a loop starts with its indices split into
+ * one contiguous range per queue. A thread runs the indices of its own queue
+ * from the front; once it runs dry it steals the back half of another thread's
+ * range, so a loop whose tasks vary wildly in cost still finishes together.
+ * Callers must not depend on which thread runs which index.
+ */
+typedef struct ThreadPool {
+    PoolWorker* workers;         // Worker threads, num_threads - 1 of them
+    WorkQueue* queues;           // One queue per thread, the caller's first
+    uint32_t num_threads;        // Threads taking part in a loop, including the caller
+    bool pinned;                 // Whether the workers are bound to processors
+    pthread_mutex_t mutex;       // Guards the fields below
+    pthread_cond_t work_ready;   // Signalled when a loop starts or the pool stops
+    pthread_cond_t work_done;    // Signalled when the last worker finishes a loop
+    ParallelTask task;           // Task of the current loop
+    void* context;               // Context of the current loop
+    uint32_t busy_workers;       // Workers still running the current loop
+    uint64_t generation;         // Number of loops started, wakes the workers
+    bool stop;                   // Set when the pool is freed
+} ThreadPool;
+
+/**
+ * Number of processors online, the default number of threads.
+ *
+ * @return Number of processors, at least 1.
+ */
+uint32_t default_thread_count(void);
+
+/**
+ * Start a pool of threads.
+ *
+ * @param num_threads Threads taking part in each loop, including the caller; 0 picks default_thread_count.
+ * @param pin_threads Bind worker i to the i-th processor the caller may run on, leaving the first to the caller. Ignored where unsupported.
+ * @return Pointer to the new pool, or NULL if allocation or thread creation failed.
+ */
+ThreadPool* create_thread_pool(uint32_t num_threads, bool pin_threads);
+
+/**
+ * Stop the workers and deallocate the pool.
+ *
+ * @param pool Pointer to the pool to be deallocated.
+ */
+void free_thread_pool(ThreadPool* pool);
+
+/**
+ * Run task(context, i) for every i in [0, count) across the pool and wait for
+ * all of them to finish. Must not be called from inside a task.
+ *
+ * @param pool Pointer to the pool, NULL runs the loop on the calling thread.
+ * @param count Number of indices.
+ * @param task Task to run for each index.
+ * @param context Context passed to every call.
+ */
+void parallel_for(ThreadPool* pool, uint32_t count, ParallelTask task, void* context);
+
+#endif // THREAD_POOL_H
@@ -15,10 +15,33 @@ class Grid:
 
         X,Y,Occupied,Food,Poison,Wall,Sunlit,Water,CreatureID
 
-    This class loads that CSV and provides a simple visualisation of the
+    This class loads that CSV, or a binary snapshot written by
+    :func:`output_grid_snapshot`, and provides a simple visualisation of the
     current grid state.
     """
 
+    #: Bitplanes of a snapshot, in the order of the C ``CellFlag`` enum
+    SNAPSHOT_PLANES = ["Occupied", "Food", "Poison", "Wall", "Sunlit", "Water"]
+    SNAPSHOT_MAGIC = 0x504E5345
+    SNAPSHOT_VERSION = 1
+    SNAPSHOT_HEADER = np.dtype(
+        [
+            ("magic", "<u4"),
+            ("version", "<u2"),
+            ("num_planes", "<u2"),
+            ("width", "<u2"),
+            ("height", "<u2"),
+            ("plane_words", "<u4"),
+            ("generation", "<u4"),
+            ("step", "<u4"),
+            ("num_creatures", "<u4"),
+            ("reserved", "<u4"),
+        ]
+    )
+    SNAPSHOT_CREATURE = np.dtype(
+        [("id", "<u4"), ("x", "<u2"), ("y", "<u2"), ("energy", "<f4"), ("age", "<u4")]
+    )
+
     def __init__(self, dataframe: pd.DataFrame):
         self.dataframe = dataframe
         self.width = int(dataframe["X"].max() + 1)
@@ -30,6 +53,51 @@ class Grid:
         df = pd.read_csv(path)
         return cls(df)
 
+    @classmethod
+    def from_snapshot(cls, path: Path) -> "Grid":
+        """Create a :class:`Grid` instance from a binary snapshot file."""
+        data = Path(path).read_bytes()
+        header = np.frombuffer(data, cls.SNAPSHOT_HEADER, count=1)[0]
+        if header["magic"] != cls.SNAPSHOT_MAGIC or header["version"] != cls.SNAPSHOT_VERSION:
+            raise ValueError(f"{path} is not a version {cls.SNAPSHOT_VERSION} snapshot")
+        width, height = int(header["width"]), int(header["height"])
+        offset = cls.SNAPSHOT_HEADER.itemsize
+        plane_words = int(header["plane_words"])
+        planes = np.frombuffer(
+            data, "<u8", count=int(header["num_planes"]) * plane_words, offset=offset
+        ).reshape(-1, plane_words)
+        offset += planes.nbytes
+        creatures = np.frombuffer(
+            data, cls.SNAPSHOT_CREATURE, count=int(header["num_creatures"]), offset=offset
+        )
+        return cls.from_frame(width, height, planes, creatures)
+
+    @classmethod
+    def from_frame(
+        cls, width: int, height: int, planes: np.ndarray, creatures: np.ndarray
+    ) -> "Grid":
+        """Create a :class:`Grid` instance from decoded snapshot bitplanes
+        (one row of 64-bit words per flag) and creature records."""
+        num_cells = width * height
+        columns = {
+            "X": np.tile(np.arange(width), height),
+            "Y": np.repeat(np.arange(height), width),
+        }
+        for name, plane in zip(cls.SNAPSHOT_PLANES, planes):
+            bits = np.unpackbits(plane.view(np.uint8), bitorder="little")
+            columns[name] = bits[:num_cells].astype(bool)
+        creature_ids = np.zeros(num_cells, dtype=np.uint32)
+        creature_ids[creatures["y"].astype(int) * width + creatures["x"]] = creatures["id"]
+        columns["CreatureID"] = creature_ids
+        return cls(pd.DataFrame(columns))
+
+    @classmethod
+    def from_file(cls, path: Path) -> "Grid":
+        """Create a :class:`Grid` instance from a CSV or ``.snap`` file."""
+        if Path(path).suffix == ".snap":
+            return cls.from_snapshot(path)
+        return cls.from_csv(path)
+
     def _to_image(self) -> np.ndarray:
         """Convert the grid to an RGB image for plotting."""
         img = np.ones((self.height, self.width, 3), dtype=float)
@@ -127,17 +195,19 @@ class Grid:
 
 
 def main() -> None:
-    parser = argparse.ArgumentParser(description="Visualise grid state from CSV")
+    parser = argparse.ArgumentParser(
+        description="Visualise grid state from a CSV or binary snapshot"
+    )
     parser.add_argument(
         "grid_csv",
         nargs="?",
         default=Path(__file__).with_name("grid.csv"),
         type=Path,
-        help="Path to the grid CSV file",
+        help="Path to the grid CSV or .snap file",
     )
     args = parser.parse_args()
 
-    grid = Grid.from_csv(args.grid_csv)
+    grid = Grid.from_file(args.grid_csv)
     grid.plot()
     grid.describe_creatures()
 
@@ -0,0 +1,117 @@
+"""Reader for the genome archives written by the C simulation with ``--genome-archive``.
+
+The layout is documented in ``src/C/genome_archive.h``: a file header, then one
+block per generation holding a generation header, a record per genome with its
+parents and whether it survived, and the genomes themselves. The file is
+memory-mapped and every array returned is a view into it, so reading a
+generation copies nothing.
+"""
+
+from pathlib import Path
+from typing import Iterator, List
+
+import numpy as np
+
+ARCHIVE_MAGIC = 0x414E4745
+ARCHIVE_VERSION = 1
+ARCHIVE_ALIGNMENT = 64
+NO_PARENT = 0xFFFFFFFF
+GENOMES_COMPLETE = 1
+SURVIVAL_RECORDED = 2
+
+FILE_HEADER = np.dtype([("magic", "<u4"), ("version", "<u2"), ("gene_size", "<u2")])
+GENERATION_HEADER = np.dtype(
+    [
+        ("magic", "<u4"),
+        ("generation", "<u4"),
+        ("num_genomes", "<u4"),
+        ("genome_length", "<u4"),
+        ("genome_stride", "<u4"),
+        ("flags", "<u4"),
+        ("num_survivors", "<u4"),
+        ("reserved", "<u4"),
+        ("genomes_offset", "<u8"),
+        ("size", "<u8"),
+    ]
+)
+RECORD = np.dtype([("parents", "<u4", (2,)), ("survived", "u1"), ("reserved", "u1", (3,))])
+
+
+class ArchivedGeneration:
+    """The genomes of one generation, as views into the mapped archive."""
+
+    def __init__(self, data: np.ndarray, offset: int):
+        header = data[offset : offset + GENERATION_HEADER.itemsize].view(GENERATION_HEADER)[0]
+        self.generation = int(header["generation"])
+        self.flags = int(header["flags"])
+        self.num_survivors = int(header["num_survivors"])
+        self.size = int(header["size"])
+        count = int(header["num_genomes"])
+        start = offset + GENERATION_HEADER.itemsize
+        self.records = data[start : start + count * RECORD.itemsize].view(RECORD)
+
+        # Genomes are padded to the stride, the view skips the padding
+        length = int(header["genome_length"])
+        stride = int(header["genome_stride"])
+        start = offset + int(header["genomes_offset"])
+        self.genomes = np.ndarray(
+            (count, length), dtype="<u8", buffer=data, offset=start, strides=(stride, 8)
+        )
+
+    @property
+    def complete(self) -> bool:
+        """Whether every genome was bred before the run stopped."""
+        return bool(self.flags & GENOMES_COMPLETE)
+
+    @property
+    def parents(self) -> np.ndarray:
+        """Indices of both parents of each genome in the previous generation."""
+        return self.records["parents"]
+
+    @property
+    def survived(self) -> np.ndarray:
+        """Whether each creature survived its generation, all False if it never ended."""
+        return self.records["survived"].view(bool)
+
+
+def read_generations(path: Path) -> Iterator[ArchivedGeneration]:
+    """Yield every generation in the archive in the order it was bred.
+
+    A run resumed from an older checkpoint appends the generations it breeds
+    again, so a generation number may appear more than once.
+    """
+    data = np.memmap(path, dtype="u1", mode="r")
+    header = data[: FILE_HEADER.itemsize].view(FILE_HEADER)[0]
+    if header["magic"] != ARCHIVE_MAGIC or header["version"] != ARCHIVE_VERSION:
+        raise ValueError(f"{path} is not a version {ARCHIVE_VERSION} genome archive")
+    offset = ARCHIVE_ALIGNMENT
+    while offset + GENERATION_HEADER.itemsize <= len(data):
+        block = data[offset : offset + GENERATION_HEADER.itemsize].view(GENERATION_HEADER)[0]
+        if (
+            block["magic"] != ARCHIVE_MAGIC
+            or block["size"] == 0
+            or offset + int(block["size"]) > len(data)
+        ):
+            return  # The archive was cut short
+        generation = ArchivedGeneration(data, offset)
+        yield generation
+        offset += generation.size
+
+
+def lineage(path: Path, generation: int, index: int) -> List[int]:
+    """Follow the closer parent of a genome back to the spawned generation.
+
+    Returns the creature index of the ancestor in every generation, oldest first.
+    """
+    generations = {}
+    for archived in read_generations(path):
+        generations[archived.generation] = archived
+    indices = [index]
+    while generation in generations:
+        parent = int(generations[generation].parents[index][0])
+        if parent == NO_PARENT:
+            break
+        generation -= 1
+        index = parent
+        indices.append(index)
+    return indices[::-1]
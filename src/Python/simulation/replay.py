@@ -0,0 +1,139 @@
+"""Reader for the replay files recorded by the C simulation with ``--replay``.
+
+The layout is documented in ``src/C/replay.h``: a file header, then one record
+per step, either a keyframe holding a whole snapshot or a delta holding the
+creatures that moved or left the grid and the bitplane words that changed.
+"""
+
+from pathlib import Path
+from typing import Iterator, Optional
+
+import numpy as np
+
+from .environment import Grid
+
+REPLAY_MAGIC = 0x4C505245
+REPLAY_VERSION = 1
+REPLAY_KEYFRAME = 1
+REPLAY_DELTA = 2
+REPLAY_INDEX = 3
+CELL_OCCUPIED = 0
+
+FILE_HEADER = np.dtype([("magic", "<u4"), ("version", "<u2"), ("reserved", "<u2")])
+RECORD_HEADER = np.dtype(
+    [("type", "<u4"), ("generation", "<u4"), ("step", "<u4"), ("size", "<u4")]
+)
+DELTA = np.dtype(
+    [
+        ("num_moves", "<u4"),
+        ("num_deaths", "<u4"),
+        ("num_flag_changes", "<u4"),
+        ("reserved", "<u4"),
+    ]
+)
+MOVE = np.dtype([("slot", "<u4"), ("x", "<u2"), ("y", "<u2")])
+FLAG_CHANGE = np.dtype([("bits", "<u8"), ("word", "<u4"), ("reserved", "<u4")])
+
+
+class ReplayFrame:
+    """State of the grid at one recorded step, in snapshot form."""
+
+    def __init__(self, payload: bytes):
+        header = np.frombuffer(payload, Grid.SNAPSHOT_HEADER, count=1)[0]
+        if header["magic"] != Grid.SNAPSHOT_MAGIC:
+            raise ValueError("Damaged keyframe")
+        self.width = int(header["width"])
+        self.height = int(header["height"])
+        self.plane_words = int(header["plane_words"])
+        offset = Grid.SNAPSHOT_HEADER.itemsize
+        count = int(header["num_planes"]) * self.plane_words
+        self.planes = np.frombuffer(payload, "<u8", count=count, offset=offset).copy()
+        offset += count * 8
+        self.creatures = np.frombuffer(
+            payload,
+            Grid.SNAPSHOT_CREATURE,
+            count=int(header["num_creatures"]),
+            offset=offset,
+        ).copy()
+        self.on_grid = np.ones(len(self.creatures), dtype=bool)
+        self.generation = 0
+        self.step = 0
+
+    def _set_occupied(self, slots: np.ndarray, value: bool) -> None:
+        cells = (
+            self.creatures["y"][slots].astype(np.int64) * self.width
+            + self.creatures["x"][slots]
+        )
+        words = CELL_OCCUPIED * self.plane_words + (cells >> 6)
+        bits = np.left_shift(np.uint64(1), (cells & 63).astype(np.uint64))
+        if value:
+            np.bitwise_or.at(self.planes, words, bits)
+        else:
+            np.bitwise_and.at(self.planes, words, ~bits)
+
+    def apply_delta(self, payload: bytes) -> None:
+        """Advance the frame by one step."""
+        delta = np.frombuffer(payload, DELTA, count=1)[0]
+        offset = DELTA.itemsize
+        moves = np.frombuffer(payload, MOVE, count=int(delta["num_moves"]), offset=offset)
+        offset += moves.nbytes
+        deaths = np.frombuffer(payload, "<u4", count=int(delta["num_deaths"]), offset=offset)
+        offset += deaths.nbytes
+        changes = np.frombuffer(
+            payload, FLAG_CHANGE, count=int(delta["num_flag_changes"]), offset=offset
+        )
+
+        # Vacate every cell first, a creature may move into a cell left in the same step
+        self._set_occupied(moves["slot"], False)
+        self._set_occupied(deaths, False)
+        self.on_grid[deaths] = False
+        self.creatures["x"][moves["slot"]] = moves["x"]
+        self.creatures["y"][moves["slot"]] = moves["y"]
+        self._set_occupied(moves["slot"], True)
+        np.bitwise_xor.at(self.planes, changes["word"], changes["bits"])
+        self.creatures["age"][self.on_grid] += 1
+
+    def to_grid(self) -> Grid:
+        """Build a :class:`Grid` of the frame."""
+        return Grid.from_frame(
+            self.width,
+            self.height,
+            self.planes.reshape(-1, self.plane_words),
+            self.creatures[self.on_grid],
+        )
+
+
+def read_frames(path: Path, generation: Optional[int] = None) -> Iterator[ReplayFrame]:
+    """Yield the frame of every recorded step, or only those of one generation.
+
+    The same :class:`ReplayFrame` object is updated in place between steps.
+    """
+    with open(path, "rb") as file:
+        header = np.frombuffer(file.read(FILE_HEADER.itemsize), FILE_HEADER, count=1)[0]
+        if header["magic"] != REPLAY_MAGIC or header["version"] != REPLAY_VERSION:
+            raise ValueError(f"{path} is not a version {REPLAY_VERSION} replay")
+        frame = None
+        while True:
+            data = file.read(RECORD_HEADER.itemsize)
+            if len(data) < RECORD_HEADER.itemsize:
+                return
+            record = np.frombuffer(data, RECORD_HEADER, count=1)[0]
+            if record["type"] == REPLAY_INDEX:
+                return
+            if generation is not None and record["generation"] < generation:
+                file.seek(int(record["size"]), 1)
+                continue
+            if generation is not None and record["generation"] > generation:
+                return
+            payload = file.read(int(record["size"]))
+            if len(payload) < record["size"]:
+                return  # The recording was cut short
+            if record["type"] == REPLAY_KEYFRAME:
+                frame = ReplayFrame(payload)
+            elif frame is not None:
+                frame.apply_delta(payload)
+            else:
+                continue
+            frame.generation = int(record["generation"])
+            frame.step = int(record["step"])
+            yield frame
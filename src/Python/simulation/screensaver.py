@@ -6,13 +6,14 @@ import matplotlib.pyplot as plt
 from matplotlib.animation import FuncAnimation
 
 from .environment import Grid
+from .replay import read_frames
 
 
 def load_grids(paths: List[Path]) -> List[Grid]:
-    """Load grid CSV files into :class:`Grid` objects."""
+    """Load grid CSV or snapshot files into :class:`Grid` objects."""
     grids: List[Grid] = []
     for path in paths:
-        grids.append(Grid.from_csv(path))
+        grids.append(Grid.from_file(path))
     return grids
 
 
@@ -33,12 +34,19 @@ def animate_grids(grids: List[Grid], interval: int) -> None:
 
 def main() -> None:
     parser = argparse.ArgumentParser(
-        description="Play back a series of grid CSVs endlessly as a screen saver"
+        description="Play back a series of grid snapshots or CSVs endlessly as a screen saver"
     )
     parser.add_argument(
         "directory",
         type=Path,
-        help="Directory containing grid CSV files for a single generation",
+        help="Directory containing grid snapshot or CSV files for a single generation, "
+        "or a replay file recorded with --replay",
+    )
+    parser.add_argument(
+        "--generation",
+        type=int,
+        default=0,
+        help="Generation to play back from a replay file",
     )
     parser.add_argument(
         "--interval",
@@ -48,11 +56,20 @@ def main() -> None:
     )
     args = parser.parse_args()
 
-    csv_files = sorted(args.directory.glob("*.csv"))
-    if not csv_files:
-        raise SystemExit("No CSV files found in the specified directory")
+    if args.directory.is_file():
+        grids = [frame.to_grid() for frame in read_frames(args.directory, args.generation)]
+        if not grids:
+            raise SystemExit(f"Generation {args.generation} is not in the replay")
+        animate_grids(grids, args.interval)
+        return
+
+    frame_files = sorted(args.directory.glob("*.snap")) or sorted(
+        args.directory.glob("*.csv")
+    )
+    if not frame_files:
+        raise SystemExit("No snapshot or CSV files found in the specified directory")
 
-    grids = load_grids(csv_files)
+    grids = load_grids(frame_files)
     animate_grids(grids, args.interval)
 
 